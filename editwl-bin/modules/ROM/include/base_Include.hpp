@@ -2,6 +2,12 @@
 #pragma once
 #include <mod/mod_Module.hpp>
 #include <twl/fmt/fmt_ROM.hpp>
+#include <twl/fmt/fmt_ROMDiff.hpp>
+#include <twl/fmt/fmt_ROMImageHash.hpp>
+#include <twl/fmt/fmt_ROMIndexCache.hpp>
+#include <twl/fmt/fmt_ROMManifest.hpp>
+#include <twl/fmt/fmt_ROMOffsetIndex.hpp>
+#include <twl/util/util_Patch.hpp>
 #include <QString>
 
 constexpr twl::Result ResultPlaceholder = 0xffff;
@@ -1,6 +1,21 @@
 #include <mod/mod_Module.hpp>
 #include <args.hxx>
 #include <base_Include.hpp>
+#include <fstream>
+#include <filesystem>
+#include <mutex>
+#include <sstream>
+#include <iomanip>
+#include <twl/util/util_Thread.hpp>
+#include <chrono>
+#include <set>
+#include <unordered_map>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
 
 #define R_TRY_ERRLOG(rc, ...) { \
     const auto _tmp_rc = (rc); \
@@ -28,13 +43,13 @@ namespace {
 
     void PrintInformation(const std::string &rom_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_file([&]() {
             rom_file.Close();
         });
 
-        twl::fmt::ROM rom;
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::OverlayTables | twl::fmt::ROM::ReadOptions::LibSymbols);
         R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
 
         // Print fields
@@ -87,13 +102,13 @@ namespace {
 
     void ExtractHeader(const std::string &rom_path, const std::string &out_header_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_file([&]() {
             rom_file.Close();
         });
 
-        twl::fmt::ROM rom;
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::None);
         R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
 
         twl::fs::StdioFile out_header_file(out_header_path);
@@ -108,13 +123,13 @@ namespace {
 
     void ExtractOverlayTables(const std::string &rom_path, const std::string &out_arm7_ovt_path, const std::string &out_arm9_ovt_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_file([&]() {
             rom_file.Close();
         });
 
-        twl::fmt::ROM rom;
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::OverlayTables);
         R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
 
         if(!out_arm7_ovt_path.empty()) {
@@ -143,7 +158,7 @@ namespace {
     /*
     void ExtractOverlays(const std::string &rom_path, const std::string &out_arm7_ovl_path, const std::string &out_arm9_ovl_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_file([&]() {
             rom_file.Close();
@@ -178,13 +193,13 @@ namespace {
     
     void ExtractCodes(const std::string &rom_path, const std::string &out_arm7_code_path, const std::string &out_arm9_code_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_file([&]() {
             rom_file.Close();
         });
 
-        twl::fmt::ROM rom;
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::Code);
         R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
 
         if(!out_arm7_code_path.empty()) {
@@ -212,7 +227,7 @@ namespace {
 
     void ReplaceCodes(const std::string &rom_path, const std::string &arm7_code_path, const std::string &arm9_code_path, const std::string &out_rom_path) {
         twl::fs::StdioFile rom_file(rom_path);
-        R_TRY_ERRLOG(rom_file.OpenRead(), "Unable to open ROM file '" << rom_path << "'");
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
 
         twl::ScopeGuard close_rom_file([&]() {
             rom_file.Close();
@@ -275,6 +290,908 @@ namespace {
         R_TRY_ERRLOG(rom.WriteTo(out_rom_file), "Unable to save output ROM file '" << out_rom_path << "'");
     }
 
+    void DiffROMs(const std::string &rom_path, const std::string &mod_rom_path) {
+        twl::fs::MappedFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        twl::fmt::ROM rom(twl::fmt::ROMDiff::RequiredReadOptions);
+        R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
+
+        twl::fs::MappedFile mod_rom_file(mod_rom_path);
+        R_TRY_ERRLOG(mod_rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open modified ROM file '" << mod_rom_path << "'");
+
+        twl::ScopeGuard close_mod_file([&]() {
+            mod_rom_file.Close();
+        });
+
+        twl::fmt::ROM mod_rom(twl::fmt::ROMDiff::RequiredReadOptions);
+        R_TRY_ERRLOG(mod_rom.ReadFrom(mod_rom_file), "Unable to read modified ROM file '" << mod_rom_path << "'");
+
+        twl::fmt::ROMDiff diff;
+        R_TRY_ERRLOG(diff.Compute(rom, rom_file.GetData(), rom_file.GetDataSize(), mod_rom, mod_rom_file.GetData(), mod_rom_file.GetDataSize()), "Unable to compare ROM files");
+
+        if(diff.entries.empty()) {
+            std::cout << "ROMs are identical" << std::endl;
+            return;
+        }
+
+        for(const auto &entry: diff.entries) {
+            switch(entry.change) {
+                case twl::fmt::ROMDiff::ChangeType::Added: {
+                    std::cout << "+ " << entry.new_name << " (" << entry.new_size << " bytes)" << std::endl;
+                    break;
+                }
+                case twl::fmt::ROMDiff::ChangeType::Removed: {
+                    std::cout << "- " << entry.old_name << " (" << entry.old_size << " bytes)" << std::endl;
+                    break;
+                }
+                case twl::fmt::ROMDiff::ChangeType::Changed: {
+                    std::cout << "~ " << entry.old_name << " (" << entry.old_size << " -> " << entry.new_size << " bytes)" << std::endl;
+                    break;
+                }
+                case twl::fmt::ROMDiff::ChangeType::Renamed: {
+                    std::cout << "> " << entry.old_name << " -> " << entry.new_name << " (" << entry.new_size << " bytes)" << std::endl;
+                    break;
+                }
+            }
+        }
+    }
+
+    void CreatePatch(const std::string &rom_path, const std::string &mod_rom_path, const std::string &out_patch_path) {
+        twl::fs::MappedFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        twl::fs::MappedFile mod_rom_file(mod_rom_path);
+        R_TRY_ERRLOG(mod_rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open modified ROM file '" << mod_rom_path << "'");
+
+        twl::ScopeGuard close_mod_file([&]() {
+            mod_rom_file.Close();
+        });
+
+        twl::fs::StdioFile out_patch_file(out_patch_path);
+        R_TRY_ERRLOG(out_patch_file.OpenWrite(), "Unable to open output patch file '" << out_patch_path << "'");
+
+        twl::ScopeGuard close_out_file([&]() {
+            out_patch_file.Close();
+        });
+
+        R_TRY_ERRLOG(twl::util::BpsCreatePatch(rom_file.GetData(), rom_file.GetDataSize(), mod_rom_file.GetData(), mod_rom_file.GetDataSize(), out_patch_file), "Unable to create BPS patch file '" << out_patch_path << "'");
+    }
+
+    void ApplyPatch(const std::string &rom_path, const std::string &patch_path, const std::string &out_rom_path) {
+        twl::fs::MappedFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        twl::fs::MappedFile patch_file(patch_path);
+        R_TRY_ERRLOG(patch_file.OpenRead(twl::fs::FileCompression::None), "Unable to open patch file '" << patch_path << "'");
+
+        twl::ScopeGuard close_patch_file([&]() {
+            patch_file.Close();
+        });
+
+        // Regular output files are opened for update (after creating/truncating them), so that copies from far back in the output can be read back from it
+        const auto out_is_std_stream = out_rom_path == twl::fs::StdioFile::StdStreamPath;
+        twl::fs::StdioFile out_rom_file(out_rom_path);
+        if(!out_is_std_stream) {
+            R_TRY_ERRLOG(out_rom_file.OpenWrite(), "Unable to create output ROM file '" << out_rom_path << "'");
+            out_rom_file.Close();
+        }
+        R_TRY_ERRLOG(out_is_std_stream ? out_rom_file.OpenWrite() : out_rom_file.OpenUpdate(), "Unable to open output ROM file '" << out_rom_path << "'");
+
+        twl::ScopeGuard close_out_file([&]() {
+            if(out_rom_file.IsOpened()) {
+                out_rom_file.Close();
+            }
+        });
+
+        const auto rc = twl::util::ApplyPatch(rom_file.GetData(), rom_file.GetDataSize(), patch_file.GetData(), patch_file.GetDataSize(), out_rom_file);
+        if(rc.IsFailure() && !out_is_std_stream) {
+            // Don't leave a partially/wrongly patched ROM behind
+            out_rom_file.Close();
+            std::error_code ec;
+            std::filesystem::remove(out_rom_path, ec);
+        }
+        R_TRY_ERRLOG(rc, "Unable to apply patch file '" << patch_path << "'");
+    }
+
+    bool ParseFileDataOrder(const std::string &raw_order, twl::fmt::nfs::NitroFileSystem::FileDataOrder &out_order) {
+        if(raw_order == "walk") {
+            out_order = twl::fmt::nfs::NitroFileSystem::FileDataOrder::TreeWalk;
+            return true;
+        }
+        if(raw_order == "path") {
+            out_order = twl::fmt::nfs::NitroFileSystem::FileDataOrder::Path;
+            return true;
+        }
+        if(raw_order == "size") {
+            out_order = twl::fmt::nfs::NitroFileSystem::FileDataOrder::Size;
+            return true;
+        }
+        if(raw_order == "trace") {
+            out_order = twl::fmt::nfs::NitroFileSystem::FileDataOrder::AccessTrace;
+            return true;
+        }
+
+        std::cerr << "Invalid file order, must be one of: walk, path, size, trace" << std::endl;
+        return false;
+    }
+
+    // Each line is either a file ID (decimal or 0x-prefixed hex) or an absolute filesystem path
+    bool LoadAccessTrace(twl::fmt::ROM &rom, const std::string &trace_path, std::vector<twl::u16> &out_trace) {
+        std::ifstream trace_file(trace_path);
+        if(!trace_file) {
+            std::cerr << "Unable to open access trace file '" << trace_path << "'" << std::endl;
+            return false;
+        }
+
+        std::string line;
+        while(std::getline(trace_file, line)) {
+            while(!line.empty() && ((line.back() == '\r') || (line.back() == ' '))) {
+                line.pop_back();
+            }
+            if(line.empty()) {
+                continue;
+            }
+
+            if(line.front() == '/') {
+                twl::fmt::nfs::NitroFileSystemFile file;
+                if(rom.CreateFileByPath(file, line).IsFailure()) {
+                    std::cerr << "Access trace file '" << line << "' not found in ROM" << std::endl;
+                    return false;
+                }
+
+                out_trace.push_back(file.file_ref->file_id);
+            }
+            else {
+                try {
+                    out_trace.push_back(static_cast<twl::u16>(std::stoul(line, nullptr, 0)));
+                }
+                catch(std::exception&) {
+                    std::cerr << "Invalid access trace entry '" << line << "'" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void PrintLayoutPlan(twl::fmt::ROM::LayoutPlan &plan) {
+        const auto &header = plan.header;
+        std::cout << "Layout:" << std::endl;
+        std::cout << "> ARM9 code: 0x" << std::hex << header.arm9_rom_offset << std::dec << " (" << header.arm9_rom_size << " bytes)" << std::endl;
+        std::cout << "> ARM9 overlay table: 0x" << std::hex << header.arm9_overlay_table_offset << std::dec << " (" << header.arm9_overlay_table_size << " bytes)" << std::endl;
+        std::cout << "> ARM7 code: 0x" << std::hex << header.arm7_rom_offset << std::dec << " (" << header.arm7_rom_size << " bytes)" << std::endl;
+        std::cout << "> ARM7 overlay table: 0x" << std::hex << header.arm7_overlay_table_offset << std::dec << " (" << header.arm7_overlay_table_size << " bytes)" << std::endl;
+        std::cout << "> FNT: 0x" << std::hex << header.fnt_offset << std::dec << " (" << header.fnt_size << " bytes)" << std::endl;
+        std::cout << "> FAT: 0x" << std::hex << header.fat_offset << std::dec << " (" << header.fat_size << " bytes)" << std::endl;
+        std::cout << "> Banner: 0x" << std::hex << header.banner_offset << std::dec << std::endl;
+        std::cout << "> File data: 0x" << std::hex << plan.file_data_offset << std::dec << " (" << plan.fs_plan.file_data_size << " bytes, " << plan.fs_plan.fat.size() << " files)" << std::endl;
+        std::cout << "> ROM size: " << header.rom_size << " bytes" << std::endl;
+        std::cout << "> Capacity: " << (0x20000ul << header.device_capacity) << " bytes" << std::endl;
+        std::cout << "> Output size: " << plan.total_size << " bytes" << std::endl;
+    }
+
+    void RebuildROM(const std::string &rom_path, const std::string &out_rom_path, const std::string &order, const std::string &trace_path, const std::string &align, const bool trim, const bool pad, const bool dry_run) {
+        twl::fs::StdioFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_rom_file([&]() {
+            rom_file.Close();
+        });
+
+        // File contents are copied from the input when writing, unless the output overwrites it (then they must be loaded beforehand)
+        std::error_code ec;
+        const auto out_is_input = !out_rom_path.empty() && (out_rom_path != twl::fs::StdioFile::StdStreamPath) && std::filesystem::equivalent(rom_path, out_rom_path, ec);
+        auto read_opts = twl::fmt::ROM::ReadOptions::Writable;
+        if(out_is_input) {
+            read_opts = read_opts | twl::fmt::ROM::ReadOptions::FsContents;
+        }
+
+        twl::fmt::ROM rom(read_opts);
+        R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
+
+        auto policy = twl::fmt::ROM::GetDefaultLayoutPolicy();
+        policy.fs_layout.trim_last_padding = trim;
+        policy.pad_to_capacity = pad;
+
+        if(!order.empty()) {
+            if(!ParseFileDataOrder(order, policy.fs_layout.order)) {
+                return;
+            }
+        }
+        if(!trace_path.empty()) {
+            if(!LoadAccessTrace(rom, trace_path, policy.fs_layout.access_trace)) {
+                return;
+            }
+            if(order.empty()) {
+                policy.fs_layout.order = twl::fmt::nfs::NitroFileSystem::FileDataOrder::AccessTrace;
+            }
+        }
+        if(!align.empty()) {
+            try {
+                policy.fs_layout.file_align = std::stoul(align, nullptr, 0);
+            }
+            catch(std::exception&) {
+                std::cerr << "Invalid file alignment '" << align << "'" << std::endl;
+                return;
+            }
+        }
+
+        if(dry_run) {
+            twl::fmt::ROM::LayoutPlan plan = {};
+            twl::ScopeGuard dispose_plan([&]() {
+                plan.Dispose();
+            });
+
+            R_TRY_ERRLOG(rom.PlanLayout(policy, plan), "Unable to plan output ROM layout");
+            PrintLayoutPlan(plan);
+            return;
+        }
+
+        if(out_rom_path.empty()) {
+            std::cerr << "An output ROM file (or '-' for standard output) is required unless doing a dry run" << std::endl;
+            return;
+        }
+
+        twl::fs::StdioFile out_rom_file(out_rom_path);
+        R_TRY_ERRLOG(out_rom_file.OpenWrite(), "Unable to open output ROM file '" << out_rom_path << "'");
+
+        twl::ScopeGuard close_out_rom_file([&]() {
+            out_rom_file.Close();
+        });
+
+        R_TRY_ERRLOG(rom.WriteTo(out_rom_file, policy), "Unable to save output ROM file '" << out_rom_path << "'");
+    }
+
+    std::string EscapeJsonString(const std::string &str) {
+        std::string esc_str;
+        esc_str.reserve(str.length());
+        for(const auto ch: str) {
+            switch(ch) {
+                case '"': {
+                    esc_str += "\\\"";
+                    break;
+                }
+                case '\\': {
+                    esc_str += "\\\\";
+                    break;
+                }
+                case '\n': {
+                    esc_str += "\\n";
+                    break;
+                }
+                default: {
+                    if(static_cast<twl::u8>(ch) < 0x20) {
+                        char hex_esc[7];
+                        snprintf(hex_esc, sizeof(hex_esc), "\\u%04x", static_cast<twl::u8>(ch));
+                        esc_str += hex_esc;
+                    }
+                    else {
+                        esc_str += ch;
+                    }
+                    break;
+                }
+            }
+        }
+        return esc_str;
+    }
+
+    bool IsROMFilePath(const std::filesystem::path &path) {
+        const auto ext = twl::util::ToLowerString(path.extension().string());
+        return (ext == ".nds") || (ext == ".dsi") || (ext == ".srl");
+    }
+
+    // Only the header, overlay tables, static module params/symbols and filesystem tables are read, never any code or file contents
+    // With the index cache, these are restored from it if it's still valid for the ROM, otherwise the cache gets (re)created after reading the ROM
+    twl::Result ReadROMMetadata(const std::string &rom_path, const bool use_cache, twl::fmt::ROM &out_rom) {
+        twl::fmt::ROMIndexCache cache(twl::fmt::ROMIndexCache::GetDefaultCachePath(rom_path));
+        twl::fmt::ROMIndexCache::Key cache_key;
+        twl::fmt::ROMManifest manifest;
+        if(use_cache) {
+            TWL_R_TRY(twl::fmt::ROMIndexCache::ComputeKey(rom_path, cache_key));
+            if(cache.Load(cache_key, out_rom, manifest).IsSuccess()) {
+                TWL_R_SUCCEED();
+            }
+        }
+
+        twl::fs::StdioFile rom_file(rom_path);
+        TWL_R_TRY(rom_file.OpenRead(twl::fs::FileCompression::None));
+        out_rom.read_opts = twl::fmt::ROMIndexCache::CachedReadOptions;
+        const auto rc = out_rom.ReadFrom(rom_file);
+        rom_file.Close();
+        TWL_R_TRY(rc);
+
+        if(use_cache) {
+            // Not being able to save the cache doesn't affect the result
+            cache.Save(cache_key, out_rom, manifest);
+        }
+        TWL_R_SUCCEED();
+    }
+
+    std::string ScanROM(const std::string &rom_path, const bool use_cache) {
+        std::stringstream strm;
+        strm << "{\"path\":\"" << EscapeJsonString(rom_path) << "\"";
+
+        twl::fmt::ROM rom;
+        const auto rc = ReadROMMetadata(rom_path, use_cache, rom);
+        if(rc.IsSuccess()) {
+            std::vector<twl::fmt::nfs::NitroFileSystem::FileListEntry> files;
+            rom.GetFs().ListAllFiles(files);
+
+            strm << ",\"ok\":true";
+            strm << ",\"game_code\":\"" << EscapeJsonString(rom.header.GetGameCode()) << "\"";
+            strm << ",\"game_title\":\"" << EscapeJsonString(rom.header.GetGameTitle()) << "\"";
+            strm << ",\"developer_code\":\"" << EscapeJsonString(rom.header.GetDeveloperCode()) << "\"";
+            strm << ",\"unit_code\":" << static_cast<twl::u32>(rom.header.unit_code);
+            strm << ",\"rom_size\":" << rom.header.rom_size;
+            strm << ",\"capacity_size\":" << (0x20000ul << rom.header.device_capacity);
+            strm << ",\"arm9_size\":" << rom.header.arm9_rom_size;
+            strm << ",\"arm7_size\":" << rom.header.arm7_rom_size;
+            strm << ",\"arm9_overlay_count\":" << rom.arm9_ovl_table.size();
+            strm << ",\"arm7_overlay_count\":" << rom.arm7_ovl_table.size();
+            if(rom.start_module_params.has_value()) {
+                strm << ",\"sdk_version\":" << rom.start_module_params.value().sdk_version;
+            }
+            else {
+                strm << ",\"sdk_version\":null";
+            }
+            strm << ",\"lib_symbols\":[";
+            for(size_t i = 0; i < rom.lib_symbols.size(); i++) {
+                if(i > 0) {
+                    strm << ",";
+                }
+                strm << "\"" << EscapeJsonString(std::string(rom.lib_symbols.at(i))) << "\"";
+            }
+            strm << "]";
+            strm << ",\"file_count\":" << files.size();
+            strm << ",\"extra_file_count\":" << rom.GetFs().ext_files.size();
+        }
+        else {
+            strm << ",\"ok\":false,\"error\":\"" << EscapeJsonString(rc.GetDescription()) << "\"";
+        }
+
+        strm << "}";
+        return strm.str();
+    }
+
+    // Outputs one JSON object per line (in path order), as soon as all the previous ones are done
+    void ScanROMs(const std::string &dir_path, const std::string &jobs, const std::string &out_path, const bool use_cache) {
+        std::vector<std::string> rom_paths;
+        std::error_code ec;
+        for(std::filesystem::recursive_directory_iterator it(dir_path, std::filesystem::directory_options::skip_permission_denied, ec), end; it != end; it.increment(ec)) {
+            if(ec) {
+                break;
+            }
+            if(it->is_regular_file(ec) && IsROMFilePath(it->path())) {
+                rom_paths.push_back(it->path().string());
+            }
+        }
+        if(ec) {
+            std::cerr << "Unable to scan directory '" << dir_path << "': " << ec.message() << std::endl;
+            return;
+        }
+        std::sort(rom_paths.begin(), rom_paths.end());
+
+        twl::u32 thread_count = twl::util::GetDefaultThreadCount();
+        if(!jobs.empty()) {
+            if(!twl::util::ConvertStringToNumber(jobs, thread_count) || (thread_count == 0)) {
+                std::cerr << "Invalid job count '" << jobs << "'" << std::endl;
+                return;
+            }
+        }
+
+        std::ofstream out_file;
+        if(!out_path.empty()) {
+            out_file.open(out_path);
+            if(!out_file) {
+                std::cerr << "Unable to open output summary file '" << out_path << "'" << std::endl;
+                return;
+            }
+        }
+        auto &out_strm = out_path.empty() ? std::cout : out_file;
+
+        std::vector<std::string> summaries(rom_paths.size());
+        std::vector<bool> summaries_done(rom_paths.size(), false);
+        size_t next_out_idx = 0;
+        std::mutex out_lock;
+        twl::util::ParallelFor(rom_paths.size(), [&](const size_t i) {
+            auto summary = ScanROM(rom_paths.at(i), use_cache);
+
+            std::scoped_lock lk(out_lock);
+            summaries.at(i) = std::move(summary);
+            summaries_done.at(i) = true;
+            while((next_out_idx < summaries.size()) && summaries_done.at(next_out_idx)) {
+                out_strm << summaries.at(next_out_idx) << '\n';
+                summaries.at(next_out_idx).clear();
+                summaries.at(next_out_idx).shrink_to_fit();
+                next_out_idx++;
+            }
+        }, thread_count);
+
+        out_strm.flush();
+    }
+
+    std::string FormatHexBytes(const twl::u8 *data, const size_t data_size) {
+        constexpr char HexDigits[] = "0123456789abcdef";
+
+        std::string hex_str;
+        hex_str.reserve(data_size * 2);
+        for(size_t i = 0; i < data_size; i++) {
+            hex_str += HexDigits[data[i] >> 4];
+            hex_str += HexDigits[data[i] & 0xF];
+        }
+        return hex_str;
+    }
+
+    // A cached manifest is only usable if it covers every file (with SHA-256 hashes, if requested)
+    bool IsCachedManifestComplete(twl::fmt::ROM &rom, const twl::fmt::ROMManifest &manifest, const bool sha256) {
+        std::vector<twl::fmt::nfs::NitroFileSystem::FileListEntry> files;
+        rom.GetFs().ListAllFiles(files);
+        if(manifest.entries.size() != files.size()) {
+            return false;
+        }
+
+        if(sha256) {
+            for(const auto &entry: manifest.entries) {
+                if(!entry.sha256.has_value()) {
+                    return false;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    void GenerateManifest(const std::string &rom_path, const std::string &out_path, const std::string &jobs, const bool sha256, const bool use_cache) {
+        twl::u32 thread_count = twl::util::GetDefaultThreadCount();
+        if(!jobs.empty()) {
+            if(!twl::util::ConvertStringToNumber(jobs, thread_count) || (thread_count == 0)) {
+                std::cerr << "Invalid job count '" << jobs << "'" << std::endl;
+                return;
+            }
+        }
+
+        twl::fmt::ROMIndexCache cache(twl::fmt::ROMIndexCache::GetDefaultCachePath(rom_path));
+        twl::fmt::ROMIndexCache::Key cache_key;
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::FsMetadata);
+        twl::fmt::ROMManifest manifest;
+        auto cache_loaded = false;
+        if(use_cache) {
+            R_TRY_ERRLOG(twl::fmt::ROMIndexCache::ComputeKey(rom_path, cache_key), "Unable to access ROM file '" << rom_path << "'");
+            cache_loaded = cache.Load(cache_key, rom, manifest).IsSuccess();
+        }
+
+        if(!cache_loaded || !IsCachedManifestComplete(rom, manifest, sha256)) {
+            twl::fs::MappedFile rom_file(rom_path);
+            R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+            twl::ScopeGuard close_file([&]() {
+                rom_file.Close();
+            });
+
+            // The filesystem index is already there if the cache was loaded (just the manifest was missing)
+            if(!cache_loaded) {
+                if(use_cache) {
+                    rom.read_opts = twl::fmt::ROMIndexCache::CachedReadOptions;
+                }
+                R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
+            }
+
+            R_TRY_ERRLOG(manifest.Compute(rom, rom_file.GetData(), rom_file.GetDataSize(), sha256, thread_count), "Unable to compute ROM manifest");
+
+            if(use_cache) {
+                const auto rc = cache.Save(cache_key, rom, manifest);
+                if(rc.IsFailure()) {
+                    std::cerr << "Unable to save ROM index cache '" << cache.cache_path << "': " << rc.GetDescription() << std::endl;
+                }
+            }
+        }
+
+        std::ofstream out_file;
+        if(!out_path.empty()) {
+            out_file.open(out_path);
+            if(!out_file) {
+                std::cerr << "Unable to open output manifest file '" << out_path << "'" << std::endl;
+                return;
+            }
+        }
+        auto &out_strm = out_path.empty() ? std::cout : out_file;
+
+        for(const auto &entry: manifest.entries) {
+            out_strm << "{\"file_id\":" << entry.file_id;
+            out_strm << ",\"path\":\"" << EscapeJsonString(entry.path) << "\"";
+            out_strm << ",\"offset\":" << entry.offset;
+            out_strm << ",\"size\":" << entry.size;
+            out_strm << ",\"xxh64\":\"" << std::hex << std::setw(16) << std::setfill('0') << entry.xxhash64 << std::dec << std::setfill(' ') << "\"";
+            if(sha256 && entry.sha256.has_value()) {
+                out_strm << ",\"sha256\":\"" << FormatHexBytes(entry.sha256.value().data(), entry.sha256.value().size()) << "\"";
+            }
+            switch(entry.lz_ver) {
+                case twl::util::LzVersion::LZ10: {
+                    out_strm << ",\"compression\":\"LZ10\"";
+                    break;
+                }
+                case twl::util::LzVersion::LZ11: {
+                    out_strm << ",\"compression\":\"LZ11\"";
+                    break;
+                }
+                default: {
+                    out_strm << ",\"compression\":null";
+                    break;
+                }
+            }
+            out_strm << ",\"decompressed_size\":" << entry.decompressed_size << "}\n";
+        }
+
+        out_strm.flush();
+    }
+
+    void PrintMultiHash(const std::string &name, const size_t size, const twl::util::MultiHash &hash) {
+        std::cout << name << " (" << size << " bytes):" << std::endl;
+        std::cout << "> CRC32: " << std::hex << std::setw(8) << std::setfill('0') << hash.crc32 << std::dec << std::setfill(' ') << std::endl;
+        std::cout << "> MD5: " << FormatHexBytes(hash.md5.data(), hash.md5.size()) << std::endl;
+        std::cout << "> SHA-1: " << FormatHexBytes(hash.sha1.data(), hash.sha1.size()) << std::endl;
+        std::cout << "> SHA-256: " << FormatHexBytes(hash.sha256.data(), hash.sha256.size()) << std::endl;
+    }
+
+    void HashROM(const std::string &rom_path) {
+        twl::fs::StdioFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        twl::fmt::ROMImageHash hash;
+        R_TRY_ERRLOG(hash.Compute(rom_file), "Unable to hash ROM file '" << rom_path << "'");
+
+        PrintMultiHash("Trimmed", hash.trimmed_size, hash.trimmed);
+        PrintMultiHash("Full", hash.full_size, hash.full);
+    }
+
+    void PrintOffsetOwner(const twl::fmt::ROMOffsetIndex &index, const size_t offset) {
+        std::cout << "0x" << std::hex << offset << std::dec << ": ";
+
+        const auto region = index.Find(offset);
+        if(region == nullptr) {
+            std::cout << "outside of the image (" << index.image_size << " bytes)" << std::endl;
+            return;
+        }
+
+        std::cout << twl::fmt::ROMOffsetIndex::GetOwnerKindName(region->kind);
+        if(region->kind == twl::fmt::ROMOffsetIndex::OwnerKind::File) {
+            const auto &file = index.GetFile(*region);
+            std::cout << " " << file.file_id;
+            if(!file.path.empty()) {
+                std::cout << " '" << file.path << "'";
+            }
+        }
+        std::cout << " +0x" << std::hex << (offset - region->start) << " [0x" << region->start << ", 0x" << region->end << ")" << std::dec << std::endl;
+    }
+
+    // Offsets are read from standard input (one per line) if none are given, in order to handle big batches
+    void LocateOffsets(const std::string &rom_path, const std::vector<std::string> &offsets) {
+        twl::fs::StdioFile rom_file(rom_path);
+        R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+        twl::ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        size_t image_size;
+        R_TRY_ERRLOG(rom_file.GetSize(image_size), "Unable to get ROM file size");
+
+        // LibSymbols also loads the Nitro footer, so that its bytes after ARM9 aren't reported as unused
+        twl::fmt::ROM rom(twl::fmt::ROM::ReadOptions::FsMetadata | twl::fmt::ROM::ReadOptions::LibSymbols);
+        R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
+
+        twl::fmt::ROMOffsetIndex index;
+        index.Build(rom, image_size);
+
+        auto locate = [&](const std::string &raw_offset) {
+            size_t offset;
+            try {
+                offset = std::stoull(raw_offset, nullptr, 0);
+            }
+            catch(std::exception&) {
+                std::cerr << "Invalid offset '" << raw_offset << "'" << std::endl;
+                return;
+            }
+            PrintOffsetOwner(index, offset);
+        };
+
+        if(!offsets.empty()) {
+            for(const auto &raw_offset: offsets) {
+                locate(raw_offset);
+            }
+        }
+        else {
+            std::string line;
+            while(std::getline(std::cin, line)) {
+                if(!line.empty()) {
+                    locate(line);
+                }
+            }
+        }
+    }
+
+    // Workspace files mirror the ROM filesystem tree, with file data as stored in the ROM (extra files like overlays aren't part of it)
+
+    twl::Result LoadWorkspaceFile(const std::filesystem::path &path, twl::fmt::nfs::NitroFile &nitro_file, bool &out_changed) {
+        twl::fs::StdioFile file(path.string());
+        TWL_R_TRY(file.OpenRead(twl::fs::FileCompression::None));
+        twl::ScopeGuard close_file([&]() {
+            file.Close();
+        });
+
+        size_t file_size;
+        TWL_R_TRY(file.GetSize(file_size));
+        auto file_buf = new twl::u8[file_size]();
+        twl::ScopeGuard delete_buf([&]() {
+            delete[] file_buf;
+        });
+        TWL_R_TRY(file.ReadBuffer(file_buf, file_size));
+
+        // Editors often rewrite files without changing them
+        out_changed = (file_size != nitro_file.inner_file.GetBufferSize()) || (std::memcmp(file_buf, nitro_file.inner_file.GetBuffer(), file_size) != 0);
+        if(out_changed) {
+            delete_buf.Cancel();
+            nitro_file.inner_file.CreateFrom(file_buf, file_size);
+        }
+        TWL_R_SUCCEED();
+    }
+
+    // Missing workspace files are extracted, existing ones are loaded into the ROM
+    twl::Result SyncWorkspace(twl::fmt::ROM &rom, const std::filesystem::path &dir_path, size_t &out_loaded_count, size_t &out_extracted_count) {
+        out_loaded_count = 0;
+        out_extracted_count = 0;
+
+        std::vector<twl::fmt::nfs::NitroFileSystem::FileListEntry> files;
+        rom.GetFs().ListAllFiles(files);
+        for(const auto &file: files) {
+            if(file.path.empty()) {
+                continue;
+            }
+
+            const auto file_path = dir_path / file.path.substr(1);
+            std::error_code ec;
+            if(std::filesystem::exists(file_path, ec)) {
+                bool changed;
+                TWL_R_TRY(LoadWorkspaceFile(file_path, *file.file, changed));
+                if(changed) {
+                    out_loaded_count++;
+                }
+            }
+            else {
+                std::filesystem::create_directories(file_path.parent_path(), ec);
+                twl::fs::StdioFile out_file(file_path.string());
+                TWL_R_TRY(out_file.OpenWrite());
+                const auto rc = out_file.WriteBuffer(file.file->inner_file.GetBuffer(), file.file->inner_file.GetBufferSize());
+                out_file.Close();
+                TWL_R_TRY(rc);
+                out_extracted_count++;
+            }
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    twl::Result WriteWatchOutput(twl::fmt::ROM &rom, twl::fmt::ROM::LayoutPlan &plan, const std::string &out_rom_path) {
+        TWL_R_TRY(rom.PlanLayout(twl::fmt::ROM::GetDefaultLayoutPolicy(), plan));
+
+        twl::fs::StdioFile out_rom_file(out_rom_path);
+        TWL_R_TRY(out_rom_file.OpenWrite());
+        const auto rc = rom.WriteTo(out_rom_file, plan);
+        out_rom_file.Close();
+        TWL_R_TRY(rc);
+        TWL_R_SUCCEED();
+    }
+
+    // Files are patched into the existing output while they fit where they are, otherwise the whole output is laid out again
+    twl::Result UpdateWatchOutput(twl::fmt::ROM &rom, twl::fmt::ROM::LayoutPlan &plan, const std::string &out_rom_path, const std::vector<twl::fmt::nfs::NitroFile*> &changed_files, bool &out_relaid_out) {
+        out_relaid_out = false;
+
+        twl::fs::StdioFile out_rom_file(out_rom_path);
+        TWL_R_TRY(out_rom_file.OpenUpdate());
+        auto rc = twl::ResultSuccess;
+        for(const auto file: changed_files) {
+            rc = rom.UpdateFileInPlace(out_rom_file, plan, *file);
+            if(rc.IsFailure()) {
+                break;
+            }
+        }
+        out_rom_file.Close();
+
+        if(rc.value == twl::ResultROMFileDoesNotFitInPlace.value) {
+            TWL_R_TRY(WriteWatchOutput(rom, plan, out_rom_path));
+            out_relaid_out = true;
+            TWL_R_SUCCEED();
+        }
+        TWL_R_TRY(rc);
+        TWL_R_SUCCEED();
+    }
+
+    #ifdef __linux__
+
+    // Watch descriptors are mapped to their directory (as a NitroFS path)
+    void AddWorkspaceWatches(const int inotify_fd, const std::filesystem::path &dir_path, const std::string &fs_dir_path, std::unordered_map<int, std::string> &wd_paths) {
+        const auto wd = inotify_add_watch(inotify_fd, dir_path.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if(wd < 0) {
+            std::cerr << "Unable to watch directory '" << dir_path.string() << "'" << std::endl;
+            return;
+        }
+        wd_paths[wd] = fs_dir_path;
+
+        std::error_code ec;
+        for(std::filesystem::directory_iterator it(dir_path, ec), end; it != end; it.increment(ec)) {
+            if(ec) {
+                break;
+            }
+            if(it->is_directory(ec)) {
+                AddWorkspaceWatches(inotify_fd, it->path(), fs_dir_path + "/" + it->path().filename().string(), wd_paths);
+            }
+        }
+    }
+
+    // Waits (up to the timeout, or forever if negative) for workspace events, collecting the NitroFS paths of written files
+    bool ReadWorkspaceEvents(const int inotify_fd, const int timeout_ms, const std::filesystem::path &dir_path, std::unordered_map<int, std::string> &wd_paths, std::set<std::string> &out_paths) {
+        pollfd poll_fd = {
+            .fd = inotify_fd,
+            .events = POLLIN
+        };
+        if(poll(&poll_fd, 1, timeout_ms) <= 0) {
+            return false;
+        }
+
+        alignas(inotify_event) char event_buf[0x1000];
+        const auto read_size = read(inotify_fd, event_buf, sizeof(event_buf));
+        if(read_size <= 0) {
+            return false;
+        }
+
+        for(ssize_t offset = 0; offset < read_size;) {
+            const auto event = reinterpret_cast<const inotify_event*>(event_buf + offset);
+            offset += sizeof(inotify_event) + event->len;
+
+            const auto wd_it = wd_paths.find(event->wd);
+            if((wd_it == wd_paths.end()) || (event->len == 0)) {
+                continue;
+            }
+
+            const auto fs_path = wd_it->second + "/" + event->name;
+            if(event->mask & IN_ISDIR) {
+                if(event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                    AddWorkspaceWatches(inotify_fd, dir_path / fs_path.substr(1), fs_path, wd_paths);
+                }
+            }
+            else if(event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+                out_paths.insert(fs_path);
+            }
+        }
+
+        return true;
+    }
+
+    #endif
+
+    void WatchROM(const std::string &rom_path, const std::string &dir_path, const std::string &out_rom_path) {
+        #ifdef __linux__
+
+        if(out_rom_path == twl::fs::StdioFile::StdStreamPath) {
+            std::cerr << "The output ROM must be a regular file in watch mode" << std::endl;
+            return;
+        }
+
+        twl::fmt::ROM rom;
+        {
+            twl::fs::StdioFile rom_file(rom_path);
+            R_TRY_ERRLOG(rom_file.OpenRead(twl::fs::FileCompression::None), "Unable to open ROM file '" << rom_path << "'");
+
+            twl::ScopeGuard close_file([&]() {
+                rom_file.Close();
+            });
+
+            R_TRY_ERRLOG(rom.ReadFrom(rom_file), "Unable to read ROM file '" << rom_path << "'");
+        }
+
+        size_t loaded_count;
+        size_t extracted_count;
+        R_TRY_ERRLOG(SyncWorkspace(rom, dir_path, loaded_count, extracted_count), "Unable to sync workspace directory '" << dir_path << "'");
+        std::cout << "Workspace '" << dir_path << "': " << extracted_count << " file(s) extracted, " << loaded_count << " modified file(s) loaded" << std::endl;
+
+        twl::fmt::ROM::LayoutPlan plan = {};
+        twl::ScopeGuard dispose_plan([&]() {
+            plan.Dispose();
+        });
+        R_TRY_ERRLOG(WriteWatchOutput(rom, plan, out_rom_path), "Unable to write output ROM file '" << out_rom_path << "'");
+        std::cout << "Wrote '" << out_rom_path << "' (" << plan.total_size << " bytes)" << std::endl;
+
+        const auto inotify_fd = inotify_init1(IN_CLOEXEC);
+        if(inotify_fd < 0) {
+            std::cerr << "Unable to initialize inotify" << std::endl;
+            return;
+        }
+        twl::ScopeGuard close_inotify([&]() {
+            close(inotify_fd);
+        });
+
+        std::unordered_map<int, std::string> wd_paths;
+        AddWorkspaceWatches(inotify_fd, dir_path, "", wd_paths);
+        std::cout << "Watching for changes (Ctrl+C to stop)..." << std::endl;
+
+        constexpr int EventSettleTimeMs = 100;
+        while(true) {
+            // Batch together everything written in quick succession (editors, asset pipelines...)
+
+            std::set<std::string> changed_paths;
+            if(!ReadWorkspaceEvents(inotify_fd, -1, dir_path, wd_paths, changed_paths)) {
+                continue;
+            }
+            while(ReadWorkspaceEvents(inotify_fd, EventSettleTimeMs, dir_path, wd_paths, changed_paths)) {}
+
+            const auto start_time = std::chrono::steady_clock::now();
+
+            std::vector<twl::fmt::nfs::NitroFile*> changed_files;
+            for(const auto &fs_path: changed_paths) {
+                const auto file_path = std::filesystem::path(dir_path) / fs_path.substr(1);
+                twl::fmt::nfs::NitroFileSystemFile nitro_file;
+                if(rom.CreateFileByPath(nitro_file, fs_path).IsFailure()) {
+                    // Temporary files (already renamed/removed by the time they get here) aren't worth mentioning
+                    std::error_code ec;
+                    if(std::filesystem::exists(file_path, ec)) {
+                        std::cout << "Ignoring '" << fs_path << "' (not in the ROM filesystem)" << std::endl;
+                    }
+                    continue;
+                }
+
+                bool changed;
+                const auto rc = LoadWorkspaceFile(file_path, *nitro_file.file_ref, changed);
+                if(rc.IsFailure()) {
+                    std::cerr << "Unable to load '" << fs_path << "': " << rc.GetDescription() << std::endl;
+                    continue;
+                }
+                if(changed) {
+                    changed_files.push_back(nitro_file.file_ref);
+                }
+            }
+            if(changed_files.empty()) {
+                continue;
+            }
+
+            bool relaid_out;
+            const auto rc = UpdateWatchOutput(rom, plan, out_rom_path, changed_files, relaid_out);
+            const auto elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start_time).count();
+            if(rc.IsFailure()) {
+                std::cerr << "Unable to update output ROM file '" << out_rom_path << "': " << rc.GetDescription() << std::endl;
+            }
+            else if(relaid_out) {
+                std::cout << "Rewrote '" << out_rom_path << "' with " << changed_files.size() << " changed file(s) (" << elapsed_ms << " ms)" << std::endl;
+            }
+            else {
+                std::cout << "Patched " << changed_files.size() << " file(s) in place (" << elapsed_ms << " ms)" << std::endl;
+            }
+        }
+
+        #else
+
+        std::cerr << "Watch mode is only supported on Linux (inotify)" << std::endl;
+
+        #endif
+    }
+
     void HandleCommand(const std::vector<std::string> &args) {
         args::ArgumentParser parser("Module for DS(i) ROM files");
         args::HelpFlag help(parser, "help", "Displays this help menu", {'h', "help"});
@@ -336,6 +1253,64 @@ namespace {
         args::ValueFlag<std::string> replace_codes_arm9_code_file(replace_codes_required, "arm9_code_file", "Input ARM9 code file", {'9', "in9"});
         args::ValueFlag<std::string> replace_codes_out_rom_file(replace_codes_required, "out_rom_file", "Output ROM file", {'o', "out"});
 
+        args::Command diff(commands, "diff", "Compare two ROMs (header, banner, code, overlays and filesystem files)");
+        args::Group diff_required(diff, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> diff_rom_file(diff_required, "rom_file", "Input (original) ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> diff_mod_rom_file(diff_required, "mod_rom_file", "Input modified ROM file", {'m', "mod"});
+
+        args::Command create_patch(commands, "create-patch", "Create a BPS patch from an original ROM to a modified ROM");
+        args::Group create_patch_required(create_patch, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> create_patch_rom_file(create_patch_required, "rom_file", "Input (original) ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> create_patch_mod_rom_file(create_patch_required, "mod_rom_file", "Input modified ROM file", {'m', "mod"});
+        args::ValueFlag<std::string> create_patch_out_patch_file(create_patch_required, "out_patch_file", "Output BPS patch file", {'o', "out"});
+
+        args::Command apply_patch(commands, "apply-patch", "Apply an IPS, BPS or VCDIFF patch to a ROM (checksums are verified if the patch has them)");
+        args::Group apply_patch_required(apply_patch, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> apply_patch_rom_file(apply_patch_required, "rom_file", "Input ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> apply_patch_patch_file(apply_patch_required, "patch_file", "Input IPS/BPS/VCDIFF patch file", {'p', "patch"});
+        args::ValueFlag<std::string> apply_patch_out_rom_file(apply_patch_required, "out_rom_file", "Output patched ROM file", {'o', "out"});
+
+        args::Command rebuild(commands, "rebuild", "Rebuild a ROM with a custom filesystem data layout (file order, alignment, trimming and padding)");
+        args::Group rebuild_required(rebuild, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> rebuild_rom_file(rebuild_required, "rom_file", "Input ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> rebuild_out_rom_file(rebuild, "out_rom_file", "Output ROM file ('-' for standard output, since it's written sequentially)", {'o', "out"});
+        args::ValueFlag<std::string> rebuild_order(rebuild, "order", "File data order (walk, path, size or trace)", {"order"});
+        args::ValueFlag<std::string> rebuild_trace_file(rebuild, "trace_file", "Access trace file (file IDs or paths, one per line), implies trace order", {'t', "trace"});
+        args::ValueFlag<std::string> rebuild_align(rebuild, "align", "File data alignment (power of two, 0x200 by default)", {'a', "align"});
+        args::Flag rebuild_trim(rebuild, "trim", "Don't pad after the last file", {"trim"});
+        args::Flag rebuild_pad(rebuild, "pad", "Pad the output ROM up to its full capacity", {"pad"});
+        args::Flag rebuild_dry_run(rebuild, "dry_run", "Only print the planned layout and output size, without writing anything", {"dry-run"});
+
+        args::Command scan(commands, "scan", "Scan a directory of ROMs (recursively, in parallel) and output a JSON-lines summary of each one");
+        args::Group scan_required(scan, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> scan_dir(scan_required, "dir", "Input directory (.nds, .dsi and .srl files are scanned)", {'d', "dir"});
+        args::ValueFlag<std::string> scan_jobs(scan, "jobs", "Worker thread count (hardware thread count by default)", {'j', "jobs"});
+        args::ValueFlag<std::string> scan_out_file(scan, "out_file", "Output summary file (standard output by default)", {'o', "out"});
+        args::Flag scan_cache(scan, "cache", "Use (and create/refresh) a sidecar index cache next to each ROM (<rom-file>.twlidx)", {"cache"});
+
+        args::Command manifest(commands, "manifest", "Output a JSON-lines manifest of every filesystem file (location, hashes and LZ compression), computed in parallel");
+        args::Group manifest_required(manifest, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> manifest_rom_file(manifest_required, "rom_file", "Input ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> manifest_out_file(manifest, "out_file", "Output manifest file (standard output by default)", {'o', "out"});
+        args::ValueFlag<std::string> manifest_jobs(manifest, "jobs", "Worker thread count (hardware thread count by default)", {'j', "jobs"});
+        args::Flag manifest_sha256(manifest, "sha256", "Also compute SHA-256 hashes (slower)", {"sha256"});
+        args::Flag manifest_cache(manifest, "cache", "Use (and create/refresh) a sidecar index cache next to the ROM (<rom-file>.twlidx)", {"cache"});
+
+        args::Command hash(commands, "hash", "Compute CRC32, MD5, SHA-1 and SHA-256 of the trimmed and full ROM image (in a single pass)");
+        args::Group hash_required(hash, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> hash_rom_file(hash_required, "rom_file", "Input ROM file", {'r', "rom"});
+
+        args::Command locate(commands, "locate", "Find what owns each given offset of a ROM image (header, code, overlay tables, FNT, FAT, banner, a filesystem file or unused space)");
+        args::Group locate_required(locate, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> locate_rom_file(locate_required, "rom_file", "Input ROM file", {'r', "rom"});
+        args::ValueFlagList<std::string> locate_offsets(locate, "offset", "Offset to locate (can be specified multiple times, read from standard input one per line otherwise)", {'a', "offset"});
+
+        args::Command watch(commands, "watch", "Keep rebuilding a ROM while its filesystem files are edited in a workspace directory (only changed files are rewritten, in place when possible)");
+        args::Group watch_required(watch, "", args::Group::Validators::All);
+        args::ValueFlag<std::string> watch_rom_file(watch_required, "rom_file", "Input ROM file", {'r', "rom"});
+        args::ValueFlag<std::string> watch_dir(watch_required, "dir", "Workspace directory (missing files are extracted there first)", {'d', "dir"});
+        args::ValueFlag<std::string> watch_out_rom_file(watch_required, "out_rom_file", "Output ROM file", {'o', "out"});
+
         try {
             parser.ParseArgs(args);
         }
@@ -432,6 +1407,67 @@ namespace {
 
             ReplaceCodes(rom_path, arm7_code_path, arm9_code_path, out_rom_path);
         }
+        else if(diff) {
+            const auto rom_path = diff_rom_file.Get();
+            const auto mod_rom_path = diff_mod_rom_file.Get();
+
+            DiffROMs(rom_path, mod_rom_path);
+        }
+        else if(create_patch) {
+            const auto rom_path = create_patch_rom_file.Get();
+            const auto mod_rom_path = create_patch_mod_rom_file.Get();
+            const auto out_patch_path = create_patch_out_patch_file.Get();
+
+            CreatePatch(rom_path, mod_rom_path, out_patch_path);
+        }
+        else if(apply_patch) {
+            const auto rom_path = apply_patch_rom_file.Get();
+            const auto patch_path = apply_patch_patch_file.Get();
+            const auto out_rom_path = apply_patch_out_rom_file.Get();
+
+            ApplyPatch(rom_path, patch_path, out_rom_path);
+        }
+        else if(rebuild) {
+            const auto rom_path = rebuild_rom_file.Get();
+            const auto out_rom_path = rebuild_out_rom_file.Get();
+            const auto order = rebuild_order.Get();
+            const auto trace_path = rebuild_trace_file.Get();
+            const auto align = rebuild_align.Get();
+
+            RebuildROM(rom_path, out_rom_path, order, trace_path, align, rebuild_trim.Get(), rebuild_pad.Get(), rebuild_dry_run.Get());
+        }
+        else if(scan) {
+            const auto dir_path = scan_dir.Get();
+            const auto jobs = scan_jobs.Get();
+            const auto out_path = scan_out_file.Get();
+
+            ScanROMs(dir_path, jobs, out_path, scan_cache.Get());
+        }
+        else if(manifest) {
+            const auto rom_path = manifest_rom_file.Get();
+            const auto out_path = manifest_out_file.Get();
+            const auto jobs = manifest_jobs.Get();
+
+            GenerateManifest(rom_path, out_path, jobs, manifest_sha256.Get(), manifest_cache.Get());
+        }
+        else if(hash) {
+            const auto rom_path = hash_rom_file.Get();
+
+            HashROM(rom_path);
+        }
+        else if(locate) {
+            const auto rom_path = locate_rom_file.Get();
+            const auto offsets = locate_offsets.Get();
+
+            LocateOffsets(rom_path, offsets);
+        }
+        else if(watch) {
+            const auto rom_path = watch_rom_file.Get();
+            const auto dir_path = watch_dir.Get();
+            const auto out_rom_path = watch_out_rom_file.Get();
+
+            WatchROM(rom_path, dir_path, out_rom_path);
+        }
     }
 
 }
@@ -450,7 +1486,7 @@ ETWL_MOD_DEFINE_END()
 
 ETWL_MOD_SYMBOL bool ETWL_MOD_TRY_HANDLE_INPUT_SYMBOL(const QString &path, etwl::mod::Context *ctx) {
     twl::fs::StdioFile rf(path.toStdString());
-    auto rc = rf.OpenRead();
+    auto rc = rf.OpenRead(twl::fs::FileCompression::None);
     if(rc.IsSuccess()) {
         twl::ScopeGuard close_f([&]() {
             rf.Close();
@@ -26,6 +26,18 @@ namespace twl::fmt {
 
         static constexpr size_t SectionAlignment = 0x4;
 
+        struct LayoutPlan {
+            Header header;
+            FileAllocationTableBlock fat;
+            FileNameTableBlock fnt;
+            FileImageBlock fimg;
+            nfs::NitroFileSystem::LayoutPlan fs_plan;
+
+            inline void Dispose() {
+                this->fs_plan.Dispose();
+            }
+        };
+
         Header header;
         FileAllocationTableBlock fat;
         FileNameTableBlock fnt;
@@ -37,6 +49,10 @@ namespace twl::fmt {
         
         Result ReadValidateFrom(fs::File &rf) override;
         Result ReadAllFrom(fs::File &rf) override;
+        // Dry run: computes the whole output layout without writing anything (nor modifying the NARC)
+        Result PlanLayout(LayoutPlan &out_plan);
+
+        // The output is written strictly sequentially, thus it doesn't need to be seekable
         Result WriteTo(fs::File &wf) override;
     };
 
@@ -5,6 +5,7 @@
 #include <twl/util/util_String.hpp>
 #include <twl/gfx/gfx_BannerIcon.hpp>
 #include <optional>
+#include <string_view>
 
 namespace twl::fmt {
 
@@ -43,6 +44,22 @@ namespace twl::fmt {
             SkipHealthSafetyPress = TWL_BITMASK(2)
         };
 
+        enum class ReadOptions : u32 {
+            None = 0,
+            Banner = TWL_BITMASK(0),
+            OverlayTables = TWL_BITMASK(1),
+            Code = TWL_BITMASK(2),
+            LibSymbols = TWL_BITMASK(3),
+            FsMetadata = TWL_BITMASK(4), // Directory/file structure and file offsets/sizes, without their contents
+            FsContents = TWL_BITMASK(5), // Implies FsMetadata
+            DecompressCode = TWL_BITMASK(6), // ARM9 static code and overlays are BLZ-decompressed after being loaded (if they were loaded)
+
+            Default = Banner | OverlayTables | Code | LibSymbols | FsMetadata | FsContents,
+            // Everything that gets written back (the header is always loaded)
+            // File contents are optional: the ones not loaded get copied from the source ROM file when writing (see NitroFileSystem::contents_source), which then can't be the output file itself
+            Writable = Banner | OverlayTables | Code | FsMetadata
+        };
+
         struct Header {
             char game_title[12];
             char game_code[4];
@@ -167,6 +184,17 @@ namespace twl::fmt {
             u32 static_init_end_address;
             u32 file_id;
             u32 compressed_size_and_flags;
+
+            static constexpr u32 CompressedSizeMask = 0xFFFFFF;
+            static constexpr u32 CompressedFlag = TWL_BITMASK(24);
+
+            inline bool IsCompressed() const {
+                return (this->compressed_size_and_flags & CompressedFlag) != 0;
+            }
+
+            inline u32 GetCompressedSize() const {
+                return this->compressed_size_and_flags & CompressedSizeMask;
+            }
         };
         static_assert(sizeof(OverlayTableEntry) == 0x20);
         
@@ -194,30 +222,90 @@ namespace twl::fmt {
 
         static constexpr size_t SectionAlignment = 0x200;
 
+        struct LayoutPolicy {
+            nfs::NitroFileSystem::WriteLayout fs_layout;
+            bool pad_to_capacity; // Extend the output up to the full device capacity (sparse where supported)
+        };
+
+        static inline LayoutPolicy GetDefaultLayoutPolicy() {
+            return {
+                .fs_layout = {
+                    .order = nfs::NitroFileSystem::FileDataOrder::TreeWalk,
+                    .file_align = SectionAlignment,
+                    .trim_last_padding = false,
+                    .access_trace = {}
+                },
+                .pad_to_capacity = false
+            };
+        }
+
+        struct LayoutPlan {
+            Header header; // With all section offsets/sizes (and the device capacity) already set
+            nfs::NitroFileSystem::LayoutPlan fs_plan;
+            size_t file_data_offset;
+            size_t total_size; // Final output size (including capacity padding, if requested)
+
+            inline void Dispose() {
+                this->fs_plan.Dispose();
+            }
+        };
+
         Header header;
         Banner banner;
-        std::vector<std::string> lib_symbols;
+        // Symbols point into the owned symbol data block
+        std::vector<char> lib_symbols_data;
+        std::vector<std::string_view> lib_symbols;
         fs::BufferReaderWriter arm7_rw;
         fs::BufferReaderWriter arm9_rw;
         std::optional<NitroFooter> footer;
         std::optional<StartModuleParams> start_module_params;
         std::vector<OverlayTableEntry> arm7_ovl_table;
         std::vector<OverlayTableEntry> arm9_ovl_table;
+        ReadOptions read_opts;
 
-        ROM() {}
+        ROM() : read_opts(ReadOptions::Default) {}
+        ROM(const ReadOptions read_opts) : read_opts(read_opts) {}
         ROM(const ROM&) = delete;
         ROM(ROM&&) = default;
         
         Result ReadValidateFrom(fs::File &rf) override;
         Result ReadAllFrom(fs::File &rf) override;
-        Result WriteTo(fs::File &wf) override;
+        // Dry run: computes the whole output layout without writing anything (nor modifying the ROM)
+        Result PlanLayout(const LayoutPolicy &policy, LayoutPlan &out_plan);
+
+        // The output is written strictly sequentially, thus it doesn't need to be seekable (pipes, sockets...)
+        Result WriteTo(fs::File &wf, const LayoutPolicy &policy);
+        // Same, with an already computed layout
+        Result WriteTo(fs::File &wf, LayoutPlan &plan);
+
+        // Rewrites a single file (its data and FAT entry) in an image previously written with the given plan, updating the plan as well
+        // This only works if the new contents fit where the file was placed (up to the next file in the data order), otherwise this fails with ResultROMFileDoesNotFitInPlace and a full rewrite is needed
+        Result UpdateFileInPlace(fs::File &wf, LayoutPlan &plan, nfs::NitroFile &file);
+
+        inline Result WriteTo(fs::File &wf) override {
+            TWL_R_TRY(this->WriteTo(wf, GetDefaultLayoutPolicy()));
+            TWL_R_SUCCEED();
+        }
 
         inline Result CreateOverlayFile(nfs::NitroFileSystemFile &file, const OverlayTableEntry &entry) {
             TWL_R_TRY(this->CreateFileById(file, entry.file_id));
             TWL_R_SUCCEED();
         }
+
+        // Combined options are only reported as set if all of them are
+        inline bool HasReadOption(const ReadOptions opt) {
+            return (static_cast<u32>(this->read_opts) & static_cast<u32>(opt)) == static_cast<u32>(opt);
+        }
+
+        inline bool IsArm9Compressed() {
+            return this->start_module_params.has_value() && (this->start_module_params.value().compressed_static_end != 0);
+        }
+
+        // Decompresses ARM9 static code and all compressed overlays (in parallel), clearing their compressed end/size and flags afterwards
+        Result DecompressCode();
     };
 
     TWL_ENUM_BIT_OPERATORS(ROM::AutostartFlags, u8)
+    TWL_ENUM_BIT_OPERATORS(ROM::ReadOptions, u32)
 
 }
@@ -0,0 +1,43 @@
+#pragma once
+#include <twl/fmt/fmt_ROM.hpp>
+
+namespace twl::fmt {
+
+    struct ROMDiff {
+
+        enum class EntryKind : u8 {
+            Header,
+            Banner,
+            Code,
+            OverlayTable,
+            Overlay,
+            File
+        };
+
+        enum class ChangeType : u8 {
+            Added,
+            Removed,
+            Changed,
+            Renamed
+        };
+
+        struct Entry {
+            EntryKind kind;
+            ChangeType change;
+            std::string old_name;
+            std::string new_name;
+            size_t old_size;
+            size_t new_size;
+        };
+
+        std::vector<Entry> entries;
+
+        // Everything compared besides the header, which is always loaded
+        static constexpr ROM::ReadOptions RequiredReadOptions = ROM::ReadOptions::Banner | ROM::ReadOptions::OverlayTables | ROM::ReadOptions::FsMetadata;
+
+        // Both ROMs only need RequiredReadOptions loaded, code and file contents are hashed straight from the (ideally memory-mapped) ROM images
+        // Files are first matched by path, then unmatched ones by content hash (reported as renames)
+        Result Compute(ROM &old_rom, const u8 *old_rom_data, const size_t old_rom_data_size, ROM &new_rom, const u8 *new_rom_data, const size_t new_rom_data_size);
+    };
+
+}
@@ -0,0 +1,19 @@
+#pragma once
+#include <twl/fmt/fmt_ROM.hpp>
+#include <twl/util/util_Hash.hpp>
+
+namespace twl::fmt {
+
+    struct ROMImageHash {
+        static constexpr size_t ReadChunkSize = 4_MB;
+
+        size_t trimmed_size; // Header ROM size (clamped to the actual image size)
+        size_t full_size;
+        util::MultiHash trimmed;
+        util::MultiHash full;
+
+        // The image is read once, sequentially, and the next chunk is read while the current one is being hashed
+        Result Compute(fs::File &rf);
+    };
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <twl/fmt/fmt_ROMManifest.hpp>
+
+namespace twl::fmt {
+
+    // Sidecar file with everything a metadata-only ROM read produces (header, overlay tables, footer/static module params, lib symbols and the filesystem index), plus the file manifest
+    // Loading it restores the ROM as if it was read with OverlayTables | LibSymbols | FsMetadata, without parsing the ROM itself
+
+    struct ROMIndexCache {
+
+        // The cache is only valid for the exact ROM file it was saved from
+        struct Key {
+            std::string rom_path; // Absolute
+            u64 rom_size;
+            i64 rom_mtime;
+            u16 header_crc16; // Over the whole header (not the one stored in it, which might not have been updated)
+
+            inline bool operator==(const Key &other) const {
+                return (this->rom_path == other.rom_path) && (this->rom_size == other.rom_size) && (this->rom_mtime == other.rom_mtime) && (this->header_crc16 == other.header_crc16);
+            }
+
+            inline bool operator!=(const Key &other) const {
+                return !(*this == other);
+            }
+        };
+
+        static constexpr u32 Magic = 0x58444954; // "TIDX"
+        static constexpr u32 Version = 2;
+        static constexpr const char DefaultExtension[] = ".twlidx";
+
+        static constexpr ROM::ReadOptions CachedReadOptions = ROM::ReadOptions::OverlayTables | ROM::ReadOptions::LibSymbols | ROM::ReadOptions::FsMetadata;
+
+        std::string cache_path;
+
+        ROMIndexCache(const std::string &cache_path) : cache_path(cache_path) {}
+
+        static inline std::string GetDefaultCachePath(const std::string &rom_path) {
+            return rom_path + DefaultExtension;
+        }
+
+        // Only stats the ROM and reads its header, so it's cheap enough to do on every open
+        static Result ComputeKey(const std::string &rom_path, Key &out_key);
+
+        // Fails with ResultROMIndexCacheOutdated if the cache was saved for a different key
+        Result Load(const Key &key, ROM &out_rom, ROMManifest &out_manifest);
+
+        // The manifest might be empty (only the ROM metadata gets cached then)
+        // The key should be computed before reading the ROM, so that a ROM modified in the meantime never gets a valid cache
+        Result Save(const Key &key, ROM &rom, const ROMManifest &manifest);
+    };
+
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <twl/fmt/fmt_ROM.hpp>
+#include <twl/util/util_Compression.hpp>
+#include <twl/util/util_Hash.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <optional>
+
+namespace twl::fmt {
+
+    struct ROMManifest {
+
+        struct Entry {
+            std::string path; // Empty for extra files (overlays)
+            u16 file_id;
+            size_t offset;
+            size_t size;
+            u64 xxhash64;
+            std::optional<util::Sha256Hash> sha256;
+            util::LzVersion lz_ver; // Invalid if the file doesn't look LZ-compressed
+            size_t decompressed_size; // Same as the size if not compressed
+        };
+
+        std::vector<Entry> entries; // Sorted by file ID
+
+        // The ROM only needs its filesystem metadata loaded (see ROM::ReadOptions::FsMetadata), file contents are hashed straight from the (ideally memory-mapped) ROM image
+        Result Compute(ROM &rom, const u8 *rom_data, const size_t rom_data_size, const bool compute_sha256, const u32 thread_count = util::GetDefaultThreadCount());
+    };
+
+}
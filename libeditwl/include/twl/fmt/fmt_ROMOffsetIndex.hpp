@@ -0,0 +1,54 @@
+#pragma once
+#include <twl/fmt/fmt_ROM.hpp>
+
+namespace twl::fmt {
+
+    // Maps any byte offset of a ROM image to whatever owns it, as laid out by its header and FAT
+
+    struct ROMOffsetIndex {
+
+        enum class OwnerKind : u8 {
+            Header,
+            Arm9, // Including the nitro footer, if present
+            Arm9OverlayTable,
+            Arm7,
+            Arm7OverlayTable,
+            Fnt,
+            Fat,
+            Banner,
+            File,
+            Unused // Padding or free space
+        };
+
+        struct Region {
+            size_t start;
+            size_t end;
+            OwnerKind kind;
+            u32 file_idx; // Index in files (only for File regions)
+        };
+
+        struct FileInfo {
+            u16 file_id;
+            std::string path; // Empty for extra files (overlays)
+        };
+
+        // Sorted, non-overlapping and contiguous, covering the whole image
+        std::vector<Region> regions;
+        std::vector<FileInfo> files;
+        size_t image_size;
+
+        // The ROM must have been read with (at least) FsMetadata for files to be indexed
+        // Overlapping sections (only found in malformed images) are resolved in favor of the one starting first (ROM sections before files if they start at the same offset)
+        void Build(ROM &rom, const size_t image_size);
+
+        // Binary search over the regions, nullptr if the offset is outside the image
+        const Region *Find(const size_t offset) const;
+
+        inline const FileInfo &GetFile(const Region &region) const {
+            return this->files.at(region.file_idx);
+        }
+
+        static const char *GetOwnerKindName(const OwnerKind kind);
+    };
+
+}
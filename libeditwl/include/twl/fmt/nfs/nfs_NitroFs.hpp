@@ -8,7 +8,12 @@ namespace twl::fmt::nfs {
     struct NitroFile {
         std::string name;
         u16 file_id;
+        // Location of the file data in the source it was read from (these are still set if contents weren't loaded)
+        size_t data_offset;
+        size_t data_size;
         fs::BufferFile inner_file;
+        // Contents are always kept as stored (compressed or not), this is just how they were last accessed through NitroFileSystemFile, so that writing them with FileCompression::Auto keeps the same format
+        fs::FileCompressionInfo comp_info = fs::UnknownFileCompressionInfo;
 
         inline void Dispose() {
             this->inner_file.Dispose();
@@ -35,6 +40,56 @@ namespace twl::fmt::nfs {
             u32 file_end;
         };
 
+        struct FileListEntry {
+            std::string path;
+            NitroFile *file;
+        };
+
+        enum class FileDataOrder : u8 {
+            TreeWalk, // Same order as the (rewritten) FAT: extra files first, then a walk of the tree with each directory's files before its subdirectories
+            Path, // Sorted by full path
+            Size, // Smallest files first (packs small files together)
+            AccessTrace // Files in the access trace first (in trace order), then the remaining ones in tree-walk order
+        };
+
+        struct WriteLayout {
+            FileDataOrder order;
+            size_t file_align; // Alignment of each file's data start (must be a power of two)
+            bool trim_last_padding; // Don't pad after the last file
+            std::vector<u16> access_trace; // File IDs (as read from the source, see NitroFile::file_id)
+        };
+
+        // Everything needed to write the filesystem, computed before writing anything
+        struct LayoutPlan {
+            std::vector<DirectoryNameTableEntry> fnt; // Directory entry starts are relative to the name data (not to the FNT start)
+            fs::BufferReaderWriter fnt_data;
+            std::vector<FileAllocationTableEntry> fat; // Offsets are relative to the file data start
+            std::vector<NitroFile*> files; // By file ID
+            std::vector<u16> data_order; // File IDs, in the order their data is placed
+            size_t file_data_size;
+
+            inline size_t GetFntEntriesSize() {
+                return this->fnt.size() * sizeof(DirectoryNameTableEntry);
+            }
+
+            inline size_t GetFntSize() {
+                return this->GetFntEntriesSize() + this->fnt_data.GetBufferSize();
+            }
+
+            inline size_t GetFatSize() {
+                return this->fat.size() * sizeof(FileAllocationTableEntry);
+            }
+
+            inline void Dispose() {
+                this->fnt.clear();
+                this->fnt_data.Dispose();
+                this->fat.clear();
+                this->files.clear();
+                this->data_order.clear();
+                this->file_data_size = 0;
+            }
+        };
+
         static constexpr u16 RootDirectoryId = 0xF000;
         static constexpr size_t MaxEntryNameLength = 128;
 
@@ -42,9 +97,36 @@ namespace twl::fmt::nfs {
         size_t fnt_data_offset;
         NitroDirectory root_dir;
         std::vector<NitroFile> ext_files;
+        // Set if contents weren't loaded: files still not loaded when writing get copied straight from here (which must still be opened by then), so only edited files go through memory
+        fs::File *contents_source = nullptr;
 
-        Result ReadFrom(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset);
-        Result WriteTo(fs::BufferReaderWriter &out_fnt_data, fs::BufferReaderWriter &out_file_data, std::vector<NitroFileSystem::DirectoryNameTableEntry> &out_fnt, std::vector<NitroFileSystem::FileAllocationTableEntry> &out_fat, const size_t file_end_align);
+        Result ReadFrom(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset, const bool read_contents = true);
+
+        inline bool IsFileBackedBySource(NitroFile &file) {
+            return (this->contents_source != nullptr) && (file.inner_file.GetBuffer() == nullptr);
+        }
+
+        // Writing over the contents source would destroy the file contents still to be copied from it
+        inline bool IsContentsSource(fs::File &file) {
+            return (this->contents_source != nullptr) && this->contents_source->IsSameFile(file);
+        }
+
+        inline size_t GetFileSize(NitroFile &file) {
+            return this->IsFileBackedBySource(file) ? file.data_size : file.inner_file.GetBufferSize();
+        }
+
+        // Loads the contents of a file backed by the source (in order to edit them), does nothing otherwise
+        Result LoadFileContents(NitroFile &file);
+
+        // Writes the contents of a single file, either from memory or copied from the source
+        Result WriteFileContents(fs::AbstractReaderWriter &wf, NitroFile &file);
+        Result PlanLayout(const WriteLayout &layout, LayoutPlan &out_plan);
+
+        // Writes all file contents strictly sequentially (no seeking), padding between them as planned
+        Result WriteFileData(fs::AbstractReaderWriter &wf, const LayoutPlan &plan);
+
+        // Extra files (outside the tree) are listed first, with an empty path
+        void ListAllFiles(std::vector<FileListEntry> &out_files);
 
         void Dispose();
     };
@@ -52,10 +134,20 @@ namespace twl::fmt::nfs {
     class NitroFileSystemFile : public fs::File {
         public:
             NitroFile *file_ref;
+            // Set when created from a filesystem, in order to load the contents of files backed by its source on open
+            NitroFileSystem *nitro_fs;
 
         public:
-            NitroFileSystemFile() : File(), file_ref(nullptr) {}
-            NitroFileSystemFile(NitroFile *file_ref) : File(), file_ref(file_ref) {}
+            NitroFileSystemFile() : File(), file_ref(nullptr), nitro_fs(nullptr) {}
+            NitroFileSystemFile(NitroFile *file_ref) : File(), file_ref(file_ref), nitro_fs(nullptr) {
+                this->SetCompressionInfo(file_ref->comp_info);
+            }
+
+            inline void SetFileRef(NitroFileSystem &nitro_fs, NitroFile *file_ref) {
+                this->file_ref = file_ref;
+                this->nitro_fs = std::addressof(nitro_fs);
+                this->SetCompressionInfo(file_ref->comp_info);
+            }
 
             Result CreateById(NitroFileSystem &nitro_fs, const u32 file_id);
             Result CreateByPath(NitroFileSystem &nitro_fs, const std::string &path);
@@ -66,6 +158,12 @@ namespace twl::fmt::nfs {
 
             Result OpenImpl(const fs::FileMode mode) override;
 
+            // Unlike other files, members are read as they are stored unless some compression (FileCompression::Auto included) is explicitly requested
+            inline Result OpenRead(const fs::FileCompression comp = fs::FileCompression::None) {
+                TWL_R_TRY(File::OpenRead(comp));
+                TWL_R_SUCCEED();
+            }
+
             inline Result GetSizeImpl(size_t &out_size) override {
                 TWL_R_TRY(this->file_ref->inner_file.GetSizeImpl(out_size));
                 TWL_R_SUCCEED();
@@ -91,7 +189,12 @@ namespace twl::fmt::nfs {
                 TWL_R_SUCCEED();
             }
 
+            inline bool KeepsContentsOnWrite() override {
+                return this->file_ref->inner_file.KeepsContentsOnWrite();
+            }
+
             inline Result CloseImpl() override {
+                this->file_ref->comp_info = this->GetCompressionInfo();
                 TWL_R_TRY(this->file_ref->inner_file.CloseImpl());
                 TWL_R_SUCCEED();
             }
@@ -5,21 +5,23 @@
 #include <twl/util/util_Align.hpp>
 #include <cstdio>
 #include <cstring>
+#include <optional>
 
 namespace twl::fs {
 
     enum class FileMode : u8 {
         Invalid,
         Read,
-        Write
+        Write,
+        Update // Read + write on an existing file, without truncating it (uncompressed only)
     };
 
     inline constexpr bool CanReadWithMode(const FileMode mode) {
-        return mode == FileMode::Read;
+        return (mode == FileMode::Read) || (mode == FileMode::Update);
     }
 
     inline constexpr bool CanWriteWithMode(const FileMode mode) {
-        return mode == FileMode::Write;
+        return (mode == FileMode::Write) || (mode == FileMode::Update);
     }
 
     enum class Whence : u8 {
@@ -31,7 +33,32 @@ namespace twl::fs {
         Invalid,
         Auto,
         None,
-        LZ77
+        LZ77,
+        Huffman,
+        RLE
+    };
+
+    // Compression a file was last read/written with, which lets it be written back the same way
+    struct FileCompressionInfo {
+        FileCompression comp; // Invalid if still unknown
+        util::LzVersion lz_ver;
+        util::HuffmanVersion huffman_ver;
+    };
+
+    constexpr FileCompressionInfo UnknownFileCompressionInfo = {
+        .comp = FileCompression::Invalid,
+        .lz_ver = util::LzVersion::Invalid,
+        .huffman_ver = util::HuffmanVersion::Invalid
+    };
+
+    // Identifies a file on disk, which tells whether two Files access the same one
+    struct FileIdentity {
+        u64 device;
+        u64 inode;
+
+        inline constexpr bool operator==(const FileIdentity &other) const {
+            return (this->device == other.device) && (this->inode == other.inode);
+        }
     };
 
     class AbstractReaderWriter {
@@ -128,6 +155,29 @@ namespace twl::fs {
                 return this->WriteBuffer(str, str_len);
             }
 
+            // Writes zeros in bounded chunks (padding might be as big as the whole ROM capacity)
+            inline Result WritePadding(const size_t pad_size) {
+                if(pad_size == 0) {
+                    TWL_R_SUCCEED();
+                }
+
+                constexpr size_t MaxChunkSize = 0x10000;
+                const auto chunk_size = std::min(pad_size, MaxChunkSize);
+                auto zero_buf = new u8[chunk_size]();
+                ScopeGuard cleanup([&]() {
+                    delete[] zero_buf;
+                });
+
+                auto left_size = pad_size;
+                while(left_size > 0) {
+                    const auto write_size = std::min(left_size, chunk_size);
+                    TWL_R_TRY(this->WriteBuffer(zero_buf, write_size));
+                    left_size -= write_size;
+                }
+
+                TWL_R_SUCCEED();
+            }
+
             inline Result WriteEnsureAlignmentPadding(const size_t align, size_t &out_pad_size) {
                 if(align == 0) {
                     TWL_R_SUCCEED();
@@ -158,6 +208,10 @@ namespace twl::fs {
                 return this->WriteBuffer(vec.data(), vec.size() * sizeof(T));
             }
 
+            // Writes (at the current offset) data read from another reader/writer at the given offset there, whose offset is left unchanged
+            // By default this just goes through a bounded intermediate buffer
+            virtual Result CopyFrom(AbstractReaderWriter &src_rw, const size_t src_offset, const size_t copy_size);
+
             template<typename C>
             inline Result WriteNullTerminatedString(const std::basic_string<C> &str) {
                 TWL_R_TRY(this->WriteString(str));
@@ -171,16 +225,17 @@ namespace twl::fs {
         private:
             void *buf;
             size_t buf_size;
+            size_t buf_capacity;
             size_t offset;
 
         public:
-            constexpr BufferReaderWriter() : buf(nullptr), buf_size(0), offset(0) {}
+            constexpr BufferReaderWriter() : buf(nullptr), buf_size(0), buf_capacity(0), offset(0) {}
             
-            inline BufferReaderWriter(const size_t buf_size) : buf(nullptr), buf_size(0), offset(0) {
+            inline BufferReaderWriter(const size_t buf_size) : buf(nullptr), buf_size(0), buf_capacity(0), offset(0) {
                 this->CreateAllocate(buf_size);
             }
 
-            inline BufferReaderWriter(void *buf, const size_t buf_size, const bool transfer_ownership = true) : buf(nullptr), buf_size(0), offset(0) {
+            inline BufferReaderWriter(void *buf, const size_t buf_size, const bool transfer_ownership = true) : buf(nullptr), buf_size(0), buf_capacity(0), offset(0) {
                 this->CreateFrom(buf, buf_size, transfer_ownership);
             }
 
@@ -198,6 +253,7 @@ namespace twl::fs {
                 }
 
                 this->buf_size = 0;
+                this->buf_capacity = 0;
                 this->offset = 0;
             }
 
@@ -239,17 +295,21 @@ namespace twl::fs {
 
         private:
             bool opened;
+            bool dirty;
             FileCompression comp;
             util::LzVersion lz_ver;
+            util::LzCompressOptions lz_comp_opts;
+            util::HuffmanVersion huffman_ver;
+            util::CompressionCache *comp_cache;
             BufferReaderWriter decomp_rw;
 
-            Result DecompressRead();
+            Result DecompressRead(const bool probe);
             Result CompressWrite();
 
             Result Open(const FileMode mode, const FileCompression comp);
 
         public:
-            constexpr File() : mode(FileMode::Invalid), opened(false), comp(FileCompression::Invalid), lz_ver(util::LzVersion::Invalid), decomp_rw() {}
+            constexpr File() : mode(FileMode::Invalid), opened(false), dirty(false), comp(FileCompression::Invalid), lz_ver(util::LzVersion::Invalid), lz_comp_opts(util::DefaultLzCompressOptions), huffman_ver(util::HuffmanVersion::Invalid), comp_cache(nullptr), decomp_rw() {}
 
             File(const File&) = delete;
             File(File&&) = default;
@@ -258,10 +318,46 @@ namespace twl::fs {
                 return this->opened;
             }
 
+            inline FileMode GetMode() {
+                return this->mode;
+            }
+
+            // Only tracked for compressed files, whose contents are only compressed back on close if they were actually modified (see KeepsContentsOnWrite)
+            inline bool IsDirty() {
+                return this->dirty;
+            }
+
             inline constexpr bool IsCompressed() {
                 return (this->comp != FileCompression::Invalid) && (this->comp != FileCompression::None);    
             }
 
+            // Used when compressed contents are written back on close (release builds might want optimal compression, while fast compression suits quick iteration)
+            inline void SetLzCompressOptions(const util::LzCompressOptions &opts) {
+                this->lz_comp_opts = opts;
+            }
+
+            inline FileCompressionInfo GetCompressionInfo() {
+                return {
+                    .comp = this->comp,
+                    .lz_ver = this->lz_ver,
+                    .huffman_ver = this->huffman_ver
+                };
+            }
+
+            // Only meant to be used while closed, for OpenWrite(FileCompression::Auto) to reuse compression detected by an earlier read of the same contents (through some other File)
+            inline void SetCompressionInfo(const FileCompressionInfo &info) {
+                if(!this->opened) {
+                    this->comp = info.comp;
+                    this->lz_ver = info.lz_ver;
+                    this->huffman_ver = info.huffman_ver;
+                }
+            }
+
+            // Also used for LZ unless the LZ options specify their own cache
+            inline void SetCompressionCache(util::CompressionCache *cache) {
+                this->comp_cache = cache;
+            }
+
             virtual Result OpenImpl(const FileMode mode) = 0;
             virtual Result GetSizeImpl(size_t &out_size) = 0;
             virtual Result SetOffsetImpl(const size_t offset, const Whence whence) = 0;
@@ -270,6 +366,32 @@ namespace twl::fs {
             virtual Result WriteBufferImpl(const void *write_buf, const size_t write_size) = 0;
             virtual Result CloseImpl() = 0;
 
+            // Default implementation appends zeros, files supporting sparse extension should override this
+            virtual Result ExtendImpl(const size_t new_size);
+
+            // Only used when neither file is compressed, files supporting copies without going through user memory should override this
+            virtual Result CopyFromImpl(File &src_file, const size_t src_offset, const size_t copy_size);
+
+            // Whether opening for writing leaves the current contents in place (instead of truncating them), in which case unmodified compressed files aren't compressed again on close
+            virtual bool KeepsContentsOnWrite() {
+                return false;
+            }
+
+            // Only available for opened files on disk (and not on Windows, where no device/inode numbers are available)
+            virtual bool GetIdentity(FileIdentity&) {
+                return false;
+            }
+
+            inline bool IsSameFile(File &other) {
+                if(this == std::addressof(other)) {
+                    return true;
+                }
+
+                FileIdentity id;
+                FileIdentity other_id;
+                return this->GetIdentity(id) && other.GetIdentity(other_id) && (id == other_id);
+            }
+
             inline Result OpenRead(const FileCompression comp = FileCompression::Auto) {
                 TWL_R_TRY(this->Open(fs::FileMode::Read, comp));
                 TWL_R_SUCCEED();
@@ -280,6 +402,11 @@ namespace twl::fs {
                 TWL_R_SUCCEED();
             }
 
+            inline Result OpenUpdate(const FileCompression comp = FileCompression::None) {
+                TWL_R_TRY(this->Open(fs::FileMode::Update, comp));
+                TWL_R_SUCCEED();
+            }
+
             inline Result GetSize(size_t &out_size) override {
                 if(this->IsCompressed()) {
                     out_size = this->decomp_rw.GetBufferSize();
@@ -296,6 +423,11 @@ namespace twl::fs {
             Result ReadBuffer(void *read_buf, const size_t read_size) override;
             Result WriteBuffer(const void *write_buf, const size_t write_size) override;
 
+            // Grows the file (zero-filled) to the given size, without changing the current offset (does nothing if the file is already that big)
+            Result Extend(const size_t new_size);
+
+            Result CopyFrom(AbstractReaderWriter &src_rw, const size_t src_offset, const size_t copy_size) override;
+
             Result Close();
     };
 
@@ -303,9 +435,14 @@ namespace twl::fs {
         private:
             std::string path;
             FILE *file;
+            bool is_std_stream;
+            size_t std_stream_offset;
 
         public:
-            inline StdioFile(const std::string &path) : File(), path(path), file(nullptr) {}
+            // "-" stands for the standard input/output (depending on the mode), which can only be read/written sequentially
+            static constexpr const char StdStreamPath[] = "-";
+
+            inline StdioFile(const std::string &path) : File(), path(path), file(nullptr), is_std_stream(false), std_stream_offset(0) {}
 
             StdioFile(const StdioFile&) = delete;
             StdioFile(StdioFile&&) = default;
@@ -317,6 +454,70 @@ namespace twl::fs {
             Result ReadBufferImpl(void *read_buf, const size_t read_size) override;
             Result WriteBufferImpl(const void *write_buf, const size_t write_size) override;
             Result CloseImpl() override;
+            Result ExtendImpl(const size_t new_size) override;
+            Result CopyFromImpl(File &src_file, const size_t src_offset, const size_t copy_size) override;
+            bool GetIdentity(FileIdentity &out_id) override;
+
+            inline std::string &GetPath() {
+                return this->path;
+            }
+    };
+
+    // Read-only file backed by a memory mapping (or by a plain in-memory copy where mapping is not available)
+    // Its contents can also be accessed directly, which avoids any copies for bulk hashing/comparison
+
+    class MappedFile : public File {
+        private:
+            std::string path;
+            const u8 *data;
+            size_t data_size;
+            size_t offset;
+            std::optional<FileIdentity> identity;
+
+        public:
+            inline MappedFile(const std::string &path) : File(), path(path), data(nullptr), data_size(0), offset(0), identity() {}
+
+            MappedFile(const MappedFile&) = delete;
+            MappedFile(MappedFile&&) = default;
+
+            Result OpenImpl(const FileMode mode) override;
+
+            inline Result GetSizeImpl(size_t &out_size) override {
+                out_size = this->data_size;
+                TWL_R_SUCCEED();
+            }
+
+            Result SetOffsetImpl(const size_t offset, const Whence whence) override;
+
+            inline Result GetOffsetImpl(size_t &out_offset) override {
+                out_offset = this->offset;
+                TWL_R_SUCCEED();
+            }
+
+            Result ReadBufferImpl(void *read_buf, const size_t read_size) override;
+
+            inline Result WriteBufferImpl(const void*, const size_t) override {
+                TWL_R_FAIL(ResultWriteNotSupported);
+            }
+
+            Result CloseImpl() override;
+
+            inline bool GetIdentity(FileIdentity &out_id) override {
+                if(this->identity.has_value()) {
+                    out_id = this->identity.value();
+                    return true;
+                }
+
+                return false;
+            }
+
+            inline const u8 *GetData() {
+                return this->data;
+            }
+
+            inline size_t GetDataSize() {
+                return this->data_size;
+            }
 
             inline std::string &GetPath() {
                 return this->path;
@@ -379,6 +580,10 @@ namespace twl::fs {
             Result ReadBufferImpl(void *read_buf, const size_t read_size) override;
             Result WriteBufferImpl(const void *write_buf, const size_t write_size) override;
             Result CloseImpl() override;
+
+            inline bool KeepsContentsOnWrite() override {
+                return true;
+            }
     };
 
 }
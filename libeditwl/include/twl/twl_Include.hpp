@@ -115,6 +115,7 @@ namespace twl {
 
     constexpr Result ResultNitroFsDirectoryNotFound = 0x0301;
     constexpr Result ResultNitroFsFileNotFound = 0x0302;
+    constexpr Result ResultNitroFsInvalidFileAlignment = 0x0303;
 
     constexpr Result ResultBMGInvalidHeader = 0x0401;
     constexpr Result ResultBMGInvalidInfoSection = 0x0402;
@@ -169,13 +170,37 @@ namespace twl {
 
     constexpr Result ResultROMInvalidUnitCode = 0x0e01;
     constexpr Result ResultROMInvalidNintendoLogoCRC16 = 0x0e02;
+    constexpr Result ResultROMSectionsNotLoaded = 0x0e03;
+    constexpr Result ResultROMFileDataOutOfBounds = 0x0e04;
+    constexpr Result ResultROMInvalidIndexCache = 0x0e05;
+    constexpr Result ResultROMIndexCacheOutdated = 0x0e06;
+    constexpr Result ResultROMFileDoesNotFitInPlace = 0x0e07;
+    constexpr Result ResultROMOutputIsContentsSource = 0x0e08;
 
     constexpr Result ResultCompressionInvalidLzFormat = 0x0f01;
     constexpr Result ResultCompressionTooBigCompressSize = 0x0f02;
     constexpr Result ResultCompressionInvalidRepeatSize = 0x0f03;
+    constexpr Result ResultCompressionInvalidBlzFormat = 0x0f04;
+    constexpr Result ResultCompressionInvalidLzLevel = 0x0f05;
+    constexpr Result ResultCompressionInvalidLzData = 0x0f06;
+    constexpr Result ResultCompressionOutputTooBig = 0x0f07;
+    constexpr Result ResultCompressionInvalidHuffmanFormat = 0x0f08;
+    constexpr Result ResultCompressionInvalidHuffmanData = 0x0f09;
+    constexpr Result ResultCompressionHuffmanTreeLayoutFailed = 0x0f0a;
+    constexpr Result ResultCompressionInvalidRleFormat = 0x0f0b;
+    constexpr Result ResultCompressionInvalidRleData = 0x0f0c;
 
     constexpr Result ResultUtilityInvalidSections = 0x1001;
 
+    constexpr Result ResultPatchInvalidFormat = 0x1101;
+    constexpr Result ResultPatchInvalidData = 0x1102;
+    constexpr Result ResultPatchSourceSizeMismatch = 0x1103;
+    constexpr Result ResultPatchSourceChecksumMismatch = 0x1104;
+    constexpr Result ResultPatchTargetChecksumMismatch = 0x1105;
+    constexpr Result ResultPatchChecksumMismatch = 0x1106;
+    constexpr Result ResultPatchUnsupportedFeature = 0x1107;
+    constexpr Result ResultPatchOutputNotReadable = 0x1108;
+
     using ResultDescriptionEntry = std::pair<Result, const char*>;
 
     constexpr ResultDescriptionEntry ResultDescriptionTable[] = {
@@ -214,6 +239,7 @@ namespace twl {
 
         { ResultNitroFsDirectoryNotFound, "NitroFs directory not found" },
         { ResultNitroFsFileNotFound, "NitroFs file not found" },
+        { ResultNitroFsInvalidFileAlignment, "Invalid NitroFs file alignment (must be a power of two)" },
 
         { ResultBMGInvalidHeader, "Invalid BMG header" },
         { ResultBMGInvalidInfoSection, "Invalid BMG INF1 section" },
@@ -266,7 +292,38 @@ namespace twl {
         { ResultSTRMInvalidDataSection, "Invalid STRM data section" },
         { ResultSTRMWriteNotSupported, "Unsupported feature: writing to STRM" },
 
-        { ResultUtilityInvalidSections, "Invalid DWC utility sections" }
+        { ResultROMInvalidUnitCode, "Invalid ROM unit code" },
+        { ResultROMInvalidNintendoLogoCRC16, "Invalid ROM Nintendo logo CRC16" },
+        { ResultROMSectionsNotLoaded, "ROM sections required for writing were not loaded (see read options)" },
+        { ResultROMFileDataOutOfBounds, "ROM file data is out of the image bounds" },
+        { ResultROMInvalidIndexCache, "Invalid or unsupported ROM index cache" },
+        { ResultROMIndexCacheOutdated, "ROM index cache is outdated (the ROM changed since it was saved)" },
+        { ResultROMFileDoesNotFitInPlace, "ROM file doesn't fit in its current location (a full rewrite is needed)" },
+        { ResultROMOutputIsContentsSource, "Output ROM file is the one the ROM was read from without its file contents (read them with FsContents to write over it)" },
+
+        { ResultCompressionInvalidLzFormat, "Invalid LZ compression format" },
+        { ResultCompressionTooBigCompressSize, "Data too big to be compressed" },
+        { ResultCompressionInvalidRepeatSize, "Invalid LZ repeat size" },
+        { ResultCompressionInvalidBlzFormat, "Invalid BLZ (backward LZ) compressed data" },
+        { ResultCompressionInvalidLzLevel, "Invalid LZ compression level" },
+        { ResultCompressionInvalidLzData, "Invalid (truncated or corrupted) LZ compressed data" },
+        { ResultCompressionOutputTooBig, "Decompressed size exceeds the allowed maximum" },
+        { ResultCompressionInvalidHuffmanFormat, "Invalid Huffman compression format" },
+        { ResultCompressionInvalidHuffmanData, "Invalid (truncated or corrupted) Huffman compressed data" },
+        { ResultCompressionHuffmanTreeLayoutFailed, "Unable to fit the Huffman tree in the BIOS tree format" },
+        { ResultCompressionInvalidRleFormat, "Invalid RLE compression format" },
+        { ResultCompressionInvalidRleData, "Invalid (truncated or corrupted) RLE compressed data" },
+
+        { ResultUtilityInvalidSections, "Invalid DWC utility sections" },
+
+        { ResultPatchInvalidFormat, "Invalid or unsupported patch format" },
+        { ResultPatchInvalidData, "Invalid patch data" },
+        { ResultPatchSourceSizeMismatch, "Patch source size mismatch" },
+        { ResultPatchSourceChecksumMismatch, "Patch source checksum mismatch" },
+        { ResultPatchTargetChecksumMismatch, "Patch target checksum mismatch" },
+        { ResultPatchChecksumMismatch, "Patch checksum mismatch" },
+        { ResultPatchUnsupportedFeature, "Unsupported patch feature (VCDIFF secondary compression or custom code table)" },
+        { ResultPatchOutputNotReadable, "Patch copies from further back in the output than kept in memory, which needs a readable output file" }
     };
 
     inline constexpr Result GetResultDescription(const Result rc, std::string &out_desc) {
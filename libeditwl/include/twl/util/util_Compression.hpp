@@ -4,6 +4,8 @@
 
 namespace twl::util {
 
+    class CompressionCache;
+
     enum class LzVersion : u8 {
         Invalid = 0,
         LZ10 = 0x10,
@@ -17,37 +19,150 @@ namespace twl::util {
     constexpr u64 MaximumLZ11CompressSize = 1ull << static_cast<u64>(4 * CHAR_BIT);
 
     constexpr u32 LZ10RepeatSize = 18;
-    constexpr u32 MaximumLZ11RepeatSize = 65809;
+    constexpr u32 MaximumLZ11RepeatSize = 0xFFFF + 0x111; // Longest 4-byte match form
     constexpr u32 DefaultRepeatSize = LZ10RepeatSize;
 
+    constexpr u32 GetLzMaximumRepeatSize(const LzVersion ver) {
+        return (ver == LzVersion::LZ11) ? MaximumLZ11RepeatSize : LZ10RepeatSize;
+    }
+
     Result LzValidateCompressed(const u32 lz_header, LzVersion &out_ver);
 
-    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *&out_data, size_t &out_size);
+    // All levels produce the same format (any of them can be decoded by the hardware), they just trade speed for size
+    enum class LzCompressLevel : u8 {
+        Fast, // Greedy parsing (longest match at each position)
+        Lazy, // Matches are deferred if the next position has a longer one
+        Optimal // Shortest-path parse over every literal/match choice (smallest output, slowest)
+    };
+
+    constexpr LzCompressLevel DefaultLzCompressLevel = LzCompressLevel::Lazy;
+
+    // How many earlier positions (closest first) are checked for the longest match at each position: higher depths compress better but slower
+    constexpr u32 GetLzDefaultMaximumChainDepth(const LzCompressLevel level) {
+        switch(level) {
+            case LzCompressLevel::Fast:
+                return 16;
+            case LzCompressLevel::Lazy:
+                return 128;
+            default:
+                return 512;
+        }
+    }
+
+    struct LzCompressOptions {
+        LzCompressLevel level;
+        u32 repeat_size; // Maximum match length, 0 for the maximum the version supports
+        u32 max_chain_depth; // 0 for the level's default
+        u32 thread_count; // Big inputs have their matches searched in parallel (with the same output), 0 for the hardware thread count
+        CompressionCache *cache; // Optional, outputs for the same data and options are reused from it
+    };
+
+    constexpr LzCompressOptions DefaultLzCompressOptions = {
+        .level = DefaultLzCompressLevel,
+        .repeat_size = 0,
+        .max_chain_depth = 0,
+        .thread_count = 0,
+        .cache = nullptr
+    };
+
+    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const LzCompressOptions &opts, u8 *&out_data, size_t &out_size);
 
+    inline Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *&out_data, size_t &out_size) {
+        auto opts = DefaultLzCompressOptions;
+        opts.repeat_size = repeat_size;
+        return LzCompress(data, data_size, ver, opts, out_data, out_size);
+    }
+
+    // Uses the longest matches the version supports
     inline Result LzCompressDefault(const u8 *data, const size_t data_size, const LzVersion ver, u8 *&out_data, size_t &out_size) {
-        return LzCompress(data, data_size, ver, DefaultRepeatSize, out_data, out_size);
+        return LzCompress(data, data_size, ver, DefaultLzCompressOptions, out_data, out_size);
     }
 
     inline Result LzCompressV10(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size) {
         return LzCompress(data, data_size, LzVersion::LZ10, DefaultRepeatSize, out_data, out_size);
     }
 
-    Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size);
+    // Bytes from the start of compressed data (or less, if the data is smaller) accessed by the header probes below
+    constexpr size_t CompressedHeaderProbeSize = 2 * sizeof(u32);
+
+    // Cheap check (without reading the whole stream) of the header against the total data size: the decompressed size must be reachable from that much data, and the data can't be longer than the worst case encoding of that size
+    Result LzProbeCompressedHeader(const u8 *header, const size_t data_size, LzVersion &out_ver, size_t &out_decomp_size);
 
-    inline Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size) {
+    // Validates the whole stream without decompressing it (or allocating anything), and checks that it ends right at the end of the data (allowing padding up to 4 bytes)
+    // Uncompressed data which just happens to start like compressed data is very unlikely to pass this, unlike the header check alone
+    Result LzProbeCompressed(const u8 *data, const size_t data_size, LzVersion &out_ver, size_t &out_decomp_size);
+
+    // Every read and back-reference is validated against the given sizes, thus corrupted data only makes this fail
+    // Output sizes bigger than max_out_size (or than the input could possibly expand to) are rejected before allocating anything
+    Result LzDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size);
+
+    inline Result LzDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size) {
         LzVersion dummy_ver;
         size_t dummy_size;
-        return LzDecompress(data, out_data, out_size, dummy_ver, dummy_size);
+        return LzDecompress(data, data_size, MaximumLZ11CompressSize, out_data, out_size, dummy_ver, dummy_size);
     }
 
-    inline Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver) {
+    inline Result LzDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size, LzVersion &out_ver) {
         size_t dummy_size;
-        return LzDecompress(data, out_data, out_size, out_ver, dummy_size);
+        return LzDecompress(data, data_size, MaximumLZ11CompressSize, out_data, out_size, out_ver, dummy_size);
     }
 
-    inline Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, size_t &out_used_data_size) {
+    inline Result LzDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size, size_t &out_used_data_size) {
         LzVersion dummy_ver;
-        return LzDecompress(data, out_data, out_size, dummy_ver, out_used_data_size);
+        return LzDecompress(data, data_size, MaximumLZ11CompressSize, out_data, out_size, dummy_ver, out_used_data_size);
     }
 
+    // BIOS Huffman and RLE formats share the LZ header layout (type byte followed by the 3-byte decompressed size)
+
+    enum class HuffmanVersion : u8 {
+        Invalid = 0,
+        Huffman4 = 0x24, // 4-bit symbols (nibbles, low one first)
+        Huffman8 = 0x28 // 8-bit symbols
+    };
+
+    constexpr size_t MaximumHuffmanCompressSize = MaximumLZ10CompressSize;
+
+    Result HuffmanValidateCompressed(const u32 huffman_header, HuffmanVersion &out_ver);
+
+    Result HuffmanCompress(const u8 *data, const size_t data_size, const HuffmanVersion ver, u8 *&out_data, size_t &out_size, CompressionCache *cache = nullptr);
+
+    // Same checks as LzProbeCompressedHeader/LzProbeCompressed
+    Result HuffmanProbeCompressedHeader(const u8 *header, const size_t data_size, HuffmanVersion &out_ver, size_t &out_decomp_size);
+    Result HuffmanProbeCompressed(const u8 *data, const size_t data_size, HuffmanVersion &out_ver, size_t &out_decomp_size);
+
+    // Like LzDecompress, corrupted data (including malformed trees) only makes this fail
+    Result HuffmanDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size, HuffmanVersion &out_ver);
+
+    inline Result HuffmanDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size) {
+        HuffmanVersion dummy_ver;
+        return HuffmanDecompress(data, data_size, MaximumHuffmanCompressSize, out_data, out_size, dummy_ver);
+    }
+
+    constexpr u8 RleCompressionType = 0x30;
+    constexpr size_t MaximumRleCompressSize = MaximumLZ10CompressSize;
+
+    Result RleValidateCompressed(const u32 rle_header);
+
+    Result RleCompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size, CompressionCache *cache = nullptr);
+
+    // Same checks as LzProbeCompressedHeader/LzProbeCompressed
+    Result RleProbeCompressedHeader(const u8 *header, const size_t data_size, size_t &out_decomp_size);
+    Result RleProbeCompressed(const u8 *data, const size_t data_size, size_t &out_decomp_size);
+
+    Result RleDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size);
+
+    inline Result RleDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size) {
+        return RleDecompress(data, data_size, MaximumRleCompressSize, out_data, out_size);
+    }
+
+    // BLZ (backward LZ) is the SDK's compression for ARM9 static code and overlays: data is decoded from the end towards the start (thus can be decompressed in-place), and the start may be left uncompressed
+    // The last 8 bytes are a footer with the compressed region size (plus footer size), the footer size and the size increase after decompressing
+
+    constexpr size_t BlzFooterSize = 2 * sizeof(u32);
+
+    Result BlzDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size);
+
+    // The first raw_head_size bytes are always kept uncompressed (ARM9 static code keeps its first 0x4000 bytes uncompressed, for instance)
+    Result BlzCompress(const u8 *data, const size_t data_size, const size_t raw_head_size, u8 *&out_data, size_t &out_size);
+
 }
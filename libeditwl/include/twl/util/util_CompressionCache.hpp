@@ -0,0 +1,76 @@
+#pragma once
+#include <twl/util/util_Hash.hpp>
+#include <mutex>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace twl::util {
+
+    // Maps uncompressed data (by its SHA-256) plus everything affecting the encoder output to the compressed output, so that unchanged data is never compressed twice
+    // Entries are kept in memory and, if a directory is given, also stored there (one file per entry, written atomically), thus the directory can be shared between builds or machines
+
+    class CompressionCache {
+        public:
+            struct Key {
+                Sha256Hash data_hash;
+                u8 comp_type; // Header type byte (LZ/Huffman/RLE version)
+                u8 level;
+                u32 repeat_size;
+                u32 max_chain_depth;
+
+                std::string ToString() const;
+            };
+
+            static constexpr u32 EntryMagic = 0x43435754; // "TWCC"
+            // Must be bumped whenever an encoder changes its output, so that entries from older versions are ignored
+            static constexpr u32 EntryVersion = 1;
+
+            static constexpr size_t DefaultMaximumMemorySize = 256_MB;
+
+        private:
+            std::string dir_path;
+            size_t max_mem_size;
+            std::mutex lock;
+            std::unordered_map<std::string, std::vector<u8>> mem_entries;
+            std::deque<std::string> mem_entry_order;
+            size_t mem_size;
+            std::atomic_size_t hit_count;
+            std::atomic_size_t miss_count;
+
+            void StoreInMemory(const std::string &key_str, std::vector<u8> &&comp_data);
+
+        public:
+            // An empty directory keeps the cache in memory only, while the oldest entries are dropped from memory once it takes more than max_mem_size
+            CompressionCache(const std::string &dir_path = "", const size_t max_mem_size = DefaultMaximumMemorySize) : dir_path(dir_path), max_mem_size(max_mem_size), mem_size(0), hit_count(0), miss_count(0) {}
+
+            static inline Key MakeKey(const u8 *data, const size_t data_size, const u8 comp_type, const u8 level = 0, const u32 repeat_size = 0, const u32 max_chain_depth = 0) {
+                return {
+                    .data_hash = ComputeSha256(data, data_size),
+                    .comp_type = comp_type,
+                    .level = level,
+                    .repeat_size = repeat_size,
+                    .max_chain_depth = max_chain_depth
+                };
+            }
+
+            // Outputs a new[]-allocated copy of the compressed data, like the compression functions do
+            // Unreadable/corrupted entries on disk just count as misses
+            bool Find(const Key &key, u8 *&out_comp_data, size_t &out_comp_size);
+
+            // Failing to store an entry on disk is not an error (it will just be compressed again next time)
+            void Store(const Key &key, const u8 *comp_data, const size_t comp_size);
+
+            void ClearMemory();
+
+            inline size_t GetHitCount() const {
+                return this->hit_count;
+            }
+
+            inline size_t GetMissCount() const {
+                return this->miss_count;
+            }
+    };
+
+}
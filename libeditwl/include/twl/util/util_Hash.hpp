@@ -0,0 +1,136 @@
+#pragma once
+#include <twl/twl_Include.hpp>
+#include <array>
+
+namespace twl::util {
+
+    // Fast non-cryptographic hash (XXH64), meant for content comparison/deduplication
+
+    u64 ComputeXxHash64(const void *data, const size_t data_size, const u64 seed = 0);
+
+    // CRC16 (MODBUS variant, as used by ROM headers and banners), can also be computed incrementally
+
+    u16 ComputeCrc16(const void *data, const size_t data_size, const u16 crc = 0xFFFF);
+
+    // Standard (zlib) CRC32, can be computed incrementally by passing the previous result as the initial value
+
+    u32 ComputeCrc32(const void *data, const size_t data_size, const u32 crc = 0);
+
+    // Adler32 (as used by zlib/VCDIFF), can also be computed incrementally
+
+    u32 ComputeAdler32(const void *data, const size_t data_size, const u32 adler = 1);
+
+    // SHA-256, either in one go or incrementally (Update as many times as needed, then Finalize)
+
+    using Sha256Hash = std::array<u8, 0x20>;
+
+    class Sha256Hasher {
+        public:
+            static constexpr size_t BlockSize = 0x40;
+
+        private:
+            u32 state[8];
+            u8 block[BlockSize];
+            size_t block_size;
+            u64 total_size;
+
+            void ProcessBlocks(const u8 *data, const size_t block_count);
+
+        public:
+            inline Sha256Hasher() {
+                this->Reset();
+            }
+
+            void Reset();
+            void Update(const void *data, const size_t data_size);
+            Sha256Hash Finalize();
+    };
+
+    Sha256Hash ComputeSha256(const void *data, const size_t data_size);
+
+    // MD5 and SHA-1 (same usage as SHA-256), still needed to match dumps against DAT databases
+
+    using Md5Hash = std::array<u8, 0x10>;
+
+    class Md5Hasher {
+        public:
+            static constexpr size_t BlockSize = 0x40;
+
+        private:
+            u32 state[4];
+            u8 block[BlockSize];
+            size_t block_size;
+            u64 total_size;
+
+            void ProcessBlocks(const u8 *data, const size_t block_count);
+
+        public:
+            inline Md5Hasher() {
+                this->Reset();
+            }
+
+            void Reset();
+            void Update(const void *data, const size_t data_size);
+            Md5Hash Finalize();
+    };
+
+    Md5Hash ComputeMd5(const void *data, const size_t data_size);
+
+    using Sha1Hash = std::array<u8, 0x14>;
+
+    class Sha1Hasher {
+        public:
+            static constexpr size_t BlockSize = 0x40;
+
+        private:
+            u32 state[5];
+            u8 block[BlockSize];
+            size_t block_size;
+            u64 total_size;
+
+            void ProcessBlocks(const u8 *data, const size_t block_count);
+
+        public:
+            inline Sha1Hasher() {
+                this->Reset();
+            }
+
+            void Reset();
+            void Update(const void *data, const size_t data_size);
+            Sha1Hash Finalize();
+    };
+
+    Sha1Hash ComputeSha1(const void *data, const size_t data_size);
+
+    // CRC32 + MD5 + SHA-1 + SHA-256 over the same data in a single pass (each algorithm runs on its own thread)
+    // Hashers are plain copyable state, so intermediate results (of a prefix of the data) can be obtained by finalizing a copy
+
+    struct MultiHash {
+        u32 crc32;
+        Md5Hash md5;
+        Sha1Hash sha1;
+        Sha256Hash sha256;
+    };
+
+    class MultiHasher {
+        private:
+            u32 crc32;
+            Md5Hasher md5;
+            Sha1Hasher sha1;
+            Sha256Hasher sha256;
+
+        public:
+            inline MultiHasher() : crc32(0), md5(), sha1(), sha256() {}
+
+            inline void Reset() {
+                this->crc32 = 0;
+                this->md5.Reset();
+                this->sha1.Reset();
+                this->sha256.Reset();
+            }
+
+            void Update(const void *data, const size_t data_size, const u32 thread_count = 4);
+            MultiHash Finalize();
+    };
+
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <twl/fs/fs_File.hpp>
+
+namespace twl::util {
+
+    constexpr u32 BpsMagic = 0x31535042; // "BPS1"
+    constexpr char IpsMagic[] = "PATCH";
+    constexpr u32 VcdiffMagic = 0x00C4C3D6; // 'V' 'C' 'D' (with high bits set) + version 0
+
+    enum class PatchFormat : u8 {
+        Invalid,
+        IPS,
+        BPS,
+        VCDIFF
+    };
+
+    PatchFormat DetectPatchFormat(const u8 *patch_data, const size_t patch_size);
+
+    struct BpsCreateOptions {
+        // Minimum length for matches to be encoded as copies, shorter ones are stored as literals
+        size_t min_match_size;
+        // Source/target data is indexed in blocks of this size (0 = choose depending on the source size)
+        size_t block_size;
+        u32 thread_count;
+        std::string metadata;
+    };
+
+    BpsCreateOptions GetDefaultBpsCreateOptions();
+
+    // Matches are searched in parallel over target segments (both in source and in previous target data), then written sequentially
+    Result BpsCreatePatch(const u8 *src_data, const size_t src_size, const u8 *dst_data, const size_t dst_size, fs::File &out_patch_file, const BpsCreateOptions &opts);
+
+    inline Result BpsCreatePatch(const u8 *src_data, const size_t src_size, const u8 *dst_data, const size_t dst_size, fs::File &out_patch_file) {
+        return BpsCreatePatch(src_data, src_size, dst_data, dst_size, out_patch_file, GetDefaultBpsCreateOptions());
+    }
+
+    // Patched output is written sequentially to the given file: applying to a BufferFile allows directly loading the result (like fmt::ROM::ReadFrom) without any intermediate file
+    // Previous output is only kept in memory as far back as the patch actually references it (BPS target copies, VCDIFF target windows/segments), up to 16MB: copies from further back are read back from the output file, which must then be readable (opened with FileMode::Update)
+    // Checksums (BPS CRC32s, VCDIFF Adler32s if present) are verified while applying, BPS source/patch CRC32s before writing anything
+
+    Result IpsApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file);
+    Result BpsApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file);
+    Result VcdiffApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file);
+
+    Result ApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file);
+
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <twl/twl_Include.hpp>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+
+namespace twl::util {
+
+    inline u32 GetDefaultThreadCount() {
+        const auto hw_count = std::thread::hardware_concurrency();
+        return (hw_count > 0) ? hw_count : 1;
+    }
+
+    // Runs fn(idx) for every idx in [0, count) across a pool of worker threads
+    // Indices are handed out dynamically, so uneven workloads (small/big files) still balance well
+
+    template<typename Fn>
+    inline void ParallelFor(const size_t count, Fn &&fn, const u32 thread_count = GetDefaultThreadCount()) {
+        const auto worker_count = std::min<size_t>(std::max<u32>(thread_count, 1), count);
+        if(worker_count <= 1) {
+            for(size_t i = 0; i < count; i++) {
+                fn(i);
+            }
+            return;
+        }
+
+        std::atomic_size_t next_idx = 0;
+        auto worker_fn = [&]() {
+            while(true) {
+                const auto idx = next_idx.fetch_add(1);
+                if(idx >= count) {
+                    break;
+                }
+
+                fn(idx);
+            }
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(worker_count - 1);
+        for(size_t i = 0; i < (worker_count - 1); i++) {
+            workers.emplace_back(worker_fn);
+        }
+        worker_fn();
+
+        for(auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+}
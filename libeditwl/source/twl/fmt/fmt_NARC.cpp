@@ -1,4 +1,5 @@
 #include <twl/fmt/fmt_NARC.hpp>
+#include <twl/util/util_Align.hpp>
 
 namespace twl::fmt {
 
@@ -43,77 +44,81 @@ namespace twl::fmt {
         TWL_R_SUCCEED();
     }
 
-    Result NARC::WriteTo(fs::File &wf) {
-        fs::BufferReaderWriter file_data_rw(0);
-        fs::BufferReaderWriter fnt_data_rw(0);
-
-        ScopeGuard save([&]() {
-            file_data_rw.Dispose();
-            fnt_data_rw.Dispose();
-        });
-
-        std::vector<nfs::NitroFileSystem::DirectoryNameTableEntry> gen_fnt;
-        std::vector<nfs::NitroFileSystem::FileAllocationTableEntry> gen_fat;
-        TWL_R_TRY(this->nitro_fs.WriteTo(fnt_data_rw, file_data_rw, gen_fnt, gen_fat, 0x200));
+    Result NARC::PlanLayout(LayoutPlan &out_plan) {
+        const nfs::NitroFileSystem::WriteLayout fs_layout = {
+            .order = nfs::NitroFileSystem::FileDataOrder::TreeWalk,
+            .file_align = 0x200,
+            .trim_last_padding = false,
+            .access_trace = {}
+        };
+        TWL_R_TRY(this->nitro_fs.PlanLayout(fs_layout, out_plan.fs_plan));
+
+        auto &fs_plan = out_plan.fs_plan;
+        const auto fnt_entries_size = fs_plan.GetFntEntriesSize();
+        for(auto &fnt_entry: fs_plan.fnt) {
+            fnt_entry.start += fnt_entries_size;
+        }
 
         // FAT
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(sizeof(Header) + sizeof(FileAllocationTableBlock)));
-        TWL_R_TRY(wf.WriteVector(gen_fat));
-        TWL_R_TRY(wf.WriteEnsureAlignment(0x4));
+        out_plan.fat = this->fat;
+        out_plan.fat.EnsureMagic();
+        out_plan.fat.entry_count = fs_plan.fat.size();
+        out_plan.fat.block_size = util::AlignUp(sizeof(FileAllocationTableBlock) + fs_plan.GetFatSize(), SectionAlignment);
 
-        size_t fat_end_offset;
-        TWL_R_TRY(wf.GetOffset(fat_end_offset));
+        // FNT
 
-        this->fat.EnsureMagic();
-        this->fat.entry_count = gen_fat.size();
-        this->fat.block_size = fat_end_offset - sizeof(Header);
-        TWL_R_TRY(wf.SetAbsoluteOffset(sizeof(Header)));
-        TWL_R_TRY(wf.Write(this->fat));
+        out_plan.fnt = this->fnt;
+        out_plan.fnt.EnsureMagic();
+        out_plan.fnt.block_size = util::AlignUp(sizeof(FileNameTableBlock) + fs_plan.GetFntSize(), SectionAlignment);
 
-        // FNT
+        // FIMG
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(fat_end_offset + sizeof(FileNameTableBlock)));
-        TWL_R_TRY(wf.WriteVector(gen_fnt));
-        TWL_R_TRY(wf.WriteBuffer(fnt_data_rw.GetBuffer(), fnt_data_rw.GetBufferSize()));
-        TWL_R_TRY(wf.WriteEnsureAlignment(0x4));
+        out_plan.fimg = this->fimg;
+        out_plan.fimg.EnsureMagic();
+        out_plan.fimg.block_size = util::AlignUp(sizeof(FileImageBlock) + fs_plan.file_data_size, SectionAlignment);
 
-        size_t fnt_end_offset;
-        TWL_R_TRY(wf.GetOffset(fnt_end_offset));
+        // Header
 
-        this->fnt.EnsureMagic();
-        this->fnt.block_size = fnt_end_offset - fat_end_offset;
-        TWL_R_TRY(wf.SetAbsoluteOffset(fat_end_offset));
-        TWL_R_TRY(wf.Write(this->fnt));
+        out_plan.header = this->header;
+        out_plan.header.EnsureMagic();
+        out_plan.header.byte_order = Header::SupportedByteOrder;
+        out_plan.header.version = Header::SupportedVersion;
+        out_plan.header.file_size = sizeof(Header) + out_plan.fat.block_size + out_plan.fnt.block_size + out_plan.fimg.block_size;
+        out_plan.header.header_size = sizeof(Header);
+        out_plan.header.block_count = 3; // FAT + FNT + FIMG
 
-        // FIMG
+        TWL_R_SUCCEED();
+    }
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(fnt_end_offset + sizeof(FileImageBlock)));
-        TWL_R_TRY(wf.WriteBuffer(file_data_rw.GetBuffer(), file_data_rw.GetBufferSize()));
-        TWL_R_TRY(wf.WriteEnsureAlignment(0x4));
+    Result NARC::WriteTo(fs::File &wf) {
+        LayoutPlan plan = {};
+        ScopeGuard dispose_plan([&]() {
+            plan.Dispose();
+        });
 
-        size_t fimg_end_offset;
-        TWL_R_TRY(wf.GetOffset(fimg_end_offset));
+        TWL_R_TRY(this->PlanLayout(plan));
+        this->header = plan.header;
+        this->fat = plan.fat;
+        this->fnt = plan.fnt;
+        this->fimg = plan.fimg;
 
-        this->fimg.EnsureMagic();
-        this->fimg.block_size = fimg_end_offset - fnt_end_offset;
-        TWL_R_TRY(wf.SetAbsoluteOffset(fnt_end_offset));
-        TWL_R_TRY(wf.Write(this->fimg));
+        auto &fs_plan = plan.fs_plan;
 
-        // Finally, header
+        TWL_R_TRY(wf.Write(this->header));
 
-        size_t end_offset;
-        TWL_R_TRY(wf.GetOffset(end_offset));
+        TWL_R_TRY(wf.Write(this->fat));
+        TWL_R_TRY(wf.WriteVector(fs_plan.fat));
+        TWL_R_TRY(wf.WritePadding(this->fat.block_size - sizeof(FileAllocationTableBlock) - fs_plan.GetFatSize()));
 
-        this->header.EnsureMagic();
-        this->header.byte_order = Header::SupportedByteOrder;
-        this->header.version = Header::SupportedVersion;
-        this->header.file_size = end_offset;
-        this->header.header_size = sizeof(Header);
-        this->header.block_count = 3; // FAT + FNT + FIMG
+        TWL_R_TRY(wf.Write(this->fnt));
+        TWL_R_TRY(wf.WriteVector(fs_plan.fnt));
+        TWL_R_TRY(wf.WriteBuffer(fs_plan.fnt_data.GetBuffer(), fs_plan.fnt_data.GetBufferSize()));
+        TWL_R_TRY(wf.WritePadding(this->fnt.block_size - sizeof(FileNameTableBlock) - fs_plan.GetFntSize()));
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(0));
-        TWL_R_TRY(wf.Write(this->header));
+        TWL_R_TRY(wf.Write(this->fimg));
+        TWL_R_TRY(this->nitro_fs.WriteFileData(wf, fs_plan));
+        TWL_R_TRY(wf.WritePadding(this->fimg.block_size - sizeof(FileImageBlock) - fs_plan.file_data_size));
 
         TWL_R_SUCCEED();
     }
@@ -1,45 +1,140 @@
 #include <twl/fmt/fmt_ROM.hpp>
 #include <twl/util/util_Align.hpp>
+#include <twl/util/util_Compression.hpp>
+#include <twl/util/util_Hash.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <algorithm>
+#include <cstring>
 
 namespace twl::fmt {
 
     namespace {
 
-        constexpr u16 g_CRC16Table[] = {
-            0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728,
-            1920, 51009, 1280, 50625, 50305, 1088, 52225, 3264, 3456, 52545,
-            3840, 53185, 52865, 3648, 2560, 51905, 52097, 2880, 51457, 2496,
-            2176, 51265, 55297, 6336, 6528, 55617, 6912, 56257, 55937, 6720,
-            7680, 57025, 57217, 8000, 56577, 7616, 7296, 56385, 5120, 54465,
-            54657, 5440, 55041, 6080, 5760, 54849, 53761, 4800, 4992, 54081,
-            4352, 53697, 53377, 4160, 61441, 12480, 12672, 61761, 13056, 62401,
-            62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529,
-            15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040,
-            15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560,
-            60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865,
-            60545, 11328, 58369, 9408, 9600, 58689, 9984, 59329, 59009, 9792,
-            8704, 58049, 58241, 9024, 57601, 8640, 8320, 57409, 40961, 24768,
-            24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432,
-            42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608,
-            28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688,
-            30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448,
-            32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401,
-            30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120,
-            28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441,
-            38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744,
-            23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360,
-            39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777,
-            35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905,
-            17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088,
-            17280, 33601, 16640, 33217, 32897, 16448
-        };
+        constexpr size_t LibSymbolsReadSize = 0x400;
+        constexpr size_t LibSymbolsMaximumNullGap = 5;
+
+        // Symbols are null-terminated strings, some of them separated by a few extra null characters (alignment), and the list ends with a longer null run
+        // Returns whether the end of the list was found, otherwise more data is needed
+        bool ScanLibSymbols(const char *data, const size_t data_size, const bool is_data_end, std::vector<std::pair<size_t, size_t>> &out_symbols, size_t &out_end_offset) {
+            out_symbols.clear();
+
+            size_t offset = 0;
+            while(true) {
+                const auto gap_start = offset;
+                while((offset < data_size) && (data[offset] == '\0')) {
+                    offset++;
+                }
+                if((offset - gap_start) > LibSymbolsMaximumNullGap) {
+                    out_end_offset = gap_start;
+                    return true;
+                }
+                if(offset >= data_size) {
+                    out_end_offset = data_size;
+                    return is_data_end;
+                }
+
+                const auto sym_end = reinterpret_cast<const char*>(std::memchr(data + offset, '\0', data_size - offset));
+                if(sym_end == nullptr) {
+                    if(is_data_end) {
+                        out_symbols.push_back({ offset, data_size - offset });
+                        out_end_offset = data_size;
+                    }
+                    return is_data_end;
+                }
+
+                const size_t sym_len = sym_end - (data + offset);
+                out_symbols.push_back({ offset, sym_len });
+                offset += sym_len + 1;
+            }
+        }
+
+        Result ReadLibSymbols(fs::File &rf, ROM &rom, const size_t arm9_symbols_offset) {
+            rom.lib_symbols_data.clear();
+            rom.lib_symbols.clear();
+            if(arm9_symbols_offset >= rom.header.arm9_rom_size) {
+                TWL_R_SUCCEED();
+            }
+
+            // Symbols are already in memory if the code was loaded, otherwise read (just) the symbol region in a few chunks
+
+            const auto symbols_region_size = rom.header.arm9_rom_size - arm9_symbols_offset;
+            const auto arm9_size = rom.arm9_rw.GetBufferSize();
+            std::vector<std::pair<size_t, size_t>> symbols;
+            size_t symbols_end_offset;
+            if(rom.HasReadOption(ROM::ReadOptions::Code) && (arm9_size == rom.header.arm9_rom_size)) {
+                const auto symbols_data = reinterpret_cast<const char*>(rom.arm9_rw.GetBuffer()) + arm9_symbols_offset;
+                ScanLibSymbols(symbols_data, symbols_region_size, true, symbols, symbols_end_offset);
+                rom.lib_symbols_data.assign(symbols_data, symbols_data + symbols_end_offset);
+            }
+            else {
+                TWL_R_TRY(rf.SetAbsoluteOffset(rom.header.arm9_rom_offset + arm9_symbols_offset));
+                while(true) {
+                    const auto cur_size = rom.lib_symbols_data.size();
+                    const auto read_size = std::min(LibSymbolsReadSize, symbols_region_size - cur_size);
+                    rom.lib_symbols_data.resize(cur_size + read_size);
+                    TWL_R_TRY(rf.ReadBuffer(rom.lib_symbols_data.data() + cur_size, read_size));
+
+                    const auto is_region_end = rom.lib_symbols_data.size() == symbols_region_size;
+                    if(ScanLibSymbols(rom.lib_symbols_data.data(), rom.lib_symbols_data.size(), is_region_end, symbols, symbols_end_offset)) {
+                        break;
+                    }
+                }
+                rom.lib_symbols_data.resize(symbols_end_offset);
+            }
+
+            rom.lib_symbols.reserve(symbols.size());
+            for(const auto &[sym_offset, sym_len]: symbols) {
+                rom.lib_symbols.emplace_back(rom.lib_symbols_data.data() + sym_offset, sym_len);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadNitroFooter(fs::File &rf, ROM &rom) {
+            TWL_R_TRY(rf.SetAbsoluteOffset(rom.header.arm9_rom_offset + rom.header.arm9_rom_size));
+
+            u32 nitro_footer_code;
+            TWL_R_TRY(rf.Read(nitro_footer_code));
+            if(nitro_footer_code == ROM::NitroFooter::Code) {
+                TWL_R_TRY(rf.SetAbsoluteOffset(rom.header.arm9_rom_offset + rom.header.arm9_rom_size));
+            
+                ROM::NitroFooter footer;
+                TWL_R_TRY(rf.Read(footer));
+                rom.footer = footer;
+
+                TWL_R_TRY(rf.SetAbsoluteOffset(rom.header.arm9_rom_offset + footer.start_module_params_offset));
+
+                ROM::StartModuleParams params;
+                TWL_R_TRY(rf.Read(params));
+                rom.start_module_params = params;
 
-        inline constexpr u16 GetCRC16(const u8 *data, const size_t data_size) {
-            uint16_t crc = 0xffff;
-            for(size_t i = 0; i < data_size; i++) {
-                crc = (uint16_t)((crc >> 8) ^ g_CRC16Table[(crc ^ data[i]) & 0xff]);
+                if(rom.HasReadOption(ROM::ReadOptions::LibSymbols)) {
+                    TWL_R_TRY(ReadLibSymbols(rf, rom, footer.start_module_params_offset + sizeof(params)));
+                }
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadOverlayTables(fs::File &rf, ROM &rom) {
+            #define _ROM_READ_OVERLAY_TABLE(offset, size, table) { \
+                TWL_R_TRY(rf.SetAbsoluteOffset(offset)); \
+                const auto arm_overlay_count = size / sizeof(ROM::OverlayTableEntry); \
+                table.clear(); \
+                table.reserve(arm_overlay_count); \
+                for(u32 i = 0; i < arm_overlay_count; i++) { \
+                    ROM::OverlayTableEntry entry = {}; \
+                    TWL_R_TRY(rf.Read(entry)); \
+                    table.push_back(entry); \
+                } \
             }
-            return crc;
+        
+            _ROM_READ_OVERLAY_TABLE(rom.header.arm7_overlay_table_offset, rom.header.arm7_overlay_table_size, rom.arm7_ovl_table);
+            _ROM_READ_OVERLAY_TABLE(rom.header.arm9_overlay_table_offset, rom.header.arm9_overlay_table_size, rom.arm9_ovl_table);
+
+            #undef _ROM_READ_OVERLAY_TABLE
+
+            TWL_R_SUCCEED();
         }
 
     }
@@ -47,14 +142,19 @@ namespace twl::fmt {
     Result ROM::ReadValidateFrom(fs::File &rf) {
         TWL_R_TRY(rf.Read(this->header));
 
-        TWL_R_TRY(rf.SetAbsoluteOffset(this->header.banner_offset));
-        TWL_R_TRY(rf.Read(this->banner));
+        if(this->HasReadOption(ReadOptions::Banner)) {
+            TWL_R_TRY(rf.SetAbsoluteOffset(this->header.banner_offset));
+            TWL_R_TRY(rf.Read(this->banner));
+        }
+        else {
+            this->banner = {};
+        }
 
         if((this->header.unit_code != UnitCode::NDS) && (this->header.unit_code != UnitCode::NDS_NDSi) && (this->header.unit_code != UnitCode::NDSi)) {
             TWL_R_FAIL(ResultROMInvalidUnitCode);
         }
 
-        const auto logo_crc16 = GetCRC16(this->header.nintendo_logo, sizeof(this->header.nintendo_logo));
+        const auto logo_crc16 = util::ComputeCrc16(this->header.nintendo_logo, sizeof(this->header.nintendo_logo));
         if(logo_crc16 != this->header.nintendo_logo_crc) {
             TWL_R_FAIL(ResultROMInvalidNintendoLogoCRC16);
         }
@@ -65,8 +165,10 @@ namespace twl::fmt {
     Result ROM::ReadAllFrom(fs::File &rf) {
         this->nitro_fs.Dispose();
 
-        const auto file_data_offset = 0; // File offsets are absolute in ROMs
-        TWL_R_TRY(this->nitro_fs.ReadFrom(rf, file_data_offset, this->header.fat_offset, this->header.fnt_offset));        
+        if(this->HasReadOption(ReadOptions::FsMetadata) || this->HasReadOption(ReadOptions::FsContents)) {
+            const auto file_data_offset = 0; // File offsets are absolute in ROMs
+            TWL_R_TRY(this->nitro_fs.ReadFrom(rf, file_data_offset, this->header.fat_offset, this->header.fnt_offset, this->HasReadOption(ReadOptions::FsContents)));
+        }
 
         #define _ROM_READ_CODE(code_offset, code_size, code_rw) { \
             auto code_buf = new u8[code_size](); \
@@ -79,197 +181,179 @@ namespace twl::fmt {
             code_rw.CreateFrom(code_buf, code_size); \
         }
 
-        _ROM_READ_CODE(this->header.arm7_rom_offset, this->header.arm7_rom_size, this->arm7_rw);
-        _ROM_READ_CODE(this->header.arm9_rom_offset, this->header.arm9_rom_size, this->arm9_rw);
+        if(this->HasReadOption(ReadOptions::Code)) {
+            _ROM_READ_CODE(this->header.arm7_rom_offset, this->header.arm7_rom_size, this->arm7_rw);
+            _ROM_READ_CODE(this->header.arm9_rom_offset, this->header.arm9_rom_size, this->arm9_rw);
+        }
+        else {
+            this->arm7_rw.Dispose();
+            this->arm9_rw.Dispose();
+        }
 
         #undef _ROM_READ_CODE
 
-        TWL_R_TRY(rf.SetAbsoluteOffset(this->header.arm9_rom_offset + this->header.arm9_rom_size));
-
-        u32 nitro_footer_code;
-        TWL_R_TRY(rf.Read(nitro_footer_code));
-        if(nitro_footer_code == NitroFooter::Code) {
-            TWL_R_TRY(rf.SetAbsoluteOffset(this->header.arm9_rom_offset + this->header.arm9_rom_size));
-            
-            NitroFooter footer;
-            TWL_R_TRY(rf.Read(footer));
-            this->footer = footer;
-
-            TWL_R_TRY(rf.SetAbsoluteOffset(this->header.arm9_rom_offset + footer.start_module_params_offset));
-
-            StartModuleParams params;
-            TWL_R_TRY(rf.Read(params));
-            this->start_module_params = params;
+        this->footer = {};
+        this->start_module_params = {};
+        this->lib_symbols_data.clear();
+        this->lib_symbols.clear();
+        if(this->HasReadOption(ReadOptions::Code) || this->HasReadOption(ReadOptions::LibSymbols)) {
+            TWL_R_TRY(ReadNitroFooter(rf, *this));
+        }
 
-            while(true) {
-                std::string lib_symbol;
-                TWL_R_TRY(rf.ReadNullTerminatedString(lib_symbol));
-                
-                if(lib_symbol.empty()) {
-                    for(u32 i = 0; i < 5; i++) {
-                        // Some of them are separated up to 4 null-characters (due to align I guess)
-                        // Each empty-string read will advance the null-character it encounters
-                        TWL_R_TRY(rf.ReadNullTerminatedString(lib_symbol));
-
-                        if(!lib_symbol.empty()) {
-                            break;
-                        }
-                    }
-                }
-                
-                if(lib_symbol.empty()) {
-                    break;
-                }
-                
-                this->lib_symbols.push_back(lib_symbol);
-            }
+        if(this->HasReadOption(ReadOptions::OverlayTables)) {
+            TWL_R_TRY(ReadOverlayTables(rf, *this));
         }
         else {
-            this->footer = {};
-            this->start_module_params = {};
-        }
-
-        #define _ROM_READ_OVERLAY_TABLE(offset, size, table) { \
-            TWL_R_TRY(rf.SetAbsoluteOffset(offset)); \
-            const auto arm_overlay_count = size / sizeof(OverlayTableEntry); \
-            table.clear(); \
-            table.reserve(arm_overlay_count); \
-            for(u32 i = 0; i < arm_overlay_count; i++) { \
-                OverlayTableEntry entry = {}; \
-                TWL_R_TRY(rf.Read(entry)); \
-                table.push_back(entry); \
-            } \
+            this->arm7_ovl_table.clear();
+            this->arm9_ovl_table.clear();
         }
-        
-        _ROM_READ_OVERLAY_TABLE(this->header.arm7_overlay_table_offset, this->header.arm7_overlay_table_size, this->arm7_ovl_table);
-        _ROM_READ_OVERLAY_TABLE(this->header.arm9_overlay_table_offset, this->header.arm9_overlay_table_size, this->arm9_ovl_table);
 
-        #undef _ROM_READ_OVERLAY_TABLE
+        if(this->HasReadOption(ReadOptions::DecompressCode)) {
+            TWL_R_TRY(this->DecompressCode());
+        }
 
         TWL_R_SUCCEED();
     }
 
-    Result ROM::WriteTo(fs::File &wf) {
-        // Generate FNT, FAT, write files
-        
-        fs::BufferReaderWriter file_data_rw(0);
-        fs::BufferReaderWriter fnt_data_rw(0);
+    Result ROM::DecompressCode() {
+        // ARM9 static code: only the region up to the compressed end is BLZ-compressed
 
-        ScopeGuard save([&]() {
-            file_data_rw.Dispose();
-            fnt_data_rw.Dispose();
-        });
-
-        std::vector<nfs::NitroFileSystem::DirectoryNameTableEntry> gen_fnt;
-        std::vector<nfs::NitroFileSystem::FileAllocationTableEntry> gen_fat;
-        TWL_R_TRY(this->nitro_fs.WriteTo(fnt_data_rw, file_data_rw, gen_fnt, gen_fat, SectionAlignment));
+        if(this->HasReadOption(ReadOptions::Code) && this->IsArm9Compressed() && this->footer.has_value()) {
+            auto &params = this->start_module_params.value();
+            const size_t comp_size = params.compressed_static_end - this->header.arm9_ram_address;
+            const auto arm9_size = this->arm9_rw.GetBufferSize();
+            if(comp_size > arm9_size) {
+                TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+            }
 
-        #define _WRITE_CODE(rw, type, out_rom_offset, out_rom_size, write_footer) { \
-            size_t cur_offset; \
-            TWL_R_TRY(wf.GetOffset(cur_offset)); \
-            const auto rom_size = rw.GetBufferSize(); \
-            out_rom_offset = cur_offset; \
-            out_rom_size = rom_size; \
-            TWL_R_TRY(wf.WriteBuffer(rw.GetBuffer(), rom_size)); \
-            if(write_footer && this->footer.has_value()) { \
-                TWL_R_TRY(wf.Write(this->footer.value())); \
-            } \
-            TWL_R_TRY(wf.WriteEnsureAlignment(SectionAlignment)); \
+            const auto arm9_buf = reinterpret_cast<const u8*>(this->arm9_rw.GetBuffer());
+            u8 *dec_buf;
+            size_t dec_size;
+            TWL_R_TRY(util::BlzDecompress(arm9_buf, comp_size, dec_buf, dec_size));
+
+            const auto new_arm9_size = dec_size + (arm9_size - comp_size);
+            auto new_arm9_buf = new u8[new_arm9_size]();
+            std::memcpy(new_arm9_buf, dec_buf, dec_size);
+            std::memcpy(new_arm9_buf + dec_size, arm9_buf + comp_size, arm9_size - comp_size);
+            delete[] dec_buf;
+
+            params.compressed_static_end = 0;
+            const auto params_offset = this->footer.value().start_module_params_offset;
+            if((params_offset + sizeof(StartModuleParams)) <= new_arm9_size) {
+                std::memcpy(new_arm9_buf + params_offset, std::addressof(params), sizeof(params));
+            }
+            this->arm9_rw.CreateFrom(new_arm9_buf, new_arm9_size);
         }
 
-        // TODO: this is not properly implemented for modifying the overlay count (adding or removing new overlays), since file IDs are assumed to be the same (see assumptions with extra files in the nitrofs)
+        // Overlays: decompress every flagged one in parallel
 
-        #define _WRITE_OVERLAY_TABLE(ovl_table, out_ovl_table_offset, out_ovl_table_size) { \
-            if(!ovl_table.empty()) { \
-                size_t overlay_table_offset; \
-                TWL_R_TRY(wf.GetOffset(overlay_table_offset)); \
-                out_ovl_table_offset = overlay_table_offset; \
-                out_ovl_table_size = ovl_table.size() * sizeof(OverlayTableEntry); \
-                for(u32 i = 0; i < ovl_table.size(); i++) { \
-                    auto &ovl = ovl_table.at(i); \
-                    TWL_R_TRY(wf.Write(ovl)); \
-                } \
-                TWL_R_TRY(wf.WriteEnsureAlignment(SectionAlignment)); \
-            } \
-            else { \
-                out_ovl_table_offset = 0; \
-                out_ovl_table_size = 0; \
-            } \
+        if(!this->HasReadOption(ReadOptions::OverlayTables) || !this->HasReadOption(ReadOptions::FsContents)) {
+            TWL_R_SUCCEED();
         }
 
-        // Write ARM9 ROM
+        std::vector<std::pair<OverlayTableEntry*, nfs::NitroFile*>> comp_ovls;
+        for(auto ovl_table: { std::addressof(this->arm9_ovl_table), std::addressof(this->arm7_ovl_table) }) {
+            for(auto &ovl: *ovl_table) {
+                if(ovl.IsCompressed()) {
+                    nfs::NitroFileSystemFile ovl_file;
+                    TWL_R_TRY(this->CreateOverlayFile(ovl_file, ovl));
+                    comp_ovls.push_back({ std::addressof(ovl), ovl_file.file_ref });
+                }
+            }
+        }
 
-        constexpr size_t Arm9BaseRomOffset = 0x4000;
-        TWL_R_TRY(wf.SetAbsoluteOffset(Arm9BaseRomOffset));
+        std::vector<Result> ovl_rcs(comp_ovls.size(), ResultSuccess);
+        util::ParallelFor(comp_ovls.size(), [&](const size_t i) {
+            auto &[ovl, ovl_file] = comp_ovls.at(i);
+            const auto ovl_buf = reinterpret_cast<const u8*>(ovl_file->inner_file.GetBuffer());
+            const auto ovl_size = std::min<size_t>(ovl->GetCompressedSize(), ovl_file->inner_file.GetBufferSize());
+
+            u8 *dec_buf;
+            size_t dec_size;
+            ovl_rcs.at(i) = util::BlzDecompress(ovl_buf, ovl_size, dec_buf, dec_size);
+            if(ovl_rcs.at(i).IsSuccess()) {
+                ovl_file->inner_file.CreateFrom(dec_buf, dec_size);
+                // Other flags (such as the authentication one) are kept as they are
+                ovl->compressed_size_and_flags &= ~(OverlayTableEntry::CompressedFlag | OverlayTableEntry::CompressedSizeMask);
+            }
+        });
 
-        this->header.header_size = Arm9BaseRomOffset;
+        for(const auto &rc: ovl_rcs) {
+            TWL_R_TRY(rc);
+        }
 
-        _WRITE_CODE(this->arm9_rw, ProcessorType::ARM9, this->header.arm9_rom_offset, this->header.arm9_rom_size, true);
+        TWL_R_SUCCEED();
+    }
 
-        // ARM9 overlay table
+    Result ROM::PlanLayout(const LayoutPolicy &policy, LayoutPlan &out_plan) {
+        if(!this->HasReadOption(ReadOptions::Writable)) {
+            TWL_R_FAIL(ResultROMSectionsNotLoaded);
+        }
 
-        _WRITE_OVERLAY_TABLE(this->arm9_ovl_table, this->header.arm9_overlay_table_offset, this->header.arm9_overlay_table_size);
+        // Generate FNT, FAT and file data layout
 
-        // Write ARM7 ROM
+        TWL_R_TRY(this->nitro_fs.PlanLayout(policy.fs_layout, out_plan.fs_plan));
 
-        _WRITE_CODE(this->arm7_rw, ProcessorType::ARM7, this->header.arm7_rom_offset, this->header.arm7_rom_size, false);
+        auto &fs_plan = out_plan.fs_plan;
+        const auto fnt_entries_size = fs_plan.GetFntEntriesSize();
+        for(auto &fnt_entry: fs_plan.fnt) {
+            fnt_entry.start += fnt_entries_size;
+        }
 
-        // ARM7 overlay table
+        // Place every section in the same order they are written
 
-        _WRITE_OVERLAY_TABLE(this->arm7_ovl_table, this->header.arm7_overlay_table_offset, this->header.arm7_overlay_table_size);
+        auto &header = out_plan.header;
+        header = this->header;
 
-        // FNT
+        constexpr size_t Arm9BaseRomOffset = 0x4000;
+        size_t cur_offset = Arm9BaseRomOffset;
+        header.header_size = Arm9BaseRomOffset;
 
-        const auto fnt_entries_size = gen_fnt.size() * sizeof(nfs::NitroFileSystem::DirectoryNameTableEntry);
-        for(auto &fnt_entry: gen_fnt) {
-            fnt_entry.start += fnt_entries_size;
+        #define _PLACE_SECTION(out_rom_offset, out_rom_size, size, extra_size) { \
+            out_rom_offset = cur_offset; \
+            out_rom_size = (size); \
+            cur_offset = util::AlignUp(cur_offset + (size) + (extra_size), SectionAlignment); \
         }
 
-        size_t fnt_offset;
-        TWL_R_TRY(wf.GetOffset(fnt_offset));
-        this->header.fnt_offset = fnt_offset;
-        TWL_R_TRY(wf.WriteVector(gen_fnt));
-        TWL_R_TRY(wf.WriteBuffer(fnt_data_rw.GetBuffer(), fnt_data_rw.GetBufferSize()));
-        size_t fnt_end_offset;
-        TWL_R_TRY(wf.GetOffset(fnt_end_offset));
-        this->header.fnt_size = fnt_end_offset - fnt_offset;
-
-        // Set FAT values
+        // TODO: this is not properly implemented for modifying the overlay count (adding or removing new overlays), since file IDs are assumed to be the same (see assumptions with extra files in the nitrofs)
 
-        this->header.fat_offset = fnt_end_offset;
-        this->header.fat_size = gen_fat.size() * sizeof(nfs::NitroFileSystem::FileAllocationTableEntry);
-        wf.MoveOffset(this->header.fat_size);
-        TWL_R_TRY(wf.WriteEnsureAlignment(SectionAlignment));
+        #define _PLACE_OVERLAY_TABLE(ovl_table, out_ovl_table_offset, out_ovl_table_size) { \
+            if(!ovl_table.empty()) { \
+                _PLACE_SECTION(out_ovl_table_offset, out_ovl_table_size, ovl_table.size() * sizeof(OverlayTableEntry), 0); \
+            } \
+            else { \
+                out_ovl_table_offset = 0; \
+                out_ovl_table_size = 0; \
+            } \
+        }
 
-        // Banner
+        _PLACE_SECTION(header.arm9_rom_offset, header.arm9_rom_size, this->arm9_rw.GetBufferSize(), this->footer.has_value() ? sizeof(NitroFooter) : 0);
+        _PLACE_OVERLAY_TABLE(this->arm9_ovl_table, header.arm9_overlay_table_offset, header.arm9_overlay_table_size);
+        _PLACE_SECTION(header.arm7_rom_offset, header.arm7_rom_size, this->arm7_rw.GetBufferSize(), 0);
+        _PLACE_OVERLAY_TABLE(this->arm7_ovl_table, header.arm7_overlay_table_offset, header.arm7_overlay_table_size);
 
-        size_t banner_offset;
-        TWL_R_TRY(wf.GetOffset(banner_offset));
-        this->header.banner_offset = banner_offset;
-        TWL_R_TRY(wf.Write(this->banner));
-        TWL_R_TRY(wf.WriteEnsureAlignment(SectionAlignment));
+        #undef _PLACE_OVERLAY_TABLE
+        #undef _PLACE_SECTION
 
-        // Adjust absolute FAT offsets
+        // FNT is immediately followed by the FAT
 
-        size_t file_data_offset;
-        TWL_R_TRY(wf.GetOffset(file_data_offset));
-        for(auto &fat_entry: gen_fat) {
-            fat_entry.file_start += file_data_offset;
-            fat_entry.file_end += file_data_offset;
-        }
+        header.fnt_offset = cur_offset;
+        header.fnt_size = fs_plan.GetFntSize();
+        cur_offset += header.fnt_size;
 
-        // Write all file contents
+        header.fat_offset = cur_offset;
+        header.fat_size = fs_plan.GetFatSize();
+        cur_offset = util::AlignUp(cur_offset + header.fat_size, SectionAlignment);
 
-        TWL_R_TRY(wf.WriteBuffer(file_data_rw.GetBuffer(), file_data_rw.GetBufferSize()));
-        TWL_R_TRY(wf.WriteEnsureAlignment(4));
+        header.banner_offset = cur_offset;
+        cur_offset = util::AlignUp(cur_offset + sizeof(Banner), std::max(SectionAlignment, policy.fs_layout.file_align));
 
-        // Set header fields
+        out_plan.file_data_offset = cur_offset;
+        cur_offset = util::AlignUp(cur_offset + fs_plan.file_data_size, 4);
 
-        size_t base_rom_size;
-        TWL_R_TRY(wf.GetOffset(base_rom_size));
-        this->header.rom_size = base_rom_size;
+        header.rom_size = cur_offset;
 
-        u32 capacity_size = base_rom_size;
+        u32 capacity_size = cur_offset;
         capacity_size |= capacity_size >> 16;
         capacity_size |= capacity_size >> 8;
         capacity_size |= capacity_size >> 4;
@@ -288,20 +372,160 @@ namespace twl::fmt {
         if(capacity < 0) {
             capacity = 0;
         }
-        this->header.device_capacity = static_cast<u8>(capacity);
+        header.device_capacity = static_cast<u8>(capacity);
+
+        out_plan.total_size = policy.pad_to_capacity ? (0x20000ul << header.device_capacity) : header.rom_size;
 
         // TODO: RSA signature
 
-        // FAT
+        TWL_R_SUCCEED();
+    }
+
+    Result ROM::WriteTo(fs::File &wf, const LayoutPolicy &policy) {
+        LayoutPlan plan = {};
+        ScopeGuard dispose_plan([&]() {
+            plan.Dispose();
+        });
+
+        TWL_R_TRY(this->PlanLayout(policy, plan));
+        TWL_R_TRY(this->WriteTo(wf, plan));
+        TWL_R_SUCCEED();
+    }
+
+    Result ROM::WriteTo(fs::File &wf, LayoutPlan &plan) {
+        // Plans might have been computed for another ROM, thus this is checked again (before writing anything)
+        if(!this->HasReadOption(ReadOptions::Writable)) {
+            TWL_R_FAIL(ResultROMSectionsNotLoaded);
+        }
+        if(this->nitro_fs.IsContentsSource(wf)) {
+            TWL_R_FAIL(ResultROMOutputIsContentsSource);
+        }
+
+        this->header = plan.header;
+
+        size_t cur_offset = 0;
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(this->header.fat_offset));
-        TWL_R_TRY(wf.WriteVector(gen_fat));
+        #define _WRITE_PAD_TO(offset) { \
+            TWL_R_TRY(wf.WritePadding((offset) - cur_offset)); \
+            cur_offset = (offset); \
+        }
+
+        #define _WRITE_BUFFER(buf, size) { \
+            TWL_R_TRY(wf.WriteBuffer(buf, size)); \
+            cur_offset += (size); \
+        }
 
-        // Header (finally)
+        // Header
 
-        TWL_R_TRY(wf.SetAbsoluteOffset(0));
-        TWL_R_TRY(wf.Write(this->header));
+        _WRITE_BUFFER(std::addressof(this->header), sizeof(Header));
 
+        // ARM9 code (+ footer) and overlay table
+
+        _WRITE_PAD_TO(this->header.arm9_rom_offset);
+        _WRITE_BUFFER(this->arm9_rw.GetBuffer(), this->arm9_rw.GetBufferSize());
+        if(this->footer.has_value()) {
+            _WRITE_BUFFER(std::addressof(this->footer.value()), sizeof(NitroFooter));
+        }
+
+        if(!this->arm9_ovl_table.empty()) {
+            _WRITE_PAD_TO(this->header.arm9_overlay_table_offset);
+            _WRITE_BUFFER(this->arm9_ovl_table.data(), this->header.arm9_overlay_table_size);
+        }
+
+        // ARM7 code and overlay table
+
+        _WRITE_PAD_TO(this->header.arm7_rom_offset);
+        _WRITE_BUFFER(this->arm7_rw.GetBuffer(), this->arm7_rw.GetBufferSize());
+
+        if(!this->arm7_ovl_table.empty()) {
+            _WRITE_PAD_TO(this->header.arm7_overlay_table_offset);
+            _WRITE_BUFFER(this->arm7_ovl_table.data(), this->header.arm7_overlay_table_size);
+        }
+
+        // FNT
+
+        _WRITE_PAD_TO(this->header.fnt_offset);
+        _WRITE_BUFFER(plan.fs_plan.fnt.data(), plan.fs_plan.GetFntEntriesSize());
+        _WRITE_BUFFER(plan.fs_plan.fnt_data.GetBuffer(), plan.fs_plan.fnt_data.GetBufferSize());
+
+        // FAT (with absolute file offsets)
+
+        for(const auto &fat_entry: plan.fs_plan.fat) {
+            const nfs::NitroFileSystem::FileAllocationTableEntry abs_fat_entry = {
+                .file_start = static_cast<u32>(fat_entry.file_start + plan.file_data_offset),
+                .file_end = static_cast<u32>(fat_entry.file_end + plan.file_data_offset)
+            };
+            _WRITE_BUFFER(std::addressof(abs_fat_entry), sizeof(abs_fat_entry));
+        }
+
+        // Banner
+
+        _WRITE_PAD_TO(this->header.banner_offset);
+        _WRITE_BUFFER(std::addressof(this->banner), sizeof(Banner));
+
+        // All file contents
+
+        _WRITE_PAD_TO(plan.file_data_offset);
+        TWL_R_TRY(this->nitro_fs.WriteFileData(wf, plan.fs_plan));
+        cur_offset += plan.fs_plan.file_data_size;
+
+        _WRITE_PAD_TO(this->header.rom_size);
+
+        #undef _WRITE_BUFFER
+        #undef _WRITE_PAD_TO
+
+        if(plan.total_size > cur_offset) {
+            TWL_R_TRY(wf.Extend(plan.total_size));
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    Result ROM::UpdateFileInPlace(fs::File &wf, LayoutPlan &plan, nfs::NitroFile &file) {
+        if(!this->HasReadOption(ReadOptions::Writable)) {
+            TWL_R_FAIL(ResultROMSectionsNotLoaded);
+        }
+
+        // Output file IDs are the plan indices (not necessarily the ones the file was read with)
+
+        auto &fs_plan = plan.fs_plan;
+        const auto file_it = std::find(fs_plan.files.begin(), fs_plan.files.end(), std::addressof(file));
+        if(file_it == fs_plan.files.end()) {
+            TWL_R_FAIL(ResultNitroFsFileNotFound);
+        }
+        const auto file_id = static_cast<u16>(file_it - fs_plan.files.begin());
+
+        // The space available for the file ends where the next one (in data order) starts
+
+        const auto order_it = std::find(fs_plan.data_order.begin(), fs_plan.data_order.end(), file_id);
+        if(order_it == fs_plan.data_order.end()) {
+            TWL_R_FAIL(ResultNitroFsFileNotFound);
+        }
+        const auto next_order_it = order_it + 1;
+        const auto space_end = (next_order_it != fs_plan.data_order.end()) ? fs_plan.fat.at(*next_order_it).file_start : fs_plan.file_data_size;
+
+        auto &fat_entry = fs_plan.fat.at(file_id);
+        const auto new_size = this->nitro_fs.GetFileSize(file);
+        if(new_size > (space_end - fat_entry.file_start)) {
+            TWL_R_FAIL(ResultROMFileDoesNotFitInPlace);
+        }
+
+        // Zero-fill whatever the old contents used beyond the new ones
+
+        const auto new_file_end = fat_entry.file_start + new_size;
+        TWL_R_TRY(wf.SetAbsoluteOffset(plan.file_data_offset + fat_entry.file_start));
+        TWL_R_TRY(this->nitro_fs.WriteFileContents(wf, file));
+        if(fat_entry.file_end > new_file_end) {
+            TWL_R_TRY(wf.WritePadding(fat_entry.file_end - new_file_end));
+        }
+        fat_entry.file_end = new_file_end;
+
+        const nfs::NitroFileSystem::FileAllocationTableEntry abs_fat_entry = {
+            .file_start = static_cast<u32>(fat_entry.file_start + plan.file_data_offset),
+            .file_end = static_cast<u32>(fat_entry.file_end + plan.file_data_offset)
+        };
+        TWL_R_TRY(wf.SetAbsoluteOffset(plan.header.fat_offset + file_id * sizeof(abs_fat_entry)));
+        TWL_R_TRY(wf.Write(abs_fat_entry));
         TWL_R_SUCCEED();
     }
 
@@ -0,0 +1,220 @@
+#include <twl/fmt/fmt_ROMDiff.hpp>
+#include <twl/util/util_Hash.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <unordered_map>
+#include <map>
+#include <cstring>
+
+namespace twl::fmt {
+
+    namespace {
+
+        struct HashedData {
+            std::string name;
+            const u8 *data;
+            size_t size;
+            u64 hash;
+
+            inline bool Matches(const HashedData &other) const {
+                return (this->size == other.size) && (this->hash == other.hash);
+            }
+        };
+
+        inline HashedData MakeHashedData(const std::string &name, const u8 *data, const size_t size) {
+            return {
+                .name = name,
+                .data = data,
+                .size = size,
+                .hash = 0
+            };
+        }
+
+        // Spans of the ROM image (code or file data), which must be within it
+        inline Result MakeHashedImageData(const std::string &name, const u8 *rom_data, const size_t rom_data_size, const size_t offset, const size_t size, HashedData &out_data) {
+            if((offset > rom_data_size) || (size > (rom_data_size - offset))) {
+                TWL_R_FAIL(ResultROMFileDataOutOfBounds);
+            }
+
+            out_data = MakeHashedData(name, rom_data + offset, size);
+            TWL_R_SUCCEED();
+        }
+
+        inline Result CollectOverlays(const std::vector<ROM::OverlayTableEntry> &ovl_table, const std::unordered_map<u32, nfs::NitroFile*> &files_by_id, const char *proc_name, const u8 *rom_data, const size_t rom_data_size, std::map<u32, HashedData> &out_ovls) {
+            for(const auto &ovl: ovl_table) {
+                const auto name = std::string(proc_name) + " overlay " + std::to_string(ovl.id);
+                auto it = files_by_id.find(ovl.file_id);
+                if(it != files_by_id.end()) {
+                    TWL_R_TRY(MakeHashedImageData(name, rom_data, rom_data_size, it->second->data_offset, it->second->data_size, out_ovls[ovl.id]));
+                }
+                else {
+                    out_ovls[ovl.id] = MakeHashedData(name, nullptr, 0);
+                }
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        struct ROMHashedContents {
+            HashedData arm9;
+            HashedData arm7;
+            std::map<u32, HashedData> arm9_ovls;
+            std::map<u32, HashedData> arm7_ovls;
+            std::map<std::string, HashedData> tree_files;
+
+            Result CollectFrom(ROM &rom, const u8 *rom_data, const size_t rom_data_size) {
+                TWL_R_TRY(MakeHashedImageData("arm9", rom_data, rom_data_size, rom.header.arm9_rom_offset, rom.header.arm9_rom_size, this->arm9));
+                TWL_R_TRY(MakeHashedImageData("arm7", rom_data, rom_data_size, rom.header.arm7_rom_offset, rom.header.arm7_rom_size, this->arm7));
+
+                std::vector<nfs::NitroFileSystem::FileListEntry> files;
+                rom.GetFs().ListAllFiles(files);
+
+                std::unordered_map<u32, nfs::NitroFile*> files_by_id;
+                for(auto &file: files) {
+                    if(file.path.empty()) {
+                        files_by_id[file.file->file_id] = file.file;
+                    }
+                    else {
+                        TWL_R_TRY(MakeHashedImageData(file.path, rom_data, rom_data_size, file.file->data_offset, file.file->data_size, this->tree_files[file.path]));
+                    }
+                }
+
+                TWL_R_TRY(CollectOverlays(rom.arm9_ovl_table, files_by_id, "arm9", rom_data, rom_data_size, this->arm9_ovls));
+                TWL_R_TRY(CollectOverlays(rom.arm7_ovl_table, files_by_id, "arm7", rom_data, rom_data_size, this->arm7_ovls));
+                TWL_R_SUCCEED();
+            }
+
+            void ListAll(std::vector<HashedData*> &out_list) {
+                out_list.push_back(std::addressof(this->arm9));
+                out_list.push_back(std::addressof(this->arm7));
+                for(auto &[id, ovl]: this->arm9_ovls) {
+                    out_list.push_back(std::addressof(ovl));
+                }
+                for(auto &[id, ovl]: this->arm7_ovls) {
+                    out_list.push_back(std::addressof(ovl));
+                }
+                for(auto &[path, file]: this->tree_files) {
+                    out_list.push_back(std::addressof(file));
+                }
+            }
+        };
+
+        template<typename K>
+        void DiffHashedMaps(const ROMDiff::EntryKind kind, std::map<K, HashedData> &old_map, std::map<K, HashedData> &new_map, std::vector<ROMDiff::Entry> &out_entries) {
+            for(auto &[key, old_data]: old_map) {
+                auto new_it = new_map.find(key);
+                if(new_it == new_map.end()) {
+                    out_entries.push_back({ kind, ROMDiff::ChangeType::Removed, old_data.name, "", old_data.size, 0 });
+                }
+                else if(!old_data.Matches(new_it->second)) {
+                    out_entries.push_back({ kind, ROMDiff::ChangeType::Changed, old_data.name, new_it->second.name, old_data.size, new_it->second.size });
+                }
+            }
+
+            for(auto &[key, new_data]: new_map) {
+                if(old_map.find(key) == old_map.end()) {
+                    out_entries.push_back({ kind, ROMDiff::ChangeType::Added, "", new_data.name, 0, new_data.size });
+                }
+            }
+        }
+
+        inline void DiffCode(const HashedData &old_code, const HashedData &new_code, std::vector<ROMDiff::Entry> &out_entries) {
+            if(!old_code.Matches(new_code)) {
+                out_entries.push_back({ ROMDiff::EntryKind::Code, ROMDiff::ChangeType::Changed, old_code.name, new_code.name, old_code.size, new_code.size });
+            }
+        }
+
+        inline void DiffOverlayTables(const std::vector<ROM::OverlayTableEntry> &old_table, const std::vector<ROM::OverlayTableEntry> &new_table, const char *proc_name, std::vector<ROMDiff::Entry> &out_entries) {
+            const auto old_size = old_table.size() * sizeof(ROM::OverlayTableEntry);
+            const auto new_size = new_table.size() * sizeof(ROM::OverlayTableEntry);
+            if((old_size != new_size) || (std::memcmp(old_table.data(), new_table.data(), old_size) != 0)) {
+                const auto name = std::string(proc_name) + " overlay table";
+                out_entries.push_back({ ROMDiff::EntryKind::OverlayTable, ROMDiff::ChangeType::Changed, name, name, old_size, new_size });
+            }
+        }
+
+        void DetectRenames(std::vector<ROMDiff::Entry> &file_entries, std::map<std::string, HashedData> &old_files, std::map<std::string, HashedData> &new_files) {
+            // Pair removed files with added files of identical contents
+
+            std::unordered_multimap<u64, size_t> added_by_hash;
+            for(size_t i = 0; i < file_entries.size(); i++) {
+                const auto &entry = file_entries.at(i);
+                if(entry.change == ROMDiff::ChangeType::Added) {
+                    added_by_hash.emplace(new_files.at(entry.new_name).hash, i);
+                }
+            }
+
+            std::vector<bool> consumed(file_entries.size(), false);
+            for(size_t i = 0; i < file_entries.size(); i++) {
+                auto &entry = file_entries.at(i);
+                if(entry.change != ROMDiff::ChangeType::Removed) {
+                    continue;
+                }
+
+                const auto &old_data = old_files.at(entry.old_name);
+                const auto range = added_by_hash.equal_range(old_data.hash);
+                for(auto it = range.first; it != range.second; it++) {
+                    const auto added_idx = it->second;
+                    const auto &added_entry = file_entries.at(added_idx);
+                    if(!consumed.at(added_idx) && old_data.Matches(new_files.at(added_entry.new_name))) {
+                        consumed.at(added_idx) = true;
+                        entry.change = ROMDiff::ChangeType::Renamed;
+                        entry.new_name = added_entry.new_name;
+                        entry.new_size = added_entry.new_size;
+                        break;
+                    }
+                }
+            }
+
+            std::vector<ROMDiff::Entry> result_entries;
+            result_entries.reserve(file_entries.size());
+            for(size_t i = 0; i < file_entries.size(); i++) {
+                if(!consumed.at(i)) {
+                    result_entries.push_back(std::move(file_entries.at(i)));
+                }
+            }
+            file_entries = std::move(result_entries);
+        }
+
+    }
+
+    Result ROMDiff::Compute(ROM &old_rom, const u8 *old_rom_data, const size_t old_rom_data_size, ROM &new_rom, const u8 *new_rom_data, const size_t new_rom_data_size) {
+        this->entries.clear();
+
+        if(std::memcmp(&old_rom.header, &new_rom.header, sizeof(ROM::Header)) != 0) {
+            this->entries.push_back({ EntryKind::Header, ChangeType::Changed, "header", "header", sizeof(ROM::Header), sizeof(ROM::Header) });
+        }
+        if(std::memcmp(&old_rom.banner, &new_rom.banner, sizeof(ROM::Banner)) != 0) {
+            this->entries.push_back({ EntryKind::Banner, ChangeType::Changed, "banner", "banner", sizeof(ROM::Banner), sizeof(ROM::Banner) });
+        }
+
+        ROMHashedContents old_contents;
+        ROMHashedContents new_contents;
+        TWL_R_TRY(old_contents.CollectFrom(old_rom, old_rom_data, old_rom_data_size));
+        TWL_R_TRY(new_contents.CollectFrom(new_rom, new_rom_data, new_rom_data_size));
+
+        std::vector<HashedData*> hash_list;
+        old_contents.ListAll(hash_list);
+        new_contents.ListAll(hash_list);
+        util::ParallelFor(hash_list.size(), [&](const size_t i) {
+            auto &data = *hash_list.at(i);
+            data.hash = util::ComputeXxHash64(data.data, data.size);
+        });
+
+        DiffCode(old_contents.arm9, new_contents.arm9, this->entries);
+        DiffCode(old_contents.arm7, new_contents.arm7, this->entries);
+
+        DiffOverlayTables(old_rom.arm9_ovl_table, new_rom.arm9_ovl_table, "arm9", this->entries);
+        DiffOverlayTables(old_rom.arm7_ovl_table, new_rom.arm7_ovl_table, "arm7", this->entries);
+
+        DiffHashedMaps(EntryKind::Overlay, old_contents.arm9_ovls, new_contents.arm9_ovls, this->entries);
+        DiffHashedMaps(EntryKind::Overlay, old_contents.arm7_ovls, new_contents.arm7_ovls, this->entries);
+
+        std::vector<Entry> file_entries;
+        DiffHashedMaps(EntryKind::File, old_contents.tree_files, new_contents.tree_files, file_entries);
+        DetectRenames(file_entries, old_contents.tree_files, new_contents.tree_files);
+        this->entries.insert(this->entries.end(), std::make_move_iterator(file_entries.begin()), std::make_move_iterator(file_entries.end()));
+
+        TWL_R_SUCCEED();
+    }
+
+}
@@ -0,0 +1,69 @@
+#include <twl/fmt/fmt_ROMImageHash.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <algorithm>
+
+namespace twl::fmt {
+
+    Result ROMImageHash::Compute(fs::File &rf) {
+        TWL_R_TRY(rf.GetSize(this->full_size));
+
+        ROM::Header header;
+        TWL_R_TRY(rf.SetAbsoluteOffset(0));
+        TWL_R_TRY(rf.Read(header));
+        TWL_R_TRY(rf.SetAbsoluteOffset(0));
+        this->trimmed_size = std::min<size_t>(header.rom_size, this->full_size);
+
+        auto cur_buf = new u8[ReadChunkSize];
+        auto next_buf = new u8[ReadChunkSize];
+        ScopeGuard delete_bufs([&]() {
+            delete[] cur_buf;
+            delete[] next_buf;
+        });
+
+        util::MultiHasher hasher;
+        auto hash_chunk = [&](const u8 *chunk, const size_t chunk_offset, const size_t chunk_size) {
+            // Finalize a copy of the hasher right at the trimmed size, then keep going
+            if((chunk_offset <= this->trimmed_size) && (this->trimmed_size < (chunk_offset + chunk_size))) {
+                const auto head_size = this->trimmed_size - chunk_offset;
+                hasher.Update(chunk, head_size);
+                auto trimmed_hasher = hasher;
+                this->trimmed = trimmed_hasher.Finalize();
+                hasher.Update(chunk + head_size, chunk_size - head_size);
+            }
+            else {
+                hasher.Update(chunk, chunk_size);
+            }
+        };
+
+        size_t cur_offset = 0;
+        size_t cur_size = std::min(ReadChunkSize, this->full_size);
+        TWL_R_TRY(rf.ReadBuffer(cur_buf, cur_size));
+        while(cur_size > 0) {
+            const auto next_offset = cur_offset + cur_size;
+            const auto next_size = std::min(ReadChunkSize, this->full_size - next_offset);
+
+            auto read_rc = ResultSuccess;
+            util::ParallelFor(2, [&](const size_t i) {
+                if(i == 0) {
+                    hash_chunk(cur_buf, cur_offset, cur_size);
+                }
+                else {
+                    read_rc = rf.ReadBuffer(next_buf, next_size);
+                }
+            });
+            TWL_R_TRY(read_rc);
+
+            std::swap(cur_buf, next_buf);
+            cur_offset = next_offset;
+            cur_size = next_size;
+        }
+
+        this->full = hasher.Finalize();
+        if(this->trimmed_size == this->full_size) {
+            this->trimmed = this->full;
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+}
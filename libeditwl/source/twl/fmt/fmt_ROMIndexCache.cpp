@@ -0,0 +1,440 @@
+#include <twl/fmt/fmt_ROMIndexCache.hpp>
+#include <filesystem>
+
+namespace twl::fmt {
+
+    namespace {
+
+        // Directory IDs are 0xF000-0xFFFF, so no valid tree can be deeper than this
+        constexpr u32 MaxDirectoryDepth = 0x1000;
+
+        enum class SectionFlags : u8 {
+            None = 0,
+            HasFooter = TWL_BITMASK(0),
+            HasStartModuleParams = TWL_BITMASK(1)
+        };
+        TWL_ENUM_BIT_OPERATORS(SectionFlags, u8)
+
+        enum class ManifestEntryFlags : u8 {
+            None = 0,
+            HasSha256 = TWL_BITMASK(0)
+        };
+        TWL_ENUM_BIT_OPERATORS(ManifestEntryFlags, u8)
+
+        struct CachedFileEntry {
+            u16 file_id;
+            u32 data_offset;
+            u32 data_size;
+        } TWL_ATTR_PACKED;
+
+        struct CachedLibSymbolEntry {
+            u32 offset;
+            u32 length;
+        };
+
+        struct CachedManifestEntry {
+            u16 file_id;
+            u64 xxhash64;
+            util::LzVersion lz_ver;
+            u32 decompressed_size;
+            ManifestEntryFlags flags;
+        } TWL_ATTR_PACKED;
+
+        Result WriteCachedString(fs::File &wf, const std::string &str) {
+            if(str.length() > UINT16_MAX) {
+                TWL_R_FAIL(ResultROMInvalidIndexCache);
+            }
+
+            const u16 str_len = str.length();
+            TWL_R_TRY(wf.Write(str_len));
+            TWL_R_TRY(wf.WriteString(str));
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadCachedString(fs::File &rf, std::string &out_str) {
+            u16 str_len;
+            TWL_R_TRY(rf.Read(str_len));
+            out_str.resize(str_len);
+            TWL_R_TRY(rf.ReadBuffer(out_str.data(), str_len));
+            TWL_R_SUCCEED();
+        }
+
+        // Counts are validated against the remaining cache size before allocating anything for them
+        Result ReadCachedCount(fs::File &rf, const size_t min_entry_size, u32 &out_count) {
+            TWL_R_TRY(rf.Read(out_count));
+
+            size_t cur_offset;
+            TWL_R_TRY(rf.GetOffset(cur_offset));
+            size_t cache_size;
+            TWL_R_TRY(rf.GetSize(cache_size));
+            if((static_cast<u64>(out_count) * min_entry_size) > (cache_size - cur_offset)) {
+                TWL_R_FAIL(ResultROMInvalidIndexCache);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        template<typename T>
+        Result WriteCachedVector(fs::File &wf, const std::vector<T> &vec) {
+            const u32 count = vec.size();
+            TWL_R_TRY(wf.Write(count));
+            TWL_R_TRY(wf.WriteVector(vec));
+            TWL_R_SUCCEED();
+        }
+
+        template<typename T>
+        Result ReadCachedVector(fs::File &rf, std::vector<T> &out_vec) {
+            u32 count;
+            TWL_R_TRY(ReadCachedCount(rf, sizeof(T), count));
+            out_vec.resize(count);
+            TWL_R_TRY(rf.ReadBuffer(out_vec.data(), count * sizeof(T)));
+            TWL_R_SUCCEED();
+        }
+
+        Result WriteCachedFile(fs::File &wf, const nfs::NitroFile &file) {
+            const CachedFileEntry entry = {
+                .file_id = file.file_id,
+                .data_offset = static_cast<u32>(file.data_offset),
+                .data_size = static_cast<u32>(file.data_size)
+            };
+            TWL_R_TRY(wf.Write(entry));
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadCachedFile(fs::File &rf, nfs::NitroFile &out_file) {
+            CachedFileEntry entry;
+            TWL_R_TRY(rf.Read(entry));
+            out_file.file_id = entry.file_id;
+            out_file.data_offset = entry.data_offset;
+            out_file.data_size = entry.data_size;
+            TWL_R_SUCCEED();
+        }
+
+        Result WriteCachedDirectory(fs::File &wf, const nfs::NitroDirectory &dir) {
+            TWL_R_TRY(WriteCachedString(wf, dir.name));
+
+            const u32 file_count = dir.files.size();
+            TWL_R_TRY(wf.Write(file_count));
+            for(const auto &file: dir.files) {
+                TWL_R_TRY(WriteCachedString(wf, file.name));
+                TWL_R_TRY(WriteCachedFile(wf, file));
+            }
+
+            const u32 dir_count = dir.dirs.size();
+            TWL_R_TRY(wf.Write(dir_count));
+            for(const auto &sub_dir: dir.dirs) {
+                TWL_R_TRY(WriteCachedDirectory(wf, sub_dir));
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadCachedDirectory(fs::File &rf, nfs::NitroDirectory &out_dir, const u32 depth) {
+            if(depth > MaxDirectoryDepth) {
+                TWL_R_FAIL(ResultROMInvalidIndexCache);
+            }
+
+            TWL_R_TRY(ReadCachedString(rf, out_dir.name));
+
+            u32 file_count;
+            TWL_R_TRY(ReadCachedCount(rf, sizeof(u16) + sizeof(CachedFileEntry), file_count));
+            out_dir.files.resize(file_count);
+            for(auto &file: out_dir.files) {
+                TWL_R_TRY(ReadCachedString(rf, file.name));
+                TWL_R_TRY(ReadCachedFile(rf, file));
+            }
+
+            u32 dir_count;
+            TWL_R_TRY(ReadCachedCount(rf, sizeof(u16) + 2 * sizeof(u32), dir_count));
+            out_dir.dirs.resize(dir_count);
+            for(auto &sub_dir: out_dir.dirs) {
+                TWL_R_TRY(ReadCachedDirectory(rf, sub_dir, depth + 1));
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        Result WriteCachedKey(fs::File &wf, const ROMIndexCache::Key &key) {
+            TWL_R_TRY(WriteCachedString(wf, key.rom_path));
+            TWL_R_TRY(wf.Write(key.rom_size));
+            TWL_R_TRY(wf.Write(key.rom_mtime));
+            TWL_R_TRY(wf.Write(key.header_crc16));
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadCachedKey(fs::File &rf, ROMIndexCache::Key &out_key) {
+            TWL_R_TRY(ReadCachedString(rf, out_key.rom_path));
+            TWL_R_TRY(rf.Read(out_key.rom_size));
+            TWL_R_TRY(rf.Read(out_key.rom_mtime));
+            TWL_R_TRY(rf.Read(out_key.header_crc16));
+            TWL_R_SUCCEED();
+        }
+
+        Result WriteIndex(fs::File &wf, const ROMIndexCache::Key &key, ROM &rom, const ROMManifest &manifest) {
+            TWL_R_TRY(wf.Write(ROMIndexCache::Magic));
+            TWL_R_TRY(wf.Write(ROMIndexCache::Version));
+            TWL_R_TRY(WriteCachedKey(wf, key));
+
+            TWL_R_TRY(wf.Write(rom.header));
+
+            auto section_flags = SectionFlags::None;
+            if(rom.footer.has_value()) {
+                section_flags = section_flags | SectionFlags::HasFooter;
+            }
+            if(rom.start_module_params.has_value()) {
+                section_flags = section_flags | SectionFlags::HasStartModuleParams;
+            }
+            TWL_R_TRY(wf.Write(section_flags));
+            if(rom.footer.has_value()) {
+                TWL_R_TRY(wf.Write(rom.footer.value()));
+            }
+            if(rom.start_module_params.has_value()) {
+                TWL_R_TRY(wf.Write(rom.start_module_params.value()));
+            }
+
+            TWL_R_TRY(WriteCachedVector(wf, rom.arm9_ovl_table));
+            TWL_R_TRY(WriteCachedVector(wf, rom.arm7_ovl_table));
+
+            // Symbols are stored as locations inside the symbol data block
+
+            TWL_R_TRY(WriteCachedVector(wf, rom.lib_symbols_data));
+            std::vector<CachedLibSymbolEntry> lib_symbols;
+            lib_symbols.reserve(rom.lib_symbols.size());
+            for(const auto &sym: rom.lib_symbols) {
+                lib_symbols.push_back({
+                    .offset = static_cast<u32>(sym.data() - rom.lib_symbols_data.data()),
+                    .length = static_cast<u32>(sym.length())
+                });
+            }
+            TWL_R_TRY(WriteCachedVector(wf, lib_symbols));
+
+            auto &nitro_fs = rom.GetFs();
+            const u32 ext_file_count = nitro_fs.ext_files.size();
+            TWL_R_TRY(wf.Write(ext_file_count));
+            for(const auto &ext_file: nitro_fs.ext_files) {
+                TWL_R_TRY(WriteCachedFile(wf, ext_file));
+            }
+            TWL_R_TRY(WriteCachedDirectory(wf, nitro_fs.root_dir));
+
+            // Manifest entries only keep what can't be restored from the filesystem index
+
+            const u32 manifest_entry_count = manifest.entries.size();
+            TWL_R_TRY(wf.Write(manifest_entry_count));
+            for(const auto &entry: manifest.entries) {
+                const CachedManifestEntry cached_entry = {
+                    .file_id = entry.file_id,
+                    .xxhash64 = entry.xxhash64,
+                    .lz_ver = entry.lz_ver,
+                    .decompressed_size = static_cast<u32>(entry.decompressed_size),
+                    .flags = entry.sha256.has_value() ? ManifestEntryFlags::HasSha256 : ManifestEntryFlags::None
+                };
+                TWL_R_TRY(wf.Write(cached_entry));
+                if(entry.sha256.has_value()) {
+                    TWL_R_TRY(wf.Write(entry.sha256.value()));
+                }
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        Result ReadIndex(fs::File &rf, const ROMIndexCache::Key &key, ROM &out_rom, ROMManifest &out_manifest) {
+            u32 magic;
+            TWL_R_TRY(rf.Read(magic));
+            u32 version;
+            TWL_R_TRY(rf.Read(version));
+            if((magic != ROMIndexCache::Magic) || (version != ROMIndexCache::Version)) {
+                TWL_R_FAIL(ResultROMInvalidIndexCache);
+            }
+
+            ROMIndexCache::Key cached_key;
+            TWL_R_TRY(ReadCachedKey(rf, cached_key));
+            if(cached_key != key) {
+                TWL_R_FAIL(ResultROMIndexCacheOutdated);
+            }
+
+            TWL_R_TRY(rf.Read(out_rom.header));
+
+            SectionFlags section_flags;
+            TWL_R_TRY(rf.Read(section_flags));
+            if((section_flags & SectionFlags::HasFooter) != SectionFlags::None) {
+                ROM::NitroFooter footer;
+                TWL_R_TRY(rf.Read(footer));
+                out_rom.footer = footer;
+            }
+            if((section_flags & SectionFlags::HasStartModuleParams) != SectionFlags::None) {
+                ROM::StartModuleParams params;
+                TWL_R_TRY(rf.Read(params));
+                out_rom.start_module_params = params;
+            }
+
+            TWL_R_TRY(ReadCachedVector(rf, out_rom.arm9_ovl_table));
+            TWL_R_TRY(ReadCachedVector(rf, out_rom.arm7_ovl_table));
+
+            TWL_R_TRY(ReadCachedVector(rf, out_rom.lib_symbols_data));
+            std::vector<CachedLibSymbolEntry> lib_symbols;
+            TWL_R_TRY(ReadCachedVector(rf, lib_symbols));
+            out_rom.lib_symbols.reserve(lib_symbols.size());
+            for(const auto &sym: lib_symbols) {
+                if((sym.offset > out_rom.lib_symbols_data.size()) || (sym.length > (out_rom.lib_symbols_data.size() - sym.offset))) {
+                    TWL_R_FAIL(ResultROMInvalidIndexCache);
+                }
+                out_rom.lib_symbols.emplace_back(out_rom.lib_symbols_data.data() + sym.offset, sym.length);
+            }
+
+            auto &nitro_fs = out_rom.GetFs();
+            u32 ext_file_count;
+            TWL_R_TRY(ReadCachedCount(rf, sizeof(CachedFileEntry), ext_file_count));
+            nitro_fs.ext_files.resize(ext_file_count);
+            for(auto &ext_file: nitro_fs.ext_files) {
+                TWL_R_TRY(ReadCachedFile(rf, ext_file));
+            }
+            TWL_R_TRY(ReadCachedDirectory(rf, nitro_fs.root_dir, 0));
+            nitro_fs.fat_data_offset = out_rom.header.fat_offset;
+            nitro_fs.fnt_data_offset = out_rom.header.fnt_offset;
+
+            std::vector<nfs::NitroFileSystem::FileListEntry> files;
+            nitro_fs.ListAllFiles(files);
+            std::vector<const nfs::NitroFileSystem::FileListEntry*> files_by_id(files.size(), nullptr);
+            for(const auto &file: files) {
+                if(file.file->file_id >= files_by_id.size()) {
+                    TWL_R_FAIL(ResultROMInvalidIndexCache);
+                }
+                files_by_id.at(file.file->file_id) = std::addressof(file);
+            }
+
+            u32 manifest_entry_count;
+            TWL_R_TRY(ReadCachedCount(rf, sizeof(CachedManifestEntry), manifest_entry_count));
+            out_manifest.entries.reserve(manifest_entry_count);
+            for(u32 i = 0; i < manifest_entry_count; i++) {
+                CachedManifestEntry cached_entry;
+                TWL_R_TRY(rf.Read(cached_entry));
+                if((cached_entry.file_id >= files_by_id.size()) || (files_by_id.at(cached_entry.file_id) == nullptr)) {
+                    TWL_R_FAIL(ResultROMInvalidIndexCache);
+                }
+
+                const auto &file = *files_by_id.at(cached_entry.file_id);
+                ROMManifest::Entry entry = {
+                    .path = file.path,
+                    .file_id = cached_entry.file_id,
+                    .offset = file.file->data_offset,
+                    .size = file.file->data_size,
+                    .xxhash64 = cached_entry.xxhash64,
+                    .sha256 = {},
+                    .lz_ver = cached_entry.lz_ver,
+                    .decompressed_size = cached_entry.decompressed_size
+                };
+                if((cached_entry.flags & ManifestEntryFlags::HasSha256) != ManifestEntryFlags::None) {
+                    util::Sha256Hash sha256;
+                    TWL_R_TRY(rf.Read(sha256));
+                    entry.sha256 = sha256;
+                }
+                out_manifest.entries.push_back(std::move(entry));
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        void ResetCachedROM(ROM &rom, ROMManifest &manifest) {
+            rom.read_opts = ROMIndexCache::CachedReadOptions;
+            rom.header = {};
+            rom.banner = {};
+            rom.arm7_rw.Dispose();
+            rom.arm9_rw.Dispose();
+            rom.footer = {};
+            rom.start_module_params = {};
+            rom.arm7_ovl_table.clear();
+            rom.arm9_ovl_table.clear();
+            rom.lib_symbols.clear();
+            rom.lib_symbols_data.clear();
+            rom.GetFs().Dispose();
+            manifest.entries.clear();
+        }
+
+    }
+
+    Result ROMIndexCache::ComputeKey(const std::string &rom_path, Key &out_key) {
+        std::error_code ec;
+        const auto abs_rom_path = std::filesystem::absolute(rom_path, ec);
+        if(ec) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+        const auto rom_size = std::filesystem::file_size(rom_path, ec);
+        if(ec) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+        const auto rom_mtime = std::filesystem::last_write_time(rom_path, ec);
+        if(ec) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+
+        fs::StdioFile rom_file(rom_path);
+        TWL_R_TRY(rom_file.OpenRead(fs::FileCompression::None));
+        ScopeGuard close_file([&]() {
+            rom_file.Close();
+        });
+
+        ROM::Header header;
+        TWL_R_TRY(rom_file.Read(header));
+
+        out_key = {
+            .rom_path = abs_rom_path.lexically_normal().string(),
+            .rom_size = rom_size,
+            .rom_mtime = static_cast<i64>(rom_mtime.time_since_epoch().count()),
+            .header_crc16 = util::ComputeCrc16(std::addressof(header), sizeof(header))
+        };
+        TWL_R_SUCCEED();
+    }
+
+    Result ROMIndexCache::Load(const Key &key, ROM &out_rom, ROMManifest &out_manifest) {
+        ResetCachedROM(out_rom, out_manifest);
+
+        fs::MappedFile cache_file(this->cache_path);
+        TWL_R_TRY(cache_file.OpenRead(fs::FileCompression::None));
+        ScopeGuard close_file([&]() {
+            cache_file.Close();
+        });
+
+        const auto rc = ReadIndex(cache_file, key, out_rom, out_manifest);
+        if(rc.IsFailure()) {
+            ResetCachedROM(out_rom, out_manifest);
+
+            // Truncated caches just fail to read
+            if(rc.value == ResultUnableToReadFile.value) {
+                TWL_R_FAIL(ResultROMInvalidIndexCache);
+            }
+            TWL_R_FAIL(rc);
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    Result ROMIndexCache::Save(const Key &key, ROM &rom, const ROMManifest &manifest) {
+        if(!rom.HasReadOption(CachedReadOptions)) {
+            TWL_R_FAIL(ResultROMSectionsNotLoaded);
+        }
+
+        // Written to a temporary file first, so that a failed/interrupted save never leaves a half-written cache behind
+
+        const auto tmp_cache_path = this->cache_path + ".tmp";
+        fs::StdioFile cache_file(tmp_cache_path);
+        TWL_R_TRY(cache_file.OpenWrite(fs::FileCompression::None));
+        ScopeGuard on_failure([&]() {
+            cache_file.Close();
+            std::error_code ec;
+            std::filesystem::remove(tmp_cache_path, ec);
+        });
+
+        TWL_R_TRY(WriteIndex(cache_file, key, rom, manifest));
+        TWL_R_TRY(cache_file.Close());
+
+        std::error_code ec;
+        std::filesystem::rename(tmp_cache_path, this->cache_path, ec);
+        if(ec) {
+            TWL_R_FAIL(ResultUnableToWriteFile);
+        }
+
+        on_failure.Cancel();
+        TWL_R_SUCCEED();
+    }
+
+}
@@ -0,0 +1,55 @@
+#include <twl/fmt/fmt_ROMManifest.hpp>
+#include <algorithm>
+
+namespace twl::fmt {
+
+    Result ROMManifest::Compute(ROM &rom, const u8 *rom_data, const size_t rom_data_size, const bool compute_sha256, const u32 thread_count) {
+        this->entries.clear();
+
+        std::vector<nfs::NitroFileSystem::FileListEntry> files;
+        rom.GetFs().ListAllFiles(files);
+
+        for(const auto &file: files) {
+            if((file.file->data_offset > rom_data_size) || (file.file->data_size > (rom_data_size - file.file->data_offset))) {
+                TWL_R_FAIL(ResultROMFileDataOutOfBounds);
+            }
+        }
+
+        this->entries.resize(files.size());
+        util::ParallelFor(files.size(), [&](const size_t i) {
+            const auto &file = *files.at(i).file;
+            const auto file_data = rom_data + file.data_offset;
+
+            auto &entry = this->entries.at(i);
+            entry = {
+                .path = files.at(i).path,
+                .file_id = file.file_id,
+                .offset = file.data_offset,
+                .size = file.data_size,
+                .xxhash64 = util::ComputeXxHash64(file_data, file.data_size),
+                .sha256 = {},
+                .lz_ver = util::LzVersion::Invalid,
+                .decompressed_size = file.data_size
+            };
+
+            if(compute_sha256) {
+                entry.sha256 = util::ComputeSha256(file_data, file.data_size);
+            }
+
+            // The whole stream is validated (without decompressing it), so uncompressed files starting like LZ data aren't reported as compressed
+            util::LzVersion lz_ver;
+            size_t decomp_size;
+            if(util::LzProbeCompressed(file_data, file.data_size, lz_ver, decomp_size).IsSuccess()) {
+                entry.lz_ver = lz_ver;
+                entry.decompressed_size = decomp_size;
+            }
+        }, thread_count);
+
+        std::sort(this->entries.begin(), this->entries.end(), [](const Entry &a, const Entry &b) {
+            return a.file_id < b.file_id;
+        });
+
+        TWL_R_SUCCEED();
+    }
+
+}
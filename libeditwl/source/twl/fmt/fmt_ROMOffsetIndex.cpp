@@ -0,0 +1,124 @@
+#include <twl/fmt/fmt_ROMOffsetIndex.hpp>
+#include <algorithm>
+
+namespace twl::fmt {
+
+    void ROMOffsetIndex::Build(ROM &rom, const size_t image_size) {
+        this->regions.clear();
+        this->files.clear();
+        this->image_size = image_size;
+
+        std::vector<Region> sections;
+        auto add_section = [&](const size_t start, const size_t size, const OwnerKind kind, const u32 file_idx) {
+            if((size > 0) && (start < image_size)) {
+                sections.push_back({
+                    .start = start,
+                    .end = std::min(start + size, image_size),
+                    .kind = kind,
+                    .file_idx = file_idx
+                });
+            }
+        };
+
+        const auto &header = rom.header;
+        add_section(0, sizeof(ROM::Header), OwnerKind::Header, 0);
+        add_section(header.arm9_rom_offset, header.arm9_rom_size + (rom.footer.has_value() ? sizeof(ROM::NitroFooter) : 0), OwnerKind::Arm9, 0);
+        add_section(header.arm9_overlay_table_offset, header.arm9_overlay_table_size, OwnerKind::Arm9OverlayTable, 0);
+        add_section(header.arm7_rom_offset, header.arm7_rom_size, OwnerKind::Arm7, 0);
+        add_section(header.arm7_overlay_table_offset, header.arm7_overlay_table_size, OwnerKind::Arm7OverlayTable, 0);
+        add_section(header.fnt_offset, header.fnt_size, OwnerKind::Fnt, 0);
+        add_section(header.fat_offset, header.fat_size, OwnerKind::Fat, 0);
+        if(header.banner_offset != 0) {
+            add_section(header.banner_offset, sizeof(ROM::Banner), OwnerKind::Banner, 0);
+        }
+
+        // File offsets/sizes come from the FAT (file offsets are absolute in ROMs)
+
+        std::vector<nfs::NitroFileSystem::FileListEntry> fs_files;
+        rom.GetFs().ListAllFiles(fs_files);
+        this->files.reserve(fs_files.size());
+        for(const auto &fs_file: fs_files) {
+            const auto file_idx = static_cast<u32>(this->files.size());
+            this->files.push_back({
+                .file_id = fs_file.file->file_id,
+                .path = fs_file.path
+            });
+            add_section(fs_file.file->data_offset, fs_file.file->data_size, OwnerKind::File, file_idx);
+        }
+
+        // Sections were added in precedence order, which the stable sort keeps for equal starts
+
+        std::stable_sort(sections.begin(), sections.end(), [](const Region &a, const Region &b) {
+            return a.start < b.start;
+        });
+
+        this->regions.reserve(sections.size() * 2 + 1);
+        size_t cur_offset = 0;
+        for(const auto &section: sections) {
+            if(section.end <= cur_offset) {
+                continue;
+            }
+
+            if(section.start > cur_offset) {
+                this->regions.push_back({
+                    .start = cur_offset,
+                    .end = section.start,
+                    .kind = OwnerKind::Unused,
+                    .file_idx = 0
+                });
+            }
+
+            auto region = section;
+            region.start = std::max(section.start, cur_offset);
+            this->regions.push_back(region);
+            cur_offset = section.end;
+        }
+
+        if(cur_offset < image_size) {
+            this->regions.push_back({
+                .start = cur_offset,
+                .end = image_size,
+                .kind = OwnerKind::Unused,
+                .file_idx = 0
+            });
+        }
+    }
+
+    const ROMOffsetIndex::Region *ROMOffsetIndex::Find(const size_t offset) const {
+        if(offset >= this->image_size) {
+            return nullptr;
+        }
+
+        // Regions are contiguous from offset 0, so the owner is the last one starting at or before the offset
+        const auto it = std::upper_bound(this->regions.begin(), this->regions.end(), offset, [](const size_t offset, const Region &region) {
+            return offset < region.start;
+        });
+        return std::addressof(*(it - 1));
+    }
+
+    const char *ROMOffsetIndex::GetOwnerKindName(const OwnerKind kind) {
+        switch(kind) {
+            case OwnerKind::Header:
+                return "header";
+            case OwnerKind::Arm9:
+                return "arm9";
+            case OwnerKind::Arm9OverlayTable:
+                return "arm9_overlay_table";
+            case OwnerKind::Arm7:
+                return "arm7";
+            case OwnerKind::Arm7OverlayTable:
+                return "arm7_overlay_table";
+            case OwnerKind::Fnt:
+                return "fnt";
+            case OwnerKind::Fat:
+                return "fat";
+            case OwnerKind::Banner:
+                return "banner";
+            case OwnerKind::File:
+                return "file";
+            default:
+                return "unused";
+        }
+    }
+
+}
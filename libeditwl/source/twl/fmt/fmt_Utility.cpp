@@ -30,17 +30,18 @@ namespace twl::fmt {
     }
 
     Result Utility::WriteTo(fs::File &rf) {
-        fs::BufferReaderWriter file_data_rw(0);
-        fs::BufferReaderWriter fnt_data_rw(0);
-
-        ScopeGuard save([&]() {
-            file_data_rw.Dispose();
-            fnt_data_rw.Dispose();
+        nfs::NitroFileSystem::LayoutPlan fs_plan = {};
+        ScopeGuard dispose_plan([&]() {
+            fs_plan.Dispose();
         });
 
-        std::vector<nfs::NitroFileSystem::DirectoryNameTableEntry> gen_fnt;
-        std::vector<nfs::NitroFileSystem::FileAllocationTableEntry> gen_fat;
-        TWL_R_TRY(this->nitro_fs.WriteTo(fnt_data_rw, file_data_rw, gen_fnt, gen_fat, 0x200));
+        const nfs::NitroFileSystem::WriteLayout fs_layout = {
+            .order = nfs::NitroFileSystem::FileDataOrder::TreeWalk,
+            .file_align = 0x200,
+            .trim_last_padding = false,
+            .access_trace = {}
+        };
+        TWL_R_TRY(this->nitro_fs.PlanLayout(fs_layout, fs_plan));
 
         /*
 
@@ -1,15 +1,22 @@
 #include <twl/fmt/nfs/nfs_NitroFs.hpp>
+#include <twl/util/util_Align.hpp>
+#include <algorithm>
 
 namespace twl::fmt::nfs {
 
     namespace {
 
-        Result ReadNitroFile(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const u16 file_id, NitroFile &out_file) {
+        Result ReadNitroFile(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const u16 file_id, const bool read_contents, NitroFile &out_file) {
             TWL_R_TRY(rf.SetAbsoluteOffset(fat_data_offset + file_id * sizeof(NitroFileSystem::FileAllocationTableEntry)));
             NitroFileSystem::FileAllocationTableEntry fat_entry;
             TWL_R_TRY(rf.Read(fat_entry));
 
             const auto file_size = fat_entry.file_end - fat_entry.file_start;
+            out_file.data_offset = file_data_offset + fat_entry.file_start;
+            out_file.data_size = file_size;
+            if(!read_contents) {
+                TWL_R_SUCCEED();
+            }
 
             TWL_R_TRY(rf.SetAbsoluteOffset(file_data_offset + fat_entry.file_start));
             auto file_buf = new u8[file_size]();
@@ -24,7 +31,7 @@ namespace twl::fmt::nfs {
             TWL_R_SUCCEED();
         }
 
-        Result ReadNitroDirectory(const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset, fs::File &rf, NitroDirectory &nitro_dir, const u16 dir_id, u16 &min_tree_file_id) {
+        Result ReadNitroDirectory(const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset, const bool read_contents, fs::File &rf, NitroDirectory &nitro_dir, const u16 dir_id, u16 &min_tree_file_id) {
             const auto dir_idx = dir_id & 0xFFF;
             TWL_R_TRY(rf.SetAbsoluteOffset(fnt_data_offset + dir_idx * sizeof(NitroFileSystem::DirectoryNameTableEntry)));
 
@@ -58,7 +65,7 @@ namespace twl::fmt::nfs {
                     size_t old_offset;
                     TWL_R_TRY(rf.GetOffset(old_offset));
 
-                    TWL_R_TRY(ReadNitroFile(rf, file_data_offset, fat_data_offset, cur_file_id, nitro_file));
+                    TWL_R_TRY(ReadNitroFile(rf, file_data_offset, fat_data_offset, cur_file_id, read_contents, nitro_file));
 
                     nitro_dir.files.push_back(std::move(nitro_file));
                     cur_file_id++;
@@ -79,7 +86,7 @@ namespace twl::fmt::nfs {
                     size_t old_offset;
                     TWL_R_TRY(rf.GetOffset(old_offset));
 
-                    TWL_R_TRY(ReadNitroDirectory(file_data_offset, fat_data_offset, fnt_data_offset, rf, nitro_subdir, sub_dir_id, min_tree_file_id));
+                    TWL_R_TRY(ReadNitroDirectory(file_data_offset, fat_data_offset, fnt_data_offset, read_contents, rf, nitro_subdir, sub_dir_id, min_tree_file_id));
 
                     nitro_dir.dirs.push_back(std::move(nitro_subdir));
                     TWL_R_TRY(rf.SetAbsoluteOffset(old_offset));
@@ -98,7 +105,7 @@ namespace twl::fmt::nfs {
             }
 
             for(auto &dir: nitro_dir.dirs) {
-                TWL_R_TRY(FindFileByIdInNitroDirectory(file_id, nitro_dir, out_file));
+                TWL_R_TRY(FindFileByIdInNitroDirectory(file_id, dir, out_file));
                 if(out_file != nullptr) {
                     TWL_R_SUCCEED();
                 }
@@ -169,21 +176,8 @@ namespace twl::fmt::nfs {
             TWL_R_SUCCEED();
         }
 
-        Result WriteNitroFile(fs::BufferReaderWriter &out_file_data, std::vector<NitroFileSystem::FileAllocationTableEntry> &out_fat, const size_t file_end_align, NitroFile &file) {
-            const auto cur_offset = out_file_data.GetBufferOffset();
-
-            out_fat.push_back(NitroFileSystem::FileAllocationTableEntry {
-                .file_start = static_cast<u32>(cur_offset),
-                .file_end = static_cast<u32>(cur_offset + file.inner_file.GetBufferSize())
-            });
-
-            TWL_R_TRY(out_file_data.WriteBuffer(file.inner_file.GetBuffer(), file.inner_file.GetBufferSize()));
-            TWL_R_TRY(out_file_data.WriteEnsureAlignment(file_end_align));
-
-            TWL_R_SUCCEED();
-        }
-
-        Result WriteNitroDirectory(fs::BufferReaderWriter &out_fnt_data, fs::BufferReaderWriter &out_file_data, std::vector<NitroFileSystem::DirectoryNameTableEntry> &out_fnt, std::vector<NitroFileSystem::FileAllocationTableEntry> &out_fat, const size_t file_end_align, NitroDirectory &nitro_dir, const u16 cur_dir_id, const u16 parent_dir_id, u16 &out_dir_count) {
+        // File IDs are assigned here (in tree order), but their data is written (and their FAT entries set) afterwards
+        Result WriteNitroDirectory(fs::BufferReaderWriter &out_fnt_data, std::vector<NitroFileSystem::DirectoryNameTableEntry> &out_fnt, std::vector<NitroFileSystem::FileAllocationTableEntry> &out_fat, NitroDirectory &nitro_dir, const u16 cur_dir_id, const u16 parent_dir_id, u16 &out_dir_count) {
             out_dir_count++;
 
             auto &cur_fnt_entry = out_fnt.at(cur_dir_id - NitroFileSystem::RootDirectoryId);
@@ -193,7 +187,7 @@ namespace twl::fmt::nfs {
             cur_fnt_entry.first_file_id = out_fat.size();
 
             for(auto &file: nitro_dir.files) {
-                TWL_R_TRY(WriteNitroFile(out_file_data, out_fat, file_end_align, file));
+                out_fat.emplace_back();
 
                 TWL_R_TRY(out_fnt_data.Write(static_cast<u8>(file.name.length())));
                 TWL_R_TRY(out_fnt_data.WriteBuffer(file.name.c_str(), file.name.length()));
@@ -233,12 +227,25 @@ namespace twl::fmt::nfs {
 
             for(u32 i = 0; i < nitro_dir.dirs.size(); i++) {
                 auto &dir = nitro_dir.dirs.at(i);
-                TWL_R_TRY(WriteNitroDirectory(out_fnt_data, out_file_data, out_fnt, out_fat, file_end_align, dir, subdir_ids.at(i), cur_dir_id, out_dir_count));
+                TWL_R_TRY(WriteNitroDirectory(out_fnt_data, out_fnt, out_fat, dir, subdir_ids.at(i), cur_dir_id, out_dir_count));
             }
 
             TWL_R_SUCCEED();
         }
 
+        void ListNitroDirectoryFiles(NitroDirectory &nitro_dir, const std::string &dir_path, std::vector<NitroFileSystem::FileListEntry> &out_files) {
+            for(auto &file: nitro_dir.files) {
+                out_files.push_back({
+                    .path = dir_path + "/" + file.name,
+                    .file = std::addressof(file)
+                });
+            }
+
+            for(auto &dir: nitro_dir.dirs) {
+                ListNitroDirectoryFiles(dir, dir_path + "/" + dir.name, out_files);
+            }
+        }
+
         void DisposeNitroDirectory(NitroDirectory &nitro_dir) {
             for(auto &file: nitro_dir.files) {
                 file.Dispose();
@@ -251,7 +258,7 @@ namespace twl::fmt::nfs {
 
     }
 
-    Result NitroFileSystem::ReadFrom(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset) {
+    Result NitroFileSystem::ReadFrom(fs::File &rf, const size_t file_data_offset, const size_t fat_data_offset, const size_t fnt_data_offset, const bool read_contents) {
         this->Dispose();
         
         // Note: we assume that, if any files are outside the directory tree structure, they will have the first IDs (ID 0, 1, 2...)
@@ -261,55 +268,183 @@ namespace twl::fmt::nfs {
         // Read and load tree structure (files and dirs)
 
         u16 min_tree_file_id = UINT16_MAX;
-        TWL_R_TRY(ReadNitroDirectory(file_data_offset, fat_data_offset, fnt_data_offset, rf, this->root_dir, NitroFileSystem::RootDirectoryId, min_tree_file_id));
+        TWL_R_TRY(ReadNitroDirectory(file_data_offset, fat_data_offset, fnt_data_offset, read_contents, rf, this->root_dir, NitroFileSystem::RootDirectoryId, min_tree_file_id));
 
         const auto ext_file_count = min_tree_file_id;
         for(u32 i = 0; i < ext_file_count; i++) {
-            NitroFile ext_file = {};
-            TWL_R_TRY(ReadNitroFile(rf, file_data_offset, fat_data_offset, i, ext_file));
+            NitroFile ext_file = {
+                .file_id = static_cast<u16>(i)
+            };
+            TWL_R_TRY(ReadNitroFile(rf, file_data_offset, fat_data_offset, i, read_contents, ext_file));
             this->ext_files.push_back(std::move(ext_file));
         }
     
         this->fat_data_offset = fat_data_offset;
         this->fnt_data_offset = fnt_data_offset;
+        this->contents_source = read_contents ? nullptr : std::addressof(rf);
         TWL_R_SUCCEED();
     }
 
-    Result NitroFileSystem::WriteTo(fs::BufferReaderWriter &out_fnt_data, fs::BufferReaderWriter &out_file_data, std::vector<NitroFileSystem::DirectoryNameTableEntry> &out_fnt, std::vector<NitroFileSystem::FileAllocationTableEntry> &out_fat, const size_t file_end_align) {
-        // Start with extra files
+    Result NitroFileSystem::LoadFileContents(NitroFile &file) {
+        if(!this->IsFileBackedBySource(file)) {
+            TWL_R_SUCCEED();
+        }
 
-        for(auto &ext_file: this->ext_files) {
-            TWL_R_TRY(WriteNitroFile(out_file_data, out_fat, file_end_align, ext_file));
+        auto file_buf = new u8[file.data_size]();
+        ScopeGuard on_failure([&]() {
+            delete[] file_buf;
+        });
+        TWL_R_TRY(this->contents_source->SetAbsoluteOffset(file.data_offset));
+        TWL_R_TRY(this->contents_source->ReadBuffer(file_buf, file.data_size));
+        on_failure.Cancel();
+
+        file.inner_file.CreateFrom(file_buf, file.data_size);
+        TWL_R_SUCCEED();
+    }
+
+    Result NitroFileSystem::WriteFileContents(fs::AbstractReaderWriter &wf, NitroFile &file) {
+        if(this->IsFileBackedBySource(file)) {
+            TWL_R_TRY(wf.CopyFrom(*this->contents_source, file.data_offset, file.data_size));
+        }
+        else {
+            TWL_R_TRY(wf.WriteBuffer(file.inner_file.GetBuffer(), file.inner_file.GetBufferSize()));
         }
 
-        // Then write the tree structure
+        TWL_R_SUCCEED();
+    }
+
+    Result NitroFileSystem::PlanLayout(const WriteLayout &layout, LayoutPlan &out_plan) {
+        if((layout.file_align == 0) || ((layout.file_align & (layout.file_align - 1)) != 0)) {
+            TWL_R_FAIL(ResultNitroFsInvalidFileAlignment);
+        }
 
-        out_fnt.clear();
-        out_fnt.emplace_back();
+        out_plan.Dispose();
+
+        // Start with extra files, then the tree structure
+
+        out_plan.fat.resize(this->ext_files.size());
+        out_plan.fnt.emplace_back();
 
         u16 total_dir_count = 0;
-        TWL_R_TRY(WriteNitroDirectory(out_fnt_data, out_file_data, out_fnt, out_fat, file_end_align, this->root_dir, NitroFileSystem::RootDirectoryId, 0, total_dir_count));
+        TWL_R_TRY(WriteNitroDirectory(out_plan.fnt_data, out_plan.fnt, out_plan.fat, this->root_dir, NitroFileSystem::RootDirectoryId, 0, total_dir_count));
 
         // Special use of the 'parent ID' field of the root directory (some editors check/rely on this)
         
-        out_fnt.at(0).parent_id = total_dir_count;
+        out_plan.fnt.at(0).parent_id = total_dir_count;
+
+        // Files are listed in the same order their IDs were assigned
+
+        std::vector<FileListEntry> files;
+        this->ListAllFiles(files);
 
+        out_plan.files.reserve(files.size());
+        out_plan.data_order.reserve(files.size());
+        for(size_t i = 0; i < files.size(); i++) {
+            out_plan.files.push_back(files.at(i).file);
+            out_plan.data_order.push_back(static_cast<u16>(i));
+        }
+
+        auto &file_order = out_plan.data_order;
+        switch(layout.order) {
+            case FileDataOrder::TreeWalk: {
+                break;
+            }
+            case FileDataOrder::Path: {
+                std::stable_sort(file_order.begin(), file_order.end(), [&](const u16 a, const u16 b) {
+                    return files.at(a).path < files.at(b).path;
+                });
+                break;
+            }
+            case FileDataOrder::Size: {
+                std::stable_sort(file_order.begin(), file_order.end(), [&](const u16 a, const u16 b) {
+                    return this->GetFileSize(*files.at(a).file) < this->GetFileSize(*files.at(b).file);
+                });
+                break;
+            }
+            case FileDataOrder::AccessTrace: {
+                std::vector<size_t> trace_idxs(UINT16_MAX + 1, SIZE_MAX);
+                for(size_t i = 0; i < layout.access_trace.size(); i++) {
+                    auto &trace_idx = trace_idxs.at(layout.access_trace.at(i));
+                    trace_idx = std::min(trace_idx, i);
+                }
+
+                std::stable_sort(file_order.begin(), file_order.end(), [&](const u16 a, const u16 b) {
+                    return trace_idxs.at(files.at(a).file->file_id) < trace_idxs.at(files.at(b).file->file_id);
+                });
+                break;
+            }
+        }
+
+        size_t cur_offset = 0;
+        for(size_t i = 0; i < file_order.size(); i++) {
+            const auto file_idx = file_order.at(i);
+            if(i > 0) {
+                cur_offset = util::AlignUp(cur_offset, layout.file_align);
+            }
+
+            const auto file_size = this->GetFileSize(*files.at(file_idx).file);
+            out_plan.fat.at(file_idx) = {
+                .file_start = static_cast<u32>(cur_offset),
+                .file_end = static_cast<u32>(cur_offset + file_size)
+            };
+            cur_offset += file_size;
+        }
+
+        if(!layout.trim_last_padding) {
+            cur_offset = util::AlignUp(cur_offset, layout.file_align);
+        }
+        out_plan.file_data_size = cur_offset;
+
+        TWL_R_SUCCEED();
+    }
+
+    Result NitroFileSystem::WriteFileData(fs::AbstractReaderWriter &wf, const LayoutPlan &plan) {
+        size_t cur_offset = 0;
+        for(const auto file_idx: plan.data_order) {
+            const auto &fat_entry = plan.fat.at(file_idx);
+            auto &file = *plan.files.at(file_idx);
+
+            TWL_R_TRY(wf.WritePadding(fat_entry.file_start - cur_offset));
+            TWL_R_TRY(this->WriteFileContents(wf, file));
+            cur_offset = fat_entry.file_end;
+        }
+
+        TWL_R_TRY(wf.WritePadding(plan.file_data_size - cur_offset));
         TWL_R_SUCCEED();
     }
 
+    void NitroFileSystem::ListAllFiles(std::vector<FileListEntry> &out_files) {
+        out_files.clear();
+
+        for(auto &ext_file: this->ext_files) {
+            out_files.push_back({
+                .path = "",
+                .file = std::addressof(ext_file)
+            });
+        }
+
+        ListNitroDirectoryFiles(this->root_dir, "", out_files);
+    }
+
     Result NitroFileSystemFile::OpenImpl(const fs::FileMode mode) {
         if(!this->IsValid()) {
             TWL_R_FAIL(ResultFileNotInitialized);
         }
 
+        // Contents not loaded yet are only loaded once actually accessed
+        if(this->nitro_fs != nullptr) {
+            TWL_R_TRY(this->nitro_fs->LoadFileContents(*this->file_ref));
+        }
+
         TWL_R_TRY(this->file_ref->inner_file.OpenImpl(mode));
+        this->mode = mode;
         TWL_R_SUCCEED();
     }
 
     Result NitroFileSystemFile::CreateById(NitroFileSystem &nitro_fs, const u32 file_id) {
         for(auto &ext_file: nitro_fs.ext_files) {
             if(ext_file.file_id == file_id) {
-                this->file_ref = std::addressof(ext_file);
+                this->SetFileRef(nitro_fs, std::addressof(ext_file));
                 TWL_R_SUCCEED();
             }
         }
@@ -318,7 +453,7 @@ namespace twl::fmt::nfs {
         TWL_R_TRY(FindFileByIdInNitroDirectory(file_id, nitro_fs.root_dir, tree_file));
 
         if(tree_file != nullptr) {
-            this->file_ref = tree_file;
+            this->SetFileRef(nitro_fs, tree_file);
             TWL_R_SUCCEED();
         }
         
@@ -333,7 +468,7 @@ namespace twl::fmt::nfs {
         TWL_R_TRY(FindFileByPathInNitroDirectory(path_items, 0, nitro_fs.root_dir, file));
 
         if(file != nullptr) {
-            this->file_ref = file;
+            this->SetFileRef(nitro_fs, file);
             TWL_R_SUCCEED();
         }
         
@@ -342,10 +477,13 @@ namespace twl::fmt::nfs {
 
     void NitroFileSystem::Dispose() {
         DisposeNitroDirectory(this->root_dir);
+        this->root_dir = {};
 
         for(auto &ext_file: this->ext_files) {
             ext_file.Dispose();
         }
+        this->ext_files.clear();
+        this->contents_source = nullptr;
     }
 
 }
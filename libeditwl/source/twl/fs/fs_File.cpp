@@ -1,12 +1,53 @@
 #include <twl/fs/fs_File.hpp>
 #include <cstring>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <cstdio>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace twl::fs {
 
+    Result AbstractReaderWriter::CopyFrom(AbstractReaderWriter &src_rw, const size_t src_offset, const size_t copy_size) {
+        if(copy_size == 0) {
+            TWL_R_SUCCEED();
+        }
+
+        size_t old_src_offset;
+        TWL_R_TRY(src_rw.GetOffset(old_src_offset));
+        TWL_R_TRY(src_rw.SetAbsoluteOffset(src_offset));
+
+        constexpr size_t MaxChunkSize = 0x100000;
+        const auto chunk_size = std::min(copy_size, MaxChunkSize);
+        auto chunk_buf = new u8[chunk_size]();
+        ScopeGuard cleanup([&]() {
+            delete[] chunk_buf;
+        });
+
+        auto left_size = copy_size;
+        while(left_size > 0) {
+            const auto cur_size = std::min(left_size, chunk_size);
+            TWL_R_TRY(src_rw.ReadBuffer(chunk_buf, cur_size));
+            TWL_R_TRY(this->WriteBuffer(chunk_buf, cur_size));
+            left_size -= cur_size;
+        }
+
+        TWL_R_TRY(src_rw.SetAbsoluteOffset(old_src_offset));
+        TWL_R_SUCCEED();
+    }
+
     void BufferReaderWriter::CreateAllocate(const size_t buf_size) {
         this->Dispose();
         this->buf = new u8[buf_size]();
         this->buf_size = buf_size;
+        this->buf_capacity = buf_size;
     }
     
     void BufferReaderWriter::CreateFrom(void *buf, const size_t buf_size, const bool transfer_ownership) {
@@ -20,6 +61,7 @@ namespace twl::fs {
             this->buf = owned_buf;
         }
         this->buf_size = buf_size;
+        this->buf_capacity = buf_size;
     }
 
     Result BufferReaderWriter::SetOffset(const ssize_t offset, const Whence whence) {
@@ -63,20 +105,21 @@ namespace twl::fs {
     }
 
     Result BufferReaderWriter::WriteBuffer(const void *write_buf, const size_t write_size) {
-        if((this->offset + write_size) >= this->buf_size) {
-            // Extend buffer
-            const auto new_size = this->offset + write_size;
-            auto new_buf = new u8[new_size]();
-            memcpy(new_buf, this->buf, this->offset);
-            memcpy(new_buf + this->offset, write_buf, write_size);
+        const auto end_offset = this->offset + write_size;
+        if(end_offset > this->buf_capacity) {
+            // Extend buffer (geometrically, so that many small appends don't copy everything each time)
+            const auto new_capacity = std::max(end_offset, this->buf_capacity * 2);
+            auto new_buf = new u8[new_capacity]();
+            memcpy(new_buf, this->buf, this->buf_size);
 
             auto old_buf = reinterpret_cast<u8*>(this->buf);
             this->buf = new_buf;
-            this->buf_size = new_size;
-            this->offset = new_size;
+            this->buf_capacity = new_capacity;
 
             delete[] old_buf;
-            TWL_R_SUCCEED();
+        }
+        if(end_offset > this->buf_size) {
+            this->buf_size = end_offset;
         }
 
         memcpy(reinterpret_cast<u8*>(this->buf) + this->offset, write_buf, write_size);
@@ -85,21 +128,88 @@ namespace twl::fs {
         TWL_R_SUCCEED();
     }
 
-    Result File::DecompressRead() {
+    Result File::DecompressRead(const bool probe) {
         size_t comp_size;
         TWL_R_TRY(this->GetSizeImpl(comp_size));
 
-        auto comp_buf = new u8[comp_size]();
-        TWL_R_TRY(this->ReadBufferImpl(comp_buf, comp_size));
+        // When probing, the declared decompressed size is checked against the file size before reading the whole file, so that uncompressed files which just happen to start like compressed ones (ROMs whose title starts with '$', '(' or '0', for instance) are cheaply rejected
+        if(probe) {
+            u8 comp_header[util::CompressedHeaderProbeSize] = {};
+            TWL_R_TRY(this->SetOffsetImpl(0, Whence::Begin));
+            TWL_R_TRY(this->ReadBufferImpl(comp_header, std::min(comp_size, sizeof(comp_header))));
+
+            size_t header_decomp_size;
+            Result header_rc;
+            switch(this->comp) {
+                case FileCompression::Huffman: {
+                    header_rc = util::HuffmanProbeCompressedHeader(comp_header, comp_size, this->huffman_ver, header_decomp_size);
+                    break;
+                }
+                case FileCompression::RLE: {
+                    header_rc = util::RleProbeCompressedHeader(comp_header, comp_size, header_decomp_size);
+                    break;
+                }
+                default: {
+                    header_rc = util::LzProbeCompressedHeader(comp_header, comp_size, this->lz_ver, header_decomp_size);
+                    break;
+                }
+            }
+
+            if(header_rc.IsFailure()) {
+                this->comp = FileCompression::None;
+                TWL_R_SUCCEED();
+            }
+        }
 
+        auto comp_buf = new u8[comp_size]();
         ScopeGuard delete_comp_buf([&]() {
             delete[] comp_buf;
         });
 
+        TWL_R_TRY(this->SetOffsetImpl(0, Whence::Begin));
+        TWL_R_TRY(this->ReadBufferImpl(comp_buf, comp_size));
+
+        // Detected compression is only trusted if the whole stream is valid, otherwise the file is assumed to be uncompressed
+        if(probe) {
+            size_t probe_decomp_size;
+            Result probe_rc;
+            switch(this->comp) {
+                case FileCompression::Huffman: {
+                    probe_rc = util::HuffmanProbeCompressed(comp_buf, comp_size, this->huffman_ver, probe_decomp_size);
+                    break;
+                }
+                case FileCompression::RLE: {
+                    probe_rc = util::RleProbeCompressed(comp_buf, comp_size, probe_decomp_size);
+                    break;
+                }
+                default: {
+                    probe_rc = util::LzProbeCompressed(comp_buf, comp_size, this->lz_ver, probe_decomp_size);
+                    break;
+                }
+            }
+
+            if(probe_rc.IsFailure()) {
+                this->comp = FileCompression::None;
+                TWL_R_SUCCEED();
+            }
+        }
+
         u8 *decomp_buf;
         size_t decomp_size;
-        size_t dummy_size;
-        TWL_R_TRY(util::LzDecompress(comp_buf, decomp_buf, decomp_size, this->lz_ver, dummy_size));
+        switch(this->comp) {
+            case FileCompression::Huffman: {
+                TWL_R_TRY(util::HuffmanDecompress(comp_buf, comp_size, util::MaximumHuffmanCompressSize, decomp_buf, decomp_size, this->huffman_ver));
+                break;
+            }
+            case FileCompression::RLE: {
+                TWL_R_TRY(util::RleDecompress(comp_buf, comp_size, decomp_buf, decomp_size));
+                break;
+            }
+            default: {
+                TWL_R_TRY(util::LzDecompress(comp_buf, comp_size, decomp_buf, decomp_size, this->lz_ver));
+                break;
+            }
+        }
 
         this->decomp_rw.CreateFrom(decomp_buf, decomp_size);
 
@@ -107,10 +217,30 @@ namespace twl::fs {
     }
 
     Result File::CompressWrite() {
-        if(CanWriteWithMode(this->mode)) {
+        // Unmodified contents are only left as they are if opening for writing didn't already discard them
+        if(CanWriteWithMode(this->mode) && (this->dirty || !this->KeepsContentsOnWrite())) {
+            const auto decomp_buf = reinterpret_cast<const u8*>(this->decomp_rw.GetBuffer());
+            const auto decomp_size = this->decomp_rw.GetBufferSize();
             u8 *comp_buf;
             size_t comp_size;
-            TWL_R_TRY(util::LzCompress(reinterpret_cast<const u8*>(this->decomp_rw.GetBuffer()), this->decomp_rw.GetBufferSize(), this->lz_ver, util::DefaultRepeatSize, comp_buf, comp_size));
+            switch(this->comp) {
+                case FileCompression::Huffman: {
+                    TWL_R_TRY(util::HuffmanCompress(decomp_buf, decomp_size, this->huffman_ver, comp_buf, comp_size, this->comp_cache));
+                    break;
+                }
+                case FileCompression::RLE: {
+                    TWL_R_TRY(util::RleCompress(decomp_buf, decomp_size, comp_buf, comp_size, this->comp_cache));
+                    break;
+                }
+                default: {
+                    auto lz_comp_opts = this->lz_comp_opts;
+                    if(lz_comp_opts.cache == nullptr) {
+                        lz_comp_opts.cache = this->comp_cache;
+                    }
+                    TWL_R_TRY(util::LzCompress(decomp_buf, decomp_size, this->lz_ver, lz_comp_opts, comp_buf, comp_size));
+                    break;
+                }
+            }
 
             ScopeGuard delete_comp_buf([&]() {
                 delete[] comp_buf;
@@ -130,36 +260,63 @@ namespace twl::fs {
             TWL_R_FAIL(ResultFileAlreadyOpened);
         }
 
+        // Compressed data is always rewritten as a whole, which wouldn't shrink an updated file
+        if((mode == FileMode::Update) && (comp != FileCompression::None)) {
+            TWL_R_FAIL(ResultInvalidFileMode);
+        }
+
         TWL_R_TRY(this->OpenImpl(mode));
+        this->dirty = false;
 
         if(CanReadWithMode(this->mode)) {
             if(comp == fs::FileCompression::Auto) {
-                // Check for LZ77 comp
-                u32 lz_header;
-                if(this->ReadBufferImpl(&lz_header, sizeof(lz_header)).IsSuccess()) {
+                // Check for LZ77/Huffman/RLE comp (files whose size is unknown, like standard input, are assumed to be uncompressed)
+                this->comp = FileCompression::None;
+                size_t file_size;
+                u32 comp_header;
+                if(this->GetSizeImpl(file_size).IsSuccess() && this->ReadBufferImpl(&comp_header, sizeof(comp_header)).IsSuccess()) {
                     util::LzVersion lz_version;
-                    if(util::LzValidateCompressed(lz_header, lz_version).IsSuccess()) {
+                    util::HuffmanVersion huffman_version;
+                    if(util::LzValidateCompressed(comp_header, lz_version).IsSuccess()) {
                         this->comp = FileCompression::LZ77;
                         this->lz_ver = lz_version;
-
-                        TWL_R_TRY(this->DecompressRead());
                     }
-                    else {
-                        // Not valid header, assume not compressed
-                        this->comp = FileCompression::None;
+                    else if(util::HuffmanValidateCompressed(comp_header, huffman_version).IsSuccess()) {
+                        this->comp = FileCompression::Huffman;
+                        this->huffman_ver = huffman_version;
+                    }
+                    else if(util::RleValidateCompressed(comp_header).IsSuccess()) {
+                        this->comp = FileCompression::RLE;
+                    }
+
+                    if(this->IsCompressed()) {
+                        TWL_R_TRY(this->DecompressRead(true));
                     }
-                }
-                else {
-                    // File might be less than 4 bytes, assume not compressed
-                    this->comp = FileCompression::None;
                 }
             }
             else {
                 this->comp = comp;
+                if(this->IsCompressed()) {
+                    TWL_R_TRY(this->DecompressRead(false));
+                }
             }
         }
         else if(CanWriteWithMode(this->mode)) {
-            this->comp = comp;
+            // Auto writes the file back the same way it was last read (or as set by SetCompressionInfo)
+            if(comp != FileCompression::Auto) {
+                this->comp = comp;
+            }
+            else if((this->comp == FileCompression::Invalid) || (this->comp == FileCompression::Auto)) {
+                this->comp = FileCompression::None;
+            }
+
+            // Versions never detected default to the most common ones
+            if((this->comp == FileCompression::LZ77) && (this->lz_ver == util::LzVersion::Invalid)) {
+                this->lz_ver = util::LzVersion::LZ10;
+            }
+            if((this->comp == FileCompression::Huffman) && (this->huffman_ver == util::HuffmanVersion::Invalid)) {
+                this->huffman_ver = util::HuffmanVersion::Huffman8;
+            }
         }
 
         TWL_R_TRY(this->SetOffsetImpl(0, Whence::Begin));
@@ -170,7 +327,12 @@ namespace twl::fs {
 
     Result File::SetOffset(const ssize_t offset, const Whence whence) {
         if(this->IsCompressed()) {
+            // Seeking past the end grows the buffer (when writing), which counts as a modification
+            const auto old_size = this->decomp_rw.GetBufferSize();
             TWL_R_TRY(this->decomp_rw.SetOffset(offset, whence));
+            if(this->decomp_rw.GetBufferSize() != old_size) {
+                this->dirty = true;
+            }
         }
         else {
             TWL_R_TRY(this->SetOffsetImpl(offset, whence));
@@ -212,6 +374,9 @@ namespace twl::fs {
             }
 
             TWL_R_TRY(this->decomp_rw.WriteBuffer(write_buf, write_size));
+            if(write_size > 0) {
+                this->dirty = true;
+            }
         }
         else {
             TWL_R_TRY(this->WriteBufferImpl(write_buf, write_size));
@@ -220,6 +385,65 @@ namespace twl::fs {
         TWL_R_SUCCEED();
     }
 
+    Result File::ExtendImpl(const size_t new_size) {
+        size_t cur_size;
+        TWL_R_TRY(this->GetSizeImpl(cur_size));
+        if(new_size <= cur_size) {
+            TWL_R_SUCCEED();
+        }
+
+        size_t cur_offset;
+        TWL_R_TRY(this->GetOffsetImpl(cur_offset));
+        TWL_R_TRY(this->SetOffsetImpl(cur_size, Whence::Begin));
+        TWL_R_TRY(this->WritePadding(new_size - cur_size));
+        TWL_R_TRY(this->SetOffsetImpl(cur_offset, Whence::Begin));
+        TWL_R_SUCCEED();
+    }
+
+    Result File::Extend(const size_t new_size) {
+        if(!CanWriteWithMode(this->mode)) {
+            TWL_R_FAIL(ResultWriteNotSupported);
+        }
+
+        if(this->IsCompressed()) {
+            const auto cur_size = this->decomp_rw.GetBufferSize();
+            if(new_size > cur_size) {
+                const auto cur_offset = this->decomp_rw.GetBufferOffset();
+                TWL_R_TRY(this->decomp_rw.SetOffset(cur_size, Whence::Begin));
+                TWL_R_TRY(this->decomp_rw.WritePadding(new_size - cur_size));
+                TWL_R_TRY(this->decomp_rw.SetOffset(cur_offset, Whence::Begin));
+                this->dirty = true;
+            }
+        }
+        else {
+            TWL_R_TRY(this->ExtendImpl(new_size));
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    Result File::CopyFromImpl(File &src_file, const size_t src_offset, const size_t copy_size) {
+        TWL_R_TRY(AbstractReaderWriter::CopyFrom(src_file, src_offset, copy_size));
+        TWL_R_SUCCEED();
+    }
+
+    Result File::CopyFrom(AbstractReaderWriter &src_rw, const size_t src_offset, const size_t copy_size) {
+        if(!CanWriteWithMode(this->mode)) {
+            TWL_R_FAIL(ResultWriteNotSupported);
+        }
+
+        // Compressed files are only accessible through their decompressed buffers
+        auto src_file = dynamic_cast<File*>(std::addressof(src_rw));
+        if((src_file == nullptr) || this->IsCompressed() || src_file->IsCompressed()) {
+            TWL_R_TRY(AbstractReaderWriter::CopyFrom(src_rw, src_offset, copy_size));
+        }
+        else {
+            TWL_R_TRY(this->CopyFromImpl(*src_file, src_offset, copy_size));
+        }
+
+        TWL_R_SUCCEED();
+    }
+
     Result File::Close() {
         if(!this->IsOpened()) {
             TWL_R_FAIL(ResultFileAlreadyClosed);
@@ -243,13 +467,21 @@ namespace twl::fs {
         }
 
         const char *conv_mode;
+        FILE *std_stream;
         switch(this->mode) {
             case FileMode::Read: {
                 conv_mode = "rb";
+                std_stream = stdin;
                 break;
             }
             case FileMode::Write: {
                 conv_mode = "wb";
+                std_stream = stdout;
+                break;
+            }
+            case FileMode::Update: {
+                conv_mode = "r+b";
+                std_stream = nullptr;
                 break;
             }
             default: {
@@ -257,6 +489,20 @@ namespace twl::fs {
             }
         }
 
+        this->is_std_stream = this->path == StdStreamPath;
+        this->std_stream_offset = 0;
+        if(this->is_std_stream) {
+            if(std_stream == nullptr) {
+                TWL_R_FAIL(ResultInvalidFileMode);
+            }
+
+            #ifdef _WIN32
+            _setmode(_fileno(std_stream), _O_BINARY);
+            #endif
+            this->file = std_stream;
+            TWL_R_SUCCEED();
+        }
+
         this->file = fopen(this->path.c_str(), conv_mode);
         if(this->file == nullptr) {
             TWL_R_FAIL(ResultUnableToOpenFile);
@@ -267,6 +513,16 @@ namespace twl::fs {
     }
 
     Result StdioFile::GetSizeImpl(size_t &out_size) {
+        if(this->is_std_stream) {
+            // Only known for output streams (everything written so far)
+            if(!CanWriteWithMode(this->mode)) {
+                TWL_R_FAIL(ResultUnableToSeekFile);
+            }
+
+            out_size = this->std_stream_offset;
+            TWL_R_SUCCEED();
+        }
+
         const auto cur_pos = ftell(this->file);
         if(fseek(this->file, 0, SEEK_END) != 0) {
             TWL_R_FAIL(ResultUnableToSeekFile);
@@ -296,6 +552,16 @@ namespace twl::fs {
             }
         }
 
+        if(this->is_std_stream) {
+            // Streams can't seek, but "seeking" to the current offset is fine
+            const auto new_offset = (whence == Whence::Begin) ? offset : (this->std_stream_offset + static_cast<ssize_t>(offset));
+            if(new_offset != this->std_stream_offset) {
+                TWL_R_FAIL(ResultUnableToSeekFile);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
         if(fseek(this->file, offset, conv_whence) != 0) {
             TWL_R_FAIL(ResultUnableToSeekFile);
         }
@@ -305,7 +571,12 @@ namespace twl::fs {
     }
 
     Result StdioFile::GetOffsetImpl(size_t &out_offset) {
-        out_offset = ftell(this->file);
+        if(this->is_std_stream) {
+            out_offset = this->std_stream_offset;
+        }
+        else {
+            out_offset = ftell(this->file);
+        }
         TWL_R_SUCCEED();
     }
 
@@ -314,10 +585,16 @@ namespace twl::fs {
             TWL_R_SUCCEED();
         }
 
+        // Switching between reading and writing requires a seek in between
+        if(this->mode == FileMode::Update) {
+            fseek(this->file, 0, SEEK_CUR);
+        }
+
         if(fread(read_buf, read_size, 1, this->file) != 1) {
             TWL_R_FAIL(ResultUnableToReadFile);
         }
         else {
+            this->std_stream_offset += read_size;
             TWL_R_SUCCEED();
         }
     }
@@ -327,10 +604,15 @@ namespace twl::fs {
             TWL_R_SUCCEED();
         }
 
+        if(this->mode == FileMode::Update) {
+            fseek(this->file, 0, SEEK_CUR);
+        }
+
         if(fwrite(write_buf, write_size, 1, this->file) != 1) {
             TWL_R_FAIL(ResultUnableToWriteFile);
         }
         else {
+            this->std_stream_offset += write_size;
             TWL_R_SUCCEED();
         }
     }
@@ -340,7 +622,7 @@ namespace twl::fs {
             TWL_R_FAIL(ResultUnableToCloseFile);
         }
 
-        const auto res = fclose(this->file);
+        const auto res = this->is_std_stream ? fflush(this->file) : fclose(this->file);
         this->file = nullptr;
         if(res != 0) {
             TWL_R_FAIL(ResultUnableToCloseFile);
@@ -350,6 +632,208 @@ namespace twl::fs {
         }
     }
 
+    Result StdioFile::ExtendImpl(const size_t new_size) {
+        size_t cur_size;
+        TWL_R_TRY(this->GetSizeImpl(cur_size));
+        if(new_size <= cur_size) {
+            TWL_R_SUCCEED();
+        }
+
+        if(this->is_std_stream) {
+            // Streams can only grow by appending (which moves the offset to the end)
+            TWL_R_TRY(this->WritePadding(new_size - cur_size));
+            TWL_R_SUCCEED();
+        }
+
+        #ifndef _WIN32
+
+        // Truncating upwards leaves a hole (sparse file) where the filesystem supports it
+        if(fflush(this->file) == 0) {
+            if(ftruncate(fileno(this->file), new_size) == 0) {
+                TWL_R_SUCCEED();
+            }
+        }
+
+        #endif
+
+        TWL_R_TRY(File::ExtendImpl(new_size));
+        TWL_R_SUCCEED();
+    }
+
+    Result StdioFile::CopyFromImpl(File &src_file, const size_t src_offset, const size_t copy_size) {
+        size_t copied_size = 0;
+
+        #ifdef __linux__
+
+        // The kernel copies the data directly (or just shares the extents on CoW filesystems), and explicit offsets leave the source file position untouched
+        auto src_stdio_file = dynamic_cast<StdioFile*>(std::addressof(src_file));
+        if((src_stdio_file != nullptr) && !this->is_std_stream && !src_stdio_file->is_std_stream && (fflush(this->file) == 0)) {
+            loff_t src_pos = src_offset;
+            loff_t dst_pos = ftello(this->file);
+            while(copied_size < copy_size) {
+                const auto cur_copied_size = copy_file_range(fileno(src_stdio_file->file), &src_pos, fileno(this->file), &dst_pos, copy_size - copied_size, 0);
+                if(cur_copied_size <= 0) {
+                    break;
+                }
+                copied_size += cur_copied_size;
+            }
+
+            if(fseeko(this->file, dst_pos, SEEK_SET) != 0) {
+                TWL_R_FAIL(ResultUnableToSeekFile);
+            }
+        }
+
+        #endif
+
+        // Anything the kernel couldn't copy (unsupported, cross-filesystem...) goes the usual way
+        TWL_R_TRY(File::CopyFromImpl(src_file, src_offset + copied_size, copy_size - copied_size));
+        TWL_R_SUCCEED();
+    }
+
+    bool StdioFile::GetIdentity(FileIdentity &out_id) {
+        #ifndef _WIN32
+
+        struct stat st;
+        if((this->file != nullptr) && (fstat(fileno(this->file), &st) == 0)) {
+            out_id = {
+                .device = static_cast<u64>(st.st_dev),
+                .inode = static_cast<u64>(st.st_ino)
+            };
+            return true;
+        }
+
+        #endif
+
+        return false;
+    }
+
+    Result MappedFile::OpenImpl(const FileMode mode) {
+        this->mode = mode;
+
+        if(this->mode != FileMode::Read) {
+            TWL_R_FAIL(ResultInvalidFileMode);
+        }
+        if(this->data != nullptr) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+
+        #ifdef _WIN32
+
+        // No mapping support here, just load everything
+        auto file = fopen(this->path.c_str(), "rb");
+        if(file == nullptr) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+        ScopeGuard close_file([&]() {
+            fclose(file);
+        });
+
+        fseek(file, 0, SEEK_END);
+        const auto f_size = ftell(file);
+        fseek(file, 0, SEEK_SET);
+        if(f_size < 0) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+
+        if(f_size > 0) {
+            auto buf = new u8[f_size]();
+            if(fread(buf, f_size, 1, file) != 1) {
+                delete[] buf;
+                TWL_R_FAIL(ResultUnableToReadFile);
+            }
+            this->data = buf;
+        }
+        this->data_size = f_size;
+
+        #else
+
+        const auto fd = open(this->path.c_str(), O_RDONLY);
+        if(fd < 0) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+        ScopeGuard close_fd([&]() {
+            close(fd);
+        });
+
+        struct stat st;
+        if(fstat(fd, &st) != 0) {
+            TWL_R_FAIL(ResultUnableToOpenFile);
+        }
+
+        // Note: empty files cannot be mapped, they are just left without data
+        if(st.st_size > 0) {
+            auto map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if(map == MAP_FAILED) {
+                TWL_R_FAIL(ResultUnableToOpenFile);
+            }
+            this->data = reinterpret_cast<const u8*>(map);
+        }
+        this->data_size = st.st_size;
+        this->identity = FileIdentity {
+            .device = static_cast<u64>(st.st_dev),
+            .inode = static_cast<u64>(st.st_ino)
+        };
+
+        #endif
+
+        this->offset = 0;
+        TWL_R_SUCCEED();
+    }
+
+    Result MappedFile::SetOffsetImpl(const size_t offset, const Whence whence) {
+        size_t new_offset;
+        switch(whence) {
+            case Whence::Begin: {
+                new_offset = offset;
+                break;
+            }
+            case Whence::Current: {
+                new_offset = this->offset + static_cast<ssize_t>(offset);
+                break;
+            }
+            default: {
+                TWL_R_FAIL(ResultInvalidSeekWhence);
+            }
+        }
+
+        if(new_offset > this->data_size) {
+            TWL_R_FAIL(ResultUnableToSeekFile);
+        }
+
+        this->offset = new_offset;
+        TWL_R_SUCCEED();
+    }
+
+    Result MappedFile::ReadBufferImpl(void *read_buf, const size_t read_size) {
+        if(read_size == 0) {
+            TWL_R_SUCCEED();
+        }
+
+        if((this->offset + read_size) > this->data_size) {
+            TWL_R_FAIL(ResultUnableToReadFile);
+        }
+
+        std::memcpy(read_buf, this->data + this->offset, read_size);
+        this->offset += read_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result MappedFile::CloseImpl() {
+        if(this->data != nullptr) {
+            #ifdef _WIN32
+            delete[] this->data;
+            #else
+            munmap(const_cast<u8*>(this->data), this->data_size);
+            #endif
+        }
+
+        this->data = nullptr;
+        this->data_size = 0;
+        this->offset = 0;
+        this->identity = {};
+        TWL_R_SUCCEED();
+    }
+
     Result BufferFile::OpenImpl(const FileMode mode) {
         this->mode = mode;
 
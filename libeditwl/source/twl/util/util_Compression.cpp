@@ -1,43 +1,1099 @@
 #include <twl/util/util_Compression.hpp>
 #include <twl/util/util_Align.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <twl/util/util_CompressionCache.hpp>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <queue>
 
 namespace twl::util {
 
     namespace {
 
-        // TODO: improve these?
-
-        void Lz10CompressSearch(const u8 *data, const size_t data_size, const size_t pos, size_t &match, size_t &length)
-		{
-			size_t num = 4096;
-			size_t num2 = 18;
-			match = 0;
-			length = 0;
-			size_t num3 = pos - num;
-			if (num3 < 0)
-			{
-				num3 = 0;
-			}
-			for (size_t i = num3; i < pos; i++)
-			{
-				size_t num4 = 0;
-				while ((num4 < num2) && ((i + num4) < pos) && ((pos + num4) < data_size) && (data[pos + num4] == data[i + num4]))
-				{
-					num4++;
-				}
-				if (num4 > length)
-				{
-					match = i;
-					length = num4;
-				}
-				if (length == num2)
-				{
-					return;
-				}
-			}
-		}
+        constexpr size_t LzMinimumMatchSize = 3;
+        // Matches may overlap the data they produce, but never copy the previous byte alone, which the 16-bit (VRAM) hardware decoder can't handle
+        constexpr size_t LzMinimumDistance = 2;
+        constexpr size_t LzMaximumDistance = 0x1000;
 
+        constexpr size_t LzHashBucketCount = 0x10000;
+        constexpr size_t LzHistorySize = 2 * LzMaximumDistance;
+
+        inline u32 GetLzHash(const u8 *data) {
+            return ((data[0] << 16) | (data[1] << 8) | data[2]) * 0x9E3779B1u >> (32 - 16);
+        }
+
+        // Hash chains of every position within the window, walked from the closest one
+        // Positions are inserted as the search moves forward, so parsers may look ahead freely but never back
+        struct LzMatchFinder {
+            const u8 *data;
+            size_t data_size;
+            size_t max_len;
+            size_t nice_len;
+            u32 max_chain_depth;
+            size_t next_insert_pos;
+            std::vector<i64> heads;
+            std::vector<i64> prev;
+            size_t last_pos;
+            size_t last_len;
+            size_t last_dist;
+
+            LzMatchFinder(const u8 *data, const size_t data_size, const size_t max_len, const size_t nice_len, const u32 max_chain_depth) : data(data), data_size(data_size), max_len(max_len), nice_len(std::min(nice_len, max_len)), max_chain_depth(max_chain_depth), next_insert_pos(0), heads(LzHashBucketCount, -1), prev(LzHistorySize, -1), last_pos(SIZE_MAX), last_len(0), last_dist(0) {}
+
+            // Positions before the window never change the search, thus searching can start anywhere by just inserting the window before it
+            inline void StartAt(const size_t pos) {
+                this->next_insert_pos = std::max(this->next_insert_pos, pos - std::min(pos, LzMaximumDistance));
+            }
+
+            inline void InsertUpTo(const size_t pos) {
+                for(; this->next_insert_pos < pos; this->next_insert_pos++) {
+                    if((this->next_insert_pos + LzMinimumMatchSize) <= this->data_size) {
+                        auto &head = this->heads[GetLzHash(this->data + this->next_insert_pos)];
+                        this->prev[this->next_insert_pos % LzHistorySize] = head;
+                        head = static_cast<i64>(this->next_insert_pos);
+                    }
+                }
+            }
+
+            // Searching the same position again (lazy parsing looks one position ahead) just returns the last result
+            size_t FindLongestMatch(const size_t pos, size_t &out_dist) {
+                if(pos != this->last_pos) {
+                    this->last_len = this->SearchLongestMatch(pos, this->last_dist);
+                    this->last_pos = pos;
+                }
+
+                out_dist = this->last_dist;
+                return this->last_len;
+            }
+
+            // The search stops at the first match of at least the nice length, which bounds the work on long runs
+            size_t SearchLongestMatch(const size_t pos, size_t &out_dist) {
+                this->InsertUpTo(pos);
+
+                size_t best_len = 0;
+                out_dist = 0;
+                if((pos + LzMinimumMatchSize) > this->data_size) {
+                    return 0;
+                }
+
+                const auto max_len = std::min(this->max_len, this->data_size - pos);
+                auto cand = this->heads[GetLzHash(this->data + pos)];
+                for(u32 i = 0; (cand >= 0) && (i < this->max_chain_depth); i++) {
+                    const auto dist = pos - static_cast<size_t>(cand);
+                    if(dist > LzMaximumDistance) {
+                        break;
+                    }
+
+                    // Quickly discard candidates which can't beat the current best one
+                    if((dist >= LzMinimumDistance) && (this->data[cand + best_len] == this->data[pos + best_len])) {
+                        size_t len = 0;
+                        while((len < max_len) && (this->data[cand + len] == this->data[pos + len])) {
+                            len++;
+                        }
+
+                        if(len > best_len) {
+                            best_len = len;
+                            out_dist = dist;
+                            if((len >= this->nice_len) || (len == max_len)) {
+                                break;
+                            }
+                        }
+                    }
+
+                    cand = this->prev[cand % LzHistorySize];
+                }
+
+                return (best_len >= LzMinimumMatchSize) ? best_len : 0;
+            }
+        };
+
+        // LZ11 extends the LZ10 2-byte form (3-16 bytes) with 3-byte (17-272 bytes) and 4-byte (273-65808 bytes) forms, the first length nibble telling them apart
+        constexpr size_t LZ11ShortMaximumLength = 0x10;
+        constexpr size_t LZ11MediumMinimumLength = 0x11;
+        constexpr size_t LZ11MediumMaximumLength = 0x110;
+        constexpr size_t LZ11LongMinimumLength = 0x111;
+
+        // Longer matches are taken right away by lazy/optimal parsing instead of weighing alternatives
+        constexpr size_t LzNiceMatchSize = LZ11MediumMaximumLength;
+
+        // Most output bytes a single input byte can produce (LZ10: 2-byte tokens for 18 bytes, LZ11: 4-byte tokens for 65808 bytes)
+        constexpr size_t GetLzMaximumExpansion(const LzVersion ver) {
+            return (ver == LzVersion::LZ10) ? (LZ10RepeatSize / 2) : (MaximumLZ11RepeatSize / 4 + 1);
+        }
+
+        inline size_t GetLzMatchTokenSize(const LzVersion ver, const size_t len) {
+            if((ver == LzVersion::LZ10) || (len <= LZ11ShortMaximumLength)) {
+                return 2;
+            }
+            return (len <= LZ11MediumMaximumLength) ? 3 : 4;
+        }
+
+        // Groups tokens in blocks of 8, each one preceded by a flag byte (set bits being matches)
+        struct LzTokenWriter {
+            LzVersion ver;
+            std::vector<u8> &out_enc;
+            size_t flag_offset;
+            u8 flag_mask;
+
+            LzTokenWriter(const LzVersion ver, std::vector<u8> &out_enc) : ver(ver), out_enc(out_enc), flag_offset(0), flag_mask(0) {}
+
+            inline void PushFlag(const bool is_match) {
+                if(this->flag_mask == 0) {
+                    this->flag_offset = this->out_enc.size();
+                    this->out_enc.push_back(0);
+                    this->flag_mask = 0x80;
+                }
+                if(is_match) {
+                    this->out_enc.at(this->flag_offset) |= this->flag_mask;
+                }
+                this->flag_mask >>= 1;
+            }
+
+            inline void PushLiteral(const u8 val) {
+                this->PushFlag(false);
+                this->out_enc.push_back(val);
+            }
+
+            void PushMatch(const size_t len, const size_t dist) {
+                this->PushFlag(true);
+
+                const auto disp = dist - 1;
+                if(this->ver == LzVersion::LZ10) {
+                    const auto val = ((len - LzMinimumMatchSize) << 12) | disp;
+                    this->out_enc.push_back(static_cast<u8>(val >> 8));
+                    this->out_enc.push_back(static_cast<u8>(val & 0xFF));
+                }
+                else if(len <= LZ11ShortMaximumLength) {
+                    const auto val = ((len - 1) << 12) | disp;
+                    this->out_enc.push_back(static_cast<u8>(val >> 8));
+                    this->out_enc.push_back(static_cast<u8>(val & 0xFF));
+                }
+                else if(len <= LZ11MediumMaximumLength) {
+                    const auto val = ((len - LZ11MediumMinimumLength) << 12) | disp;
+                    this->out_enc.push_back(static_cast<u8>(val >> 16));
+                    this->out_enc.push_back(static_cast<u8>((val >> 8) & 0xFF));
+                    this->out_enc.push_back(static_cast<u8>(val & 0xFF));
+                }
+                else {
+                    const auto val = (1u << 28) | ((len - LZ11LongMinimumLength) << 12) | disp;
+                    this->out_enc.push_back(static_cast<u8>(val >> 24));
+                    this->out_enc.push_back(static_cast<u8>((val >> 16) & 0xFF));
+                    this->out_enc.push_back(static_cast<u8>((val >> 8) & 0xFF));
+                    this->out_enc.push_back(static_cast<u8>(val & 0xFF));
+                }
+            }
+        };
+
+        struct LzToken {
+            size_t pos;
+            u32 len; // 1 for literals
+            u16 dist; // 0 for literals
+        };
+
+        inline void PushLzToken(LzTokenWriter &writer, const u8 *data, const LzToken &token) {
+            if(token.dist == 0) {
+                writer.PushLiteral(data[token.pos]);
+            }
+            else {
+                writer.PushMatch(token.len, token.dist);
+            }
+        }
+
+        // Greedy parsing takes the longest match at each position, while lazy parsing defers it (emitting a literal instead) if the next position has a longer one
+        // Either way the next token only depends on the position, which is what allows parsing segments in parallel
+        template<typename F>
+        LzToken LzParseNextToken(const LzCompressLevel level, const size_t data_size, F &finder, const size_t pos) {
+            const LzToken literal = {
+                .pos = pos,
+                .len = 1,
+                .dist = 0
+            };
+
+            size_t dist;
+            const auto len = finder.FindLongestMatch(pos, dist);
+            if(len == 0) {
+                return literal;
+            }
+
+            if((level == LzCompressLevel::Lazy) && (len < finder.nice_len) && ((pos + 1) < data_size)) {
+                size_t next_dist;
+                if(finder.FindLongestMatch(pos + 1, next_dist) > len) {
+                    return literal;
+                }
+            }
+
+            return {
+                .pos = pos,
+                .len = static_cast<u32>(len),
+                .dist = static_cast<u16>(dist)
+            };
+        }
+
+        template<typename F>
+        void LzEncodeSequential(const LzCompressLevel level, const u8 *data, const size_t data_size, F &finder, LzTokenWriter &writer) {
+            size_t pos = 0;
+            while(pos < data_size) {
+                const auto token = LzParseNextToken(level, data_size, finder, pos);
+                PushLzToken(writer, data, token);
+                pos += token.len;
+            }
+        }
+
+        // Shortest path over all token choices, costs being exact sizes in bits (flag bits included)
+        // Every shorter prefix of the longest match is a valid match too, and LZ token sizes only depend on the length, thus the longest match per position is enough
+        template<typename F>
+        void LzEncodeOptimal(const u8 *data, const size_t data_size, const LzVersion ver, F &finder, LzTokenWriter &writer) {
+            std::vector<u32> match_lens(data_size, 0);
+            std::vector<u16> match_dists(data_size, 0);
+            for(size_t pos = 0; pos < data_size; pos++) {
+                size_t dist;
+                const auto len = finder.FindLongestMatch(pos, dist);
+                match_lens[pos] = static_cast<u32>(len);
+                match_dists[pos] = static_cast<u16>(dist - 1);
+
+                // Long enough matches are just taken, no need to search inside them (LZ10 matches are never that long)
+                if(len >= LzNiceMatchSize) {
+                    pos += len - 1;
+                }
+            }
+
+            std::vector<u64> costs(data_size + 1, 0);
+            std::vector<u32> choices(data_size, 0);
+            for(size_t pos = data_size; pos > 0; pos--) {
+                const auto cur_pos = pos - 1;
+                const auto match_len = match_lens[cur_pos];
+
+                if(match_len >= LzNiceMatchSize) {
+                    costs[cur_pos] = 1 + 8 * GetLzMatchTokenSize(ver, match_len) + costs[cur_pos + match_len];
+                    choices[cur_pos] = match_len;
+                    continue;
+                }
+
+                auto best_cost = 9 + costs[cur_pos + 1];
+                u32 best_len = 1;
+                for(u32 len = LzMinimumMatchSize; len <= match_len; len++) {
+                    const auto cost = 1 + 8 * GetLzMatchTokenSize(ver, len) + costs[cur_pos + len];
+                    if(cost < best_cost) {
+                        best_cost = cost;
+                        best_len = len;
+                    }
+                }
+                costs[cur_pos] = best_cost;
+                choices[cur_pos] = best_len;
+            }
+
+            size_t pos = 0;
+            while(pos < data_size) {
+                const auto len = choices[pos];
+                if(len == 1) {
+                    writer.PushLiteral(data[pos]);
+                }
+                else {
+                    writer.PushMatch(len, match_dists[pos] + 1);
+                }
+                pos += len;
+            }
+        }
+
+        template<typename F>
+        void LzEncode(const LzCompressLevel level, const u8 *data, const size_t data_size, const LzVersion ver, F &finder, LzTokenWriter &writer) {
+            if(level == LzCompressLevel::Optimal) {
+                LzEncodeOptimal(data, data_size, ver, finder, writer);
+            }
+            else {
+                LzEncodeSequential(level, data, data_size, finder, writer);
+            }
+        }
+
+        constexpr size_t LzParallelMinimumSize = 1_MB;
+        constexpr size_t LzParallelSegmentSize = 256_KB;
+
+        // Optimal parsing searches (almost) every position anyway: the longest match of every position is searched beforehand in parallel, over segments starting with the window before them
+        // Search results only depend on the positions within the window, thus they (and the output) are the same as the sequential search
+        struct LzParallelMatchFinder {
+            static constexpr u32 NotSearched = UINT32_MAX;
+
+            size_t nice_len;
+            std::vector<u32> lens;
+            std::vector<u16> dists;
+            LzMatchFinder fallback_finder;
+
+            LzParallelMatchFinder(const u8 *data, const size_t data_size, const size_t max_len, const size_t nice_len, const u32 max_chain_depth, const u32 thread_count) : nice_len(std::min(nice_len, max_len)), lens(data_size), dists(data_size), fallback_finder(data, data_size, max_len, nice_len, max_chain_depth) {
+                const auto segment_count = (data_size + LzParallelSegmentSize - 1) / LzParallelSegmentSize;
+                ParallelFor(segment_count, [&](const size_t i) {
+                    const auto seg_start = i * LzParallelSegmentSize;
+                    const auto seg_end = std::min(seg_start + LzParallelSegmentSize, data_size);
+
+                    LzMatchFinder finder(data, data_size, max_len, nice_len, max_chain_depth);
+                    finder.StartAt(seg_start);
+                    for(auto pos = seg_start; pos < seg_end; pos++) {
+                        size_t dist;
+                        const auto len = finder.FindLongestMatch(pos, dist);
+                        this->lens[pos] = static_cast<u32>(len);
+                        this->dists[pos] = static_cast<u16>(dist);
+
+                        // Positions within long matches are rarely needed by the parsers (they are searched later if so)
+                        if(len >= LzNiceMatchSize) {
+                            const auto skip_end = std::min(pos + len, seg_end);
+                            for(pos++; pos < skip_end; pos++) {
+                                this->lens[pos] = NotSearched;
+                            }
+                            pos--;
+                        }
+                    }
+                }, thread_count);
+            }
+
+            // Like the parsers do, positions must be searched in increasing order
+            size_t FindLongestMatch(const size_t pos, size_t &out_dist) {
+                if(this->lens[pos] == NotSearched) {
+                    auto &finder = this->fallback_finder;
+                    finder.StartAt(pos);
+
+                    size_t dist;
+                    this->lens[pos] = static_cast<u32>(finder.FindLongestMatch(pos, dist));
+                    this->dists[pos] = static_cast<u16>(dist);
+                }
+
+                out_dist = this->dists[pos];
+                return this->lens[pos];
+            }
+        };
+
+        void LzEncodeParallel(const LzCompressLevel level, const u8 *data, const size_t data_size, const LzVersion ver, const size_t max_len, const size_t nice_len, const u32 max_chain_depth, const u32 thread_count, LzTokenWriter &writer) {
+            if(level == LzCompressLevel::Optimal) {
+                LzParallelMatchFinder finder(data, data_size, max_len, nice_len, max_chain_depth, thread_count);
+                LzEncodeOptimal(data, data_size, ver, finder, writer);
+                return;
+            }
+
+            // Greedy/lazy: every segment is parsed in parallel as if parsing started right there, then the actual parse joins each segment's tokens as soon as it reaches the position of one of them (usually within a few tokens)
+            const auto segment_count = (data_size + LzParallelSegmentSize - 1) / LzParallelSegmentSize;
+            std::vector<std::vector<LzToken>> segment_tokens(segment_count);
+            ParallelFor(segment_count, [&](const size_t i) {
+                const auto seg_start = i * LzParallelSegmentSize;
+                const auto seg_end = std::min(seg_start + LzParallelSegmentSize, data_size);
+
+                LzMatchFinder finder(data, data_size, max_len, nice_len, max_chain_depth);
+                finder.StartAt(seg_start);
+                auto &tokens = segment_tokens.at(i);
+                auto pos = seg_start;
+                while(pos < seg_end) {
+                    tokens.push_back(LzParseNextToken(level, data_size, finder, pos));
+                    pos += tokens.back().len;
+                }
+            }, thread_count);
+
+            LzMatchFinder finder(data, data_size, max_len, nice_len, max_chain_depth);
+            auto parse_next = [&](size_t &pos) {
+                finder.StartAt(pos);
+                const auto token = LzParseNextToken(level, data_size, finder, pos);
+                PushLzToken(writer, data, token);
+                pos += token.len;
+            };
+
+            size_t pos = 0;
+            for(const auto &tokens: segment_tokens) {
+                auto token_it = tokens.begin();
+                while(true) {
+                    token_it = std::lower_bound(token_it, tokens.end(), pos, [](const LzToken &token, const size_t pos) {
+                        return token.pos < pos;
+                    });
+                    if((token_it == tokens.end()) || (token_it->pos == pos)) {
+                        break;
+                    }
+                    parse_next(pos);
+                }
+
+                for(; token_it != tokens.end(); token_it++) {
+                    PushLzToken(writer, data, *token_it);
+                    pos += token_it->len;
+                }
+            }
+
+            while(pos < data_size) {
+                parse_next(pos);
+            }
+        }
+
+        constexpr size_t BlzMinimumHeaderSize = BlzFooterSize;
+        constexpr size_t BlzMaximumHeaderSize = BlzFooterSize + 3;
+        constexpr size_t BlzMinimumMatchSize = 3;
+        constexpr size_t BlzMaximumMatchSize = BlzMinimumMatchSize + 0xF;
+        constexpr size_t BlzMinimumDistance = 3;
+        constexpr size_t BlzMaximumDistance = BlzMinimumDistance + 0xFFF;
+
+        constexpr size_t BlzHashBucketCount = 0x8000;
+        constexpr size_t BlzHistorySize = 0x2000;
+        constexpr u32 BlzMaximumChainLength = 128;
+
+        inline u32 GetBlzHash(const u8 *data) {
+            return ((data[0] << 16) | (data[1] << 8) | data[2]) * 0x9E3779B1u >> (32 - 15);
+        }
+
+        // Encodes the data in reversed order (like it will be decoded), keeping track of the point with the smallest compressed + remaining uncompressed size
+        // Stopping there guarantees that decompressing in-place never overwrites compressed data that wasn't read yet
+        void BlzEncodeReversed(const u8 *rev_data, const size_t data_size, const size_t enc_size, std::vector<u8> &out_enc, size_t &out_best_enc_size, size_t &out_best_raw_size) {
+            std::vector<i32> heads(BlzHashBucketCount, -1);
+            std::vector<i32> prev(BlzHistorySize, -1);
+            const auto insert_pos = [&](const size_t pos) {
+                if((pos + BlzMinimumMatchSize) <= data_size) {
+                    auto &head = heads[GetBlzHash(rev_data + pos)];
+                    prev[pos % BlzHistorySize] = head;
+                    head = static_cast<i32>(pos);
+                }
+            };
+
+            out_enc.clear();
+            out_enc.reserve(enc_size + (enc_size + 7) / 8);
+            out_best_enc_size = 0;
+            out_best_raw_size = data_size;
+
+            size_t pos = 0;
+            size_t flag_offset = 0;
+            u8 flag_mask = 0;
+            while(pos < enc_size) {
+                if(flag_mask == 0) {
+                    flag_offset = out_enc.size();
+                    out_enc.push_back(0);
+                    flag_mask = 0x80;
+                }
+
+                size_t best_len = 0;
+                size_t best_dist = 0;
+                if((pos + BlzMinimumMatchSize) <= enc_size) {
+                    const auto max_len = std::min(BlzMaximumMatchSize, enc_size - pos);
+                    auto cand = heads[GetBlzHash(rev_data + pos)];
+                    for(u32 i = 0; (cand >= 0) && (i < BlzMaximumChainLength); i++) {
+                        const auto dist = pos - cand;
+                        if(dist > BlzMaximumDistance) {
+                            break;
+                        }
+
+                        if(dist >= BlzMinimumDistance) {
+                            // Matches never overlap the data they produce, like the SDK encoder
+                            const auto cand_max_len = std::min(max_len, dist);
+                            size_t len = 0;
+                            while((len < cand_max_len) && (rev_data[cand + len] == rev_data[pos + len])) {
+                                len++;
+                            }
+
+                            if(len > best_len) {
+                                best_len = len;
+                                best_dist = dist;
+                                if(len == max_len) {
+                                    break;
+                                }
+                            }
+                        }
+
+                        cand = prev[cand % BlzHistorySize];
+                    }
+                }
+
+                if(best_len >= BlzMinimumMatchSize) {
+                    out_enc.at(flag_offset) |= flag_mask;
+                    const auto val = ((best_len - BlzMinimumMatchSize) << 12) | (best_dist - BlzMinimumDistance);
+                    out_enc.push_back(static_cast<u8>(val >> 8));
+                    out_enc.push_back(static_cast<u8>(val & 0xFF));
+                    for(size_t i = 0; i < best_len; i++) {
+                        insert_pos(pos + i);
+                    }
+                    pos += best_len;
+                }
+                else {
+                    out_enc.push_back(rev_data[pos]);
+                    insert_pos(pos);
+                    pos++;
+                }
+                flag_mask >>= 1;
+
+                if((out_enc.size() + (data_size - pos)) < (out_best_enc_size + out_best_raw_size)) {
+                    out_best_enc_size = out_enc.size();
+                    out_best_raw_size = data_size - pos;
+                }
+            }
+        }
+
+
+        // Huffman trees are stored as a table of node pairs right after the header: its first byte is the table size (in halfwords, minus one) and the root node comes right after it
+        // A node's children pair is at (node_addr & ~1) + offset * 2 + 2 (table-relative), where the offset only has 6 bits, and its flags tell whether each child is a symbol or another node
+        constexpr size_t HuffmanMaximumNodeOffset = 0x3F;
+        constexpr size_t HuffmanMaximumTableSize = 0x200;
+        constexpr size_t HuffmanRootAddress = 1;
+        constexpr u8 HuffmanChild0SymbolFlag = 0x80;
+        constexpr u8 HuffmanChild1SymbolFlag = 0x40;
+
+        inline constexpr size_t GetHuffmanSymbolBits(const HuffmanVersion ver) {
+            return static_cast<size_t>(ver) & 0xF;
+        }
+
+        // Returns false if the child is outside the table
+        inline bool GetHuffmanChild(const u8 *table, const size_t table_size, const size_t node_addr, const u32 bit, size_t &out_child_addr, bool &out_is_symbol) {
+            const auto node = table[node_addr];
+            out_child_addr = (node_addr & ~static_cast<size_t>(1)) + (node & HuffmanMaximumNodeOffset) * 2 + 2 + bit;
+            out_is_symbol = (node & (bit ? HuffmanChild1SymbolFlag : HuffmanChild0SymbolFlag)) != 0;
+            return out_child_addr < table_size;
+        }
+
+        struct HuffmanNode {
+            size_t freq;
+            i32 children[2]; // -1 for symbols
+            u8 symbol;
+            size_t node_count; // Nodes (non-symbols) in the subtree, including itself
+            size_t addr;
+        };
+
+        // Symbols with the same frequency are combined in a fixed order, thus the output only depends on the input
+        void BuildHuffmanTree(const std::vector<size_t> &freqs, std::vector<HuffmanNode> &out_nodes) {
+            std::priority_queue<std::pair<size_t, size_t>, std::vector<std::pair<size_t, size_t>>, std::greater<std::pair<size_t, size_t>>> queue;
+            auto add_symbol = [&](const size_t symbol) {
+                queue.push({ freqs.at(symbol), out_nodes.size() });
+                out_nodes.push_back({
+                    .freq = freqs.at(symbol),
+                    .children = { -1, -1 },
+                    .symbol = static_cast<u8>(symbol),
+                    .node_count = 0,
+                    .addr = 0
+                });
+            };
+
+            for(size_t symbol = 0; symbol < freqs.size(); symbol++) {
+                if(freqs.at(symbol) > 0) {
+                    add_symbol(symbol);
+                }
+            }
+            // The root must be a node, thus at least two symbols are needed
+            for(size_t symbol = 0; queue.size() < 2; symbol++) {
+                if(freqs.at(symbol) == 0) {
+                    add_symbol(symbol);
+                }
+            }
+
+            while(queue.size() > 1) {
+                const auto child_0 = queue.top().second;
+                queue.pop();
+                const auto child_1 = queue.top().second;
+                queue.pop();
+
+                const auto &node_0 = out_nodes.at(child_0);
+                const auto &node_1 = out_nodes.at(child_1);
+                const HuffmanNode node = {
+                    .freq = node_0.freq + node_1.freq,
+                    .children = { static_cast<i32>(child_0), static_cast<i32>(child_1) },
+                    .symbol = 0,
+                    .node_count = node_0.node_count + node_1.node_count + 1,
+                    .addr = 0
+                };
+                queue.push({ node.freq, out_nodes.size() });
+                out_nodes.push_back(node);
+            }
+        }
+
+        // Pairs are laid out one at a time, each one holding the children of some node already laid out, which can't be more than 64 pairs after it
+        // Plain breadth-first order overflows that on big trees, so unless some node is about to run out of room, the one with the smallest subtree goes first (small subtrees are quickly finished, keeping few nodes pending)
+        bool LayoutHuffmanTree(std::vector<HuffmanNode> &nodes, const size_t root_idx, std::vector<u8> &out_table) {
+            out_table.assign(2 + 2 * nodes.at(root_idx).node_count, 0);
+            nodes.at(root_idx).addr = HuffmanRootAddress;
+
+            auto get_deadline = [&](const size_t node_idx) {
+                return nodes.at(node_idx).addr / 2 + HuffmanMaximumNodeOffset + 1;
+            };
+
+            std::vector<size_t> pending = { root_idx };
+            for(size_t pair_idx = 1; !pending.empty(); pair_idx++) {
+                std::sort(pending.begin(), pending.end(), [&](const size_t a, const size_t b) {
+                    return nodes.at(a).addr < nodes.at(b).addr;
+                });
+
+                auto chosen_it = pending.begin();
+                bool urgent = false;
+                for(size_t i = 0; i < pending.size(); i++) {
+                    const auto deadline = get_deadline(pending.at(i));
+                    if(deadline < (pair_idx + i)) {
+                        return false;
+                    }
+                    if(deadline == (pair_idx + i)) {
+                        urgent = true;
+                    }
+                }
+                if(!urgent) {
+                    chosen_it = std::min_element(pending.begin(), pending.end(), [&](const size_t a, const size_t b) {
+                        return nodes.at(a).node_count < nodes.at(b).node_count;
+                    });
+                }
+
+                const auto &node = nodes.at(*chosen_it);
+                auto node_byte = static_cast<u8>(pair_idx - node.addr / 2 - 1);
+                pending.erase(chosen_it);
+
+                for(u32 bit = 0; bit < 2; bit++) {
+                    auto &child = nodes.at(node.children[bit]);
+                    child.addr = 2 * pair_idx + bit;
+                    if(child.children[0] < 0) {
+                        out_table.at(child.addr) = child.symbol;
+                        node_byte |= bit ? HuffmanChild1SymbolFlag : HuffmanChild0SymbolFlag;
+                    }
+                    else {
+                        pending.push_back(node.children[bit]);
+                    }
+                }
+                out_table.at(node.addr) = node_byte;
+            }
+
+            return true;
+        }
+
+        struct HuffmanCode {
+            u64 bits;
+            u32 len;
+        };
+
+        void GetHuffmanCodes(const std::vector<HuffmanNode> &nodes, const size_t node_idx, const HuffmanCode code, std::vector<HuffmanCode> &out_codes) {
+            const auto &node = nodes.at(node_idx);
+            if(node.children[0] < 0) {
+                out_codes.at(node.symbol) = code;
+            }
+            else {
+                for(u32 bit = 0; bit < 2; bit++) {
+                    GetHuffmanCodes(nodes, node.children[bit], { (code.bits << 1) | bit, code.len + 1 }, out_codes);
+                }
+            }
+        }
+
+        // Bits are stored from the most significant one of little-endian words
+        struct HuffmanBitWriter {
+            std::vector<u8> &enc;
+            u64 acc;
+            u32 acc_bits;
+
+            HuffmanBitWriter(std::vector<u8> &enc) : enc(enc), acc(0), acc_bits(0) {}
+
+            inline void PushWord(const u32 word) {
+                const auto offset = this->enc.size();
+                this->enc.resize(offset + sizeof(u32));
+                std::memcpy(this->enc.data() + offset, &word, sizeof(u32));
+            }
+
+            inline void PushBits(const u64 bits, const u32 len) {
+                // Codes are way shorter than 32 bits on real data (bounded by the input size), but split them anyway so that the accumulator never overflows
+                if(len > 32) {
+                    this->PushBits(bits >> 32, len - 32);
+                    this->PushBits(bits & 0xFFFFFFFF, 32);
+                    return;
+                }
+
+                this->acc = (this->acc << len) | bits;
+                this->acc_bits += len;
+                if(this->acc_bits >= 32) {
+                    this->acc_bits -= 32;
+                    this->PushWord(static_cast<u32>(this->acc >> this->acc_bits));
+                }
+            }
+
+            inline void Flush() {
+                if(this->acc_bits > 0) {
+                    this->PushWord(static_cast<u32>(this->acc << (32 - this->acc_bits)));
+                    this->acc_bits = 0;
+                }
+            }
+        };
+
+        // Decoding looks up the next bits in a table built from the tree, yielding as many whole symbols as they contain at once (codes longer than the lookup are walked bit by bit)
+        constexpr size_t HuffmanLookupBits = 11;
+        constexpr size_t HuffmanLookupMaximumSymbols = 4;
+
+        struct HuffmanLookupEntry {
+            u8 symbol_count;
+            u8 symbols[HuffmanLookupMaximumSymbols];
+            u8 bit_counts[HuffmanLookupMaximumSymbols]; // Bits consumed up to (and including) each symbol
+        };
+
+        void BuildHuffmanLookup(const u8 *table, const size_t table_size, std::vector<HuffmanLookupEntry> &out_lookup) {
+            out_lookup.resize(1ul << HuffmanLookupBits);
+            for(size_t bits = 0; bits < out_lookup.size(); bits++) {
+                auto &entry = out_lookup.at(bits);
+                entry.symbol_count = 0;
+
+                // Invalid paths just end the entry, and get rejected once actually walked bit by bit
+                auto addr = HuffmanRootAddress;
+                for(size_t i = 0; (i < HuffmanLookupBits) && (entry.symbol_count < HuffmanLookupMaximumSymbols); i++) {
+                    const u32 bit = (bits >> (HuffmanLookupBits - 1 - i)) & 1;
+                    size_t child_addr;
+                    bool is_symbol;
+                    if(!GetHuffmanChild(table, table_size, addr, bit, child_addr, is_symbol)) {
+                        break;
+                    }
+
+                    if(is_symbol) {
+                        entry.symbols[entry.symbol_count] = table[child_addr];
+                        entry.bit_counts[entry.symbol_count] = static_cast<u8>(i + 1);
+                        entry.symbol_count++;
+                        addr = HuffmanRootAddress;
+                    }
+                    else {
+                        addr = child_addr;
+                    }
+                }
+            }
+        }
+
+        constexpr size_t RleMinimumRunSize = 3;
+        constexpr size_t RleMaximumRunSize = 0x7F + RleMinimumRunSize;
+        constexpr size_t RleMaximumLiteralSize = 0x80;
+        constexpr u8 RleRunFlag = 0x80;
+
+        // Both formats store the decompressed size in the header the same way LZ10 does
+        inline u32 MakeCompressionHeader(const u8 type, const size_t data_size) {
+            return static_cast<u32>(data_size << 8) | type;
+        }
+
+        inline void PushCompressionHeader(std::vector<u8> &enc, const u8 type, const size_t data_size) {
+            const auto header = MakeCompressionHeader(type, data_size);
+            enc.resize(sizeof(u32));
+            std::memcpy(enc.data(), &header, sizeof(u32));
+        }
+
+        inline void FinishCompression(const std::vector<u8> &enc, u8 *&out_data, size_t &out_size) {
+            out_size = AlignUp(enc.size(), sizeof(u32));
+            out_data = new u8[out_size]();
+            std::memcpy(out_data, enc.data(), enc.size());
+        }
+
+        Result ParseLzHeader(const u8 *data, const size_t data_size, LzVersion &out_ver, size_t &out_dec_size, size_t &out_offset) {
+            if(data_size < sizeof(u32)) {
+                TWL_R_FAIL(ResultCompressionInvalidLzData);
+            }
+
+            u32 lz_header;
+            std::memcpy(&lz_header, data, sizeof(u32));
+            out_offset = sizeof(u32);
+            TWL_R_TRY(LzValidateCompressed(lz_header, out_ver));
+
+            out_dec_size = lz_header >> 8;
+            if((out_dec_size == 0) && (out_ver == LzVersion::LZ11)) {
+                if(data_size < (2 * sizeof(u32))) {
+                    TWL_R_FAIL(ResultCompressionInvalidLzData);
+                }
+                u32 ext_size;
+                std::memcpy(&ext_size, data + out_offset, sizeof(u32));
+                out_dec_size = ext_size;
+                out_offset += sizeof(u32);
+            }
+
+            // Each byte of input can't produce more than what its best token produces (ignoring flags) per byte
+            if(out_dec_size > ((data_size - out_offset) * GetLzMaximumExpansion(out_ver))) {
+                TWL_R_FAIL(ResultCompressionInvalidLzData);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        // Longest stream any encoder produces for the given size (everything as literals), padded to 4 bytes
+        inline size_t GetLzMaximumStreamSize(const size_t header_size, const size_t dec_size) {
+            return AlignUp(header_size + dec_size + (dec_size + CHAR_BIT - 1) / CHAR_BIT, sizeof(u32));
+        }
+
+        // Probing only validates the stream (every read and back-reference) without producing any output
+        template<bool Probe>
+        Result LzDecodeStream(const u8 *data, const size_t data_size, size_t offset, const LzVersion ver, u8 *dec_data, const size_t dec_size, size_t &out_used_data_size) {
+            size_t out_offset = 0;
+            while(out_offset < dec_size) {
+                if(offset >= data_size) {
+                    TWL_R_FAIL(ResultCompressionInvalidLzData);
+                }
+                const auto flags = data[offset];
+                offset++;
+
+                // 8 literals in a row
+                if((flags == 0) && ((offset + 8) <= data_size) && ((out_offset + 8) <= dec_size)) {
+                    if constexpr(!Probe) {
+                        std::memcpy(dec_data + out_offset, data + offset, 8);
+                    }
+                    offset += 8;
+                    out_offset += 8;
+                    continue;
+                }
+
+                for(u32 i = 0; (i < 8) && (out_offset < dec_size); i++) {
+                    if(flags & (0x80 >> i)) {
+                        if((offset + 2) > data_size) {
+                            TWL_R_FAIL(ResultCompressionInvalidLzData);
+                        }
+                        const size_t byte_0 = data[offset];
+                        const size_t byte_1 = data[offset + 1];
+                        offset += 2;
+
+                        size_t len;
+                        size_t disp;
+                        if(ver == LzVersion::LZ10) {
+                            len = (byte_0 >> 4) + LzMinimumMatchSize;
+                            disp = ((byte_0 & 0xF) << 8) | byte_1;
+                        }
+                        else if((byte_0 >> 4) == 0) {
+                            if((offset + 1) > data_size) {
+                                TWL_R_FAIL(ResultCompressionInvalidLzData);
+                            }
+                            const size_t byte_2 = data[offset];
+                            offset++;
+
+                            len = (((byte_0 & 0xF) << 4) | (byte_1 >> 4)) + LZ11MediumMinimumLength;
+                            disp = ((byte_1 & 0xF) << 8) | byte_2;
+                        }
+                        else if((byte_0 >> 4) == 1) {
+                            if((offset + 2) > data_size) {
+                                TWL_R_FAIL(ResultCompressionInvalidLzData);
+                            }
+                            const size_t byte_2 = data[offset];
+                            const size_t byte_3 = data[offset + 1];
+                            offset += 2;
+
+                            len = (((byte_0 & 0xF) << 12) | (byte_1 << 4) | (byte_2 >> 4)) + LZ11LongMinimumLength;
+                            disp = ((byte_2 & 0xF) << 8) | byte_3;
+                        }
+                        else {
+                            len = (byte_0 >> 4) + 1;
+                            disp = ((byte_0 & 0xF) << 8) | byte_1;
+                        }
+
+                        const auto dist = disp + 1;
+                        if(dist > out_offset) {
+                            TWL_R_FAIL(ResultCompressionInvalidLzData);
+                        }
+
+                        // Like the hardware, stop right at the output size
+                        len = std::min(len, dec_size - out_offset);
+                        out_offset += len;
+                        if constexpr(Probe) {
+                            continue;
+                        }
+
+                        auto dst = dec_data + out_offset - len;
+                        if((dist >= 8) && (len <= 16) && ((out_offset - len + 16) <= dec_size)) {
+                            // Short matches (most of them): two fixed-size copies are cheaper than a variable one, writing past the match is fine since it gets overwritten later
+                            std::memcpy(dst, dst - dist, 8);
+                            std::memcpy(dst + 8, dst + 8 - dist, 8);
+                        }
+                        else if(dist == 1) {
+                            std::memset(dst, dst[-1], len);
+                        }
+                        else {
+                            // Copying dist bytes at a time never overlaps, and the pattern repeats every dist bytes anyway (a single copy if the match doesn't overlap itself)
+                            while(len > 0) {
+                                const auto copy_len = std::min(len, dist);
+                                std::memcpy(dst, dst - dist, copy_len);
+                                dst += copy_len;
+                                len -= copy_len;
+                            }
+                        }
+                    }
+                    else {
+                        if(offset >= data_size) {
+                            TWL_R_FAIL(ResultCompressionInvalidLzData);
+                        }
+                        if constexpr(!Probe) {
+                            dec_data[out_offset] = data[offset];
+                        }
+                        offset++;
+                        out_offset++;
+                    }
+                }
+            }
+
+            out_used_data_size = offset;
+            TWL_R_SUCCEED();
+        }
+
+        Result ParseHuffmanHeader(const u8 *data, const size_t data_size, HuffmanVersion &out_ver, size_t &out_dec_size, size_t &out_table_size) {
+            if(data_size < (sizeof(u32) + 1)) {
+                TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+            }
+
+            u32 huffman_header;
+            std::memcpy(&huffman_header, data, sizeof(u32));
+            TWL_R_TRY(HuffmanValidateCompressed(huffman_header, out_ver));
+
+            out_table_size = (static_cast<size_t>(data[sizeof(u32)]) + 1) * 2;
+            if((sizeof(u32) + out_table_size) > data_size) {
+                TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+            }
+
+            // Every symbol takes at least one bit
+            out_dec_size = huffman_header >> 8;
+            const auto word_count = (data_size - sizeof(u32) - out_table_size) / sizeof(u32);
+            if(out_dec_size > (word_count * sizeof(u32) * GetHuffmanSymbolBits(out_ver))) {
+                TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        // Codes can't be longer than the tree's internal node count, nor than the symbol count minus one
+        inline size_t GetHuffmanMaximumStreamSize(const HuffmanVersion ver, const size_t table_size, const size_t dec_size) {
+            const auto symbol_bits = GetHuffmanSymbolBits(ver);
+            const auto max_code_bits = std::max<size_t>(1, std::min<size_t>(table_size / 2, (1ul << symbol_bits) - 1));
+            const auto symbol_count = dec_size * CHAR_BIT / symbol_bits;
+            return sizeof(u32) + table_size + AlignUp(symbol_count * max_code_bits, sizeof(u32) * CHAR_BIT) / CHAR_BIT;
+        }
+
+        // Like LZ probing, this only validates the stream without producing any output
+        template<bool Probe>
+        Result HuffmanDecodeStream(const u8 *data, const size_t data_size, const HuffmanVersion ver, const size_t table_size, u8 *dec_data, const size_t dec_size, size_t &out_used_data_size) {
+            const auto table = data + sizeof(u32);
+            const auto stream_offset = sizeof(u32) + table_size;
+            const auto word_count = (data_size - stream_offset) / sizeof(u32);
+            const auto symbol_bits = GetHuffmanSymbolBits(ver);
+
+            std::vector<HuffmanLookupEntry> lookup;
+            BuildHuffmanLookup(table, table_size, lookup);
+
+            // Bits are kept left-aligned, with words past the end reading as zeros (checked against the actual bit count at the end)
+            const auto stream = data + stream_offset;
+            size_t word_idx = 0;
+            u64 bit_buf = 0;
+            size_t bit_buf_count = 0;
+            size_t consumed_bits = 0;
+            auto refill = [&]() {
+                while(bit_buf_count <= 32) {
+                    u32 word = 0;
+                    if(word_idx < word_count) {
+                        std::memcpy(&word, stream + word_idx * sizeof(u32), sizeof(u32));
+                    }
+                    word_idx++;
+                    bit_buf |= static_cast<u64>(word) << (32 - bit_buf_count);
+                    bit_buf_count += 32;
+                }
+            };
+            auto consume = [&](const size_t bit_count) {
+                bit_buf <<= bit_count;
+                bit_buf_count -= bit_count;
+                consumed_bits += bit_count;
+            };
+
+            const auto symbol_count = dec_size * CHAR_BIT / symbol_bits;
+            auto put_symbol = [&](const size_t idx, const u8 symbol) {
+                if constexpr(!Probe) {
+                    if(ver == HuffmanVersion::Huffman8) {
+                        dec_data[idx] = symbol;
+                    }
+                    else {
+                        dec_data[idx / 2] |= (symbol & 0xF) << ((idx & 1) * 4);
+                    }
+                }
+            };
+
+            const auto total_bits = word_count * sizeof(u32) * CHAR_BIT;
+            size_t symbol_idx = 0;
+            while(symbol_idx < symbol_count) {
+                if(consumed_bits > total_bits) {
+                    TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+                }
+                refill();
+
+                const auto &entry = lookup[bit_buf >> (64 - HuffmanLookupBits)];
+                if(entry.symbol_count > 0) {
+                    const auto count = std::min(static_cast<size_t>(entry.symbol_count), symbol_count - symbol_idx);
+                    for(size_t i = 0; i < count; i++) {
+                        put_symbol(symbol_idx + i, entry.symbols[i]);
+                    }
+                    symbol_idx += count;
+                    consume(entry.bit_counts[count - 1]);
+                }
+                else {
+                    // Node addresses always grow, thus this can't take more steps than the table size
+                    auto addr = HuffmanRootAddress;
+                    while(true) {
+                        if(bit_buf_count == 0) {
+                            refill();
+                        }
+                        const u32 bit = bit_buf >> 63;
+                        consume(1);
+
+                        size_t child_addr;
+                        bool is_symbol;
+                        if(!GetHuffmanChild(table, table_size, addr, bit, child_addr, is_symbol)) {
+                            TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+                        }
+                        if(is_symbol) {
+                            put_symbol(symbol_idx, table[child_addr]);
+                            symbol_idx++;
+                            break;
+                        }
+                        addr = child_addr;
+                    }
+                }
+            }
+            if(consumed_bits > total_bits) {
+                TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+            }
+
+            out_used_data_size = stream_offset + AlignUp(consumed_bits, sizeof(u32) * CHAR_BIT) / CHAR_BIT;
+            TWL_R_SUCCEED();
+        }
+
+        Result ParseRleHeader(const u8 *data, const size_t data_size, size_t &out_dec_size) {
+            if(data_size < sizeof(u32)) {
+                TWL_R_FAIL(ResultCompressionInvalidRleData);
+            }
+
+            u32 rle_header;
+            std::memcpy(&rle_header, data, sizeof(u32));
+            TWL_R_TRY(RleValidateCompressed(rle_header));
+
+            // Runs are the best case, 2 bytes for the longest one
+            out_dec_size = rle_header >> 8;
+            if(out_dec_size > (((data_size - sizeof(u32)) / 2) * RleMaximumRunSize + 1)) {
+                TWL_R_FAIL(ResultCompressionInvalidRleData);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        // Longest stream any encoder produces for the given size (everything as literal blocks), padded to 4 bytes
+        inline size_t GetRleMaximumStreamSize(const size_t dec_size) {
+            return AlignUp(sizeof(u32) + dec_size + (dec_size + RleMaximumLiteralSize - 1) / RleMaximumLiteralSize, sizeof(u32));
+        }
+
+        template<bool Probe>
+        Result RleDecodeStream(const u8 *data, const size_t data_size, u8 *dec_data, const size_t dec_size, size_t &out_used_data_size) {
+            size_t offset = sizeof(u32);
+            size_t out_offset = 0;
+            while(out_offset < dec_size) {
+                if(offset >= data_size) {
+                    TWL_R_FAIL(ResultCompressionInvalidRleData);
+                }
+                const auto flag = data[offset];
+                offset++;
+
+                // Like the hardware, stop right at the output size
+                if(flag & RleRunFlag) {
+                    if(offset >= data_size) {
+                        TWL_R_FAIL(ResultCompressionInvalidRleData);
+                    }
+                    const auto len = std::min((flag & ~RleRunFlag) + RleMinimumRunSize, dec_size - out_offset);
+                    if constexpr(!Probe) {
+                        std::memset(dec_data + out_offset, data[offset], len);
+                    }
+                    offset++;
+                    out_offset += len;
+                }
+                else {
+                    const size_t len = flag + 1;
+                    if((offset + len) > data_size) {
+                        TWL_R_FAIL(ResultCompressionInvalidRleData);
+                    }
+                    const auto copy_len = std::min(len, dec_size - out_offset);
+                    if constexpr(!Probe) {
+                        std::memcpy(dec_data + out_offset, data + offset, copy_len);
+                    }
+                    offset += len;
+                    out_offset += copy_len;
+                }
+            }
+
+            out_used_data_size = offset;
+            TWL_R_SUCCEED();
+        }
     }
 
     Result LzValidateCompressed(const u32 lz_header, LzVersion &out_ver) {
@@ -49,141 +1105,480 @@ namespace twl::util {
         TWL_R_SUCCEED();
     }
 
-    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const u32 repeat_size, u8 *&out_data, size_t &out_size) {
-        if(ver != LzVersion::LZ10) {
+    Result LzCompress(const u8 *data, const size_t data_size, const LzVersion ver, const LzCompressOptions &opts, u8 *&out_data, size_t &out_size) {
+        if((ver != LzVersion::LZ10) && (ver != LzVersion::LZ11)) {
             TWL_R_FAIL(ResultCompressionInvalidLzFormat);
         }
+        const auto repeat_size = (opts.repeat_size != 0) ? opts.repeat_size : GetLzMaximumRepeatSize(ver);
+        if((repeat_size < LzMinimumMatchSize) || (repeat_size > GetLzMaximumRepeatSize(ver))) {
+            TWL_R_FAIL(ResultCompressionInvalidRepeatSize);
+        }
+        if(data_size >= ((ver == LzVersion::LZ10) ? MaximumLZ10CompressSize : MaximumLZ11CompressSize)) {
+            TWL_R_FAIL(ResultCompressionTooBigCompressSize);
+        }
+        if((opts.level != LzCompressLevel::Fast) && (opts.level != LzCompressLevel::Lazy) && (opts.level != LzCompressLevel::Optimal)) {
+            TWL_R_FAIL(ResultCompressionInvalidLzLevel);
+        }
+        const auto max_chain_depth = (opts.max_chain_depth != 0) ? opts.max_chain_depth : GetLzDefaultMaximumChainDepth(opts.level);
 
-        const auto tmp_data_size = 2 * data_size + 4;
-        auto tmp_array = new u8[tmp_data_size]();
-        *(u32*)tmp_array = static_cast<u32>(data_size << 8 | 16);
-        size_t offset = sizeof(u32);
-        u8 array[16] = {};
-        size_t i = 0;
-        while (i < data_size)
-        {
-            size_t num = 0;
-            u8 b = 0;
-            for (int j = 0; j < 8; j++)
-            {
-                if (i >= data_size)
-                {
-                    array[num++] = 0;
-                }
-                else
-                {
-                    size_t num2 = 0;
-                    size_t num3 = 0;
-                    Lz10CompressSearch(data, data_size, i, num2, num3);
-                    size_t num4 = i - num2 - 1;
-                    if (num3 > 2)
-                    {
-                        b |= (u8)(1 << (7 - j));
-                        array[num++] = (u8)((((num3 - 3) & 15) << 4) + (num4 >> 8 & 15));
-                        array[num++] = (u8)(num4 & 255);
-                        i += num3;
-                    }
-                    else
-                    {
-                        array[num++] = data[i++];
-                    }
-                }
-            }
-            tmp_array[offset] = b;
-            offset++;
-            for (size_t k = 0; k < num; k++)
-            {
-                tmp_array[offset] = array[k];
-                offset++;
+        // The thread count never changes the output, thus it's not part of the key
+        CompressionCache::Key cache_key;
+        if(opts.cache != nullptr) {
+            cache_key = CompressionCache::MakeKey(data, data_size, static_cast<u8>(ver), static_cast<u8>(opts.level), repeat_size, max_chain_depth);
+            if(opts.cache->Find(cache_key, out_data, out_size)) {
+                TWL_R_SUCCEED();
             }
         }
 
-        out_data = new u8[offset]();
-        out_size = offset;
-        std::memcpy(out_data, tmp_array, offset);
-        delete[] tmp_array;
+        std::vector<u8> enc;
+        enc.reserve(2 * sizeof(u32) + data_size + (data_size + 7) / 8);
+
+        // LZ11 sizes not fitting in the header go right after it (a zero size in the header means that, thus empty data is stored that way too)
+        const auto size_in_header = (data_size < MaximumLZ10CompressSize) && ((ver == LzVersion::LZ10) || (data_size > 0));
+        const u32 lz_header = ((size_in_header ? data_size : 0) << 8) | static_cast<u32>(ver);
+        enc.resize(sizeof(u32));
+        std::memcpy(enc.data(), &lz_header, sizeof(u32));
+        if(!size_in_header) {
+            const u32 ext_size = data_size;
+            enc.resize(2 * sizeof(u32));
+            std::memcpy(enc.data() + sizeof(u32), &ext_size, sizeof(u32));
+        }
+
+        // Greedy parsing always takes the longest match anyway
+        const auto nice_len = (opts.level == LzCompressLevel::Fast) ? repeat_size : LzNiceMatchSize;
+        const auto thread_count = (opts.thread_count != 0) ? opts.thread_count : GetDefaultThreadCount();
 
+        LzTokenWriter writer(ver, enc);
+        if((thread_count > 1) && (data_size >= LzParallelMinimumSize)) {
+            LzEncodeParallel(opts.level, data, data_size, ver, repeat_size, nice_len, max_chain_depth, thread_count, writer);
+        }
+        else {
+            LzMatchFinder finder(data, data_size, repeat_size, nice_len, max_chain_depth);
+            LzEncode(opts.level, data, data_size, ver, finder, writer);
+        }
+
+        FinishCompression(enc, out_data, out_size);
+        if(opts.cache != nullptr) {
+            opts.cache->Store(cache_key, out_data, out_size);
+        }
         TWL_R_SUCCEED();
     }
 
-    Result LzDecompress(const u8 *data, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size) {
-        size_t offset = 0;
-        const auto lz_header = *reinterpret_cast<const u32*>(data);
-        offset += sizeof(u32);
+    Result LzProbeCompressedHeader(const u8 *header, const size_t data_size, LzVersion &out_ver, size_t &out_decomp_size) {
+        LzVersion ver;
+        size_t dec_size;
+        size_t offset;
+        TWL_R_TRY(ParseLzHeader(header, data_size, ver, dec_size, offset));
+        if(data_size > GetLzMaximumStreamSize(offset, dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidLzData);
+        }
 
+        out_ver = ver;
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result LzProbeCompressed(const u8 *data, const size_t data_size, LzVersion &out_ver, size_t &out_decomp_size) {
         LzVersion ver;
-        TWL_R_TRY(LzValidateCompressed(lz_header, ver));
+        size_t dec_size;
+        size_t offset;
+        TWL_R_TRY(ParseLzHeader(data, data_size, ver, dec_size, offset));
+        if(data_size > GetLzMaximumStreamSize(offset, dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidLzData);
+        }
+
+        size_t used_data_size;
+        TWL_R_TRY(LzDecodeStream<true>(data, data_size, offset, ver, nullptr, dec_size, used_data_size));
+
+        // Encoders only pad the output up to 4 bytes
+        if(AlignUp(used_data_size, sizeof(u32)) < data_size) {
+            TWL_R_FAIL(ResultCompressionInvalidLzData);
+        }
 
-        out_size = lz_header >> 8;
         out_ver = ver;
-        if((out_size == 0) && (ver == LzVersion::LZ11)) {
-            out_size = *reinterpret_cast<const u32*>(data + offset);
-            offset += sizeof(u32);
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result LzDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size, LzVersion &out_ver, size_t &out_used_data_size) {
+        LzVersion ver;
+        size_t dec_size;
+        size_t offset;
+        TWL_R_TRY(ParseLzHeader(data, data_size, ver, dec_size, offset));
+        if(dec_size > max_out_size) {
+            TWL_R_FAIL(ResultCompressionOutputTooBig);
         }
-        out_data = new u8[out_size]();
 
-        size_t out_offset = 0;
-        while(out_offset < out_size) {
-            const auto cur_byte = data[offset];
-            offset++;
+        auto dec_data = new u8[dec_size];
+        ScopeGuard on_fail([&]() {
+            delete[] dec_data;
+        });
 
-            for(u8 i = 0; i < 8; i++) {
-                if(out_offset >= out_size) {
-                    break;
-                }
+        TWL_R_TRY(LzDecodeStream<false>(data, data_size, offset, ver, dec_data, dec_size, out_used_data_size));
 
-                const auto bit = 8 - (i + 1);
-                if((cur_byte >> bit) & 1) {
-                    const size_t msb_len = data[offset];
-                    offset++;
-                    const size_t lsb = data[offset]; // 4 bits (length) + 12 bits (disp)
-                    offset++;
+        on_fail.Cancel();
+        out_data = dec_data;
+        out_size = dec_size;
+        out_ver = ver;
+        TWL_R_SUCCEED();
+    }
 
-                    auto length = msb_len >> 4; // 4 high bits
-                    auto disp = ((msb_len & 0xF) << 8) + lsb; // 4 low bits * 0x100 + lsb
+    Result HuffmanValidateCompressed(const u32 huffman_header, HuffmanVersion &out_ver) {
+        out_ver = static_cast<HuffmanVersion>(huffman_header & 0xff);
+        if((out_ver != HuffmanVersion::Huffman4) && (out_ver != HuffmanVersion::Huffman8)) {
+            TWL_R_FAIL(ResultCompressionInvalidHuffmanFormat);
+        }
 
-                    if(ver == LzVersion::LZ10) {
-                        length += 3;
-                    }
-                    else if(length > 1) {
-                        length++;
-                    }
-                    else if(length == 0) {
-                        length = (msb_len & 15) << 4;
-                        length += lsb >> 4;
-                        length += 0x11;
-                        const size_t msb = data[offset];
-                        offset++;
-                        disp = ((lsb & 15) << 8) + msb;
+        TWL_R_SUCCEED();
+    }
+
+    Result HuffmanCompress(const u8 *data, const size_t data_size, const HuffmanVersion ver, u8 *&out_data, size_t &out_size, CompressionCache *cache) {
+        if((ver != HuffmanVersion::Huffman4) && (ver != HuffmanVersion::Huffman8)) {
+            TWL_R_FAIL(ResultCompressionInvalidHuffmanFormat);
+        }
+        if(data_size >= MaximumHuffmanCompressSize) {
+            TWL_R_FAIL(ResultCompressionTooBigCompressSize);
+        }
+
+        CompressionCache::Key cache_key;
+        if(cache != nullptr) {
+            cache_key = CompressionCache::MakeKey(data, data_size, static_cast<u8>(ver));
+            if(cache->Find(cache_key, out_data, out_size)) {
+                TWL_R_SUCCEED();
+            }
+        }
+
+        const auto symbol_bits = GetHuffmanSymbolBits(ver);
+        const auto symbol_count = data_size * CHAR_BIT / symbol_bits;
+        auto get_symbol = [&](const size_t idx) -> u8 {
+            if(ver == HuffmanVersion::Huffman8) {
+                return data[idx];
+            }
+            else {
+                return (data[idx / 2] >> ((idx & 1) * 4)) & 0xF;
+            }
+        };
+
+        std::vector<size_t> freqs(1ul << symbol_bits, 0);
+        for(size_t i = 0; i < symbol_count; i++) {
+            freqs[get_symbol(i)]++;
+        }
+
+        std::vector<HuffmanNode> nodes;
+        BuildHuffmanTree(freqs, nodes);
+        const auto root_idx = nodes.size() - 1;
+
+        std::vector<u8> table;
+        if(!LayoutHuffmanTree(nodes, root_idx, table)) {
+            TWL_R_FAIL(ResultCompressionHuffmanTreeLayoutFailed);
+        }
+        table.resize(AlignUp(table.size(), sizeof(u32)), 0);
+        table.at(0) = static_cast<u8>(table.size() / 2 - 1);
+
+        std::vector<HuffmanCode> codes(freqs.size());
+        GetHuffmanCodes(nodes, root_idx, { 0, 0 }, codes);
+
+        std::vector<u8> enc;
+        enc.reserve(sizeof(u32) + table.size() + data_size + sizeof(u32));
+        PushCompressionHeader(enc, static_cast<u8>(ver), data_size);
+        enc.insert(enc.end(), table.begin(), table.end());
+
+        HuffmanBitWriter writer(enc);
+        for(size_t i = 0; i < symbol_count; i++) {
+            const auto &code = codes[get_symbol(i)];
+            writer.PushBits(code.bits, code.len);
+        }
+        writer.Flush();
+
+        FinishCompression(enc, out_data, out_size);
+        if(cache != nullptr) {
+            cache->Store(cache_key, out_data, out_size);
+        }
+        TWL_R_SUCCEED();
+    }
+
+    Result HuffmanProbeCompressedHeader(const u8 *header, const size_t data_size, HuffmanVersion &out_ver, size_t &out_decomp_size) {
+        HuffmanVersion ver;
+        size_t dec_size;
+        size_t table_size;
+        TWL_R_TRY(ParseHuffmanHeader(header, data_size, ver, dec_size, table_size));
+        if(data_size > GetHuffmanMaximumStreamSize(ver, table_size, dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+        }
+
+        out_ver = ver;
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result HuffmanProbeCompressed(const u8 *data, const size_t data_size, HuffmanVersion &out_ver, size_t &out_decomp_size) {
+        HuffmanVersion ver;
+        size_t dec_size;
+        size_t table_size;
+        TWL_R_TRY(ParseHuffmanHeader(data, data_size, ver, dec_size, table_size));
+        if(data_size > GetHuffmanMaximumStreamSize(ver, table_size, dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+        }
+
+        size_t used_data_size;
+        TWL_R_TRY(HuffmanDecodeStream<true>(data, data_size, ver, table_size, nullptr, dec_size, used_data_size));
+        if(AlignUp(used_data_size, sizeof(u32)) < data_size) {
+            TWL_R_FAIL(ResultCompressionInvalidHuffmanData);
+        }
+
+        out_ver = ver;
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result HuffmanDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size, HuffmanVersion &out_ver) {
+        HuffmanVersion ver;
+        size_t dec_size;
+        size_t table_size;
+        TWL_R_TRY(ParseHuffmanHeader(data, data_size, ver, dec_size, table_size));
+        if(dec_size > max_out_size) {
+            TWL_R_FAIL(ResultCompressionOutputTooBig);
+        }
+
+        auto dec_data = new u8[dec_size]();
+        ScopeGuard on_fail([&]() {
+            delete[] dec_data;
+        });
+
+        size_t used_data_size;
+        TWL_R_TRY(HuffmanDecodeStream<false>(data, data_size, ver, table_size, dec_data, dec_size, used_data_size));
+
+        on_fail.Cancel();
+        out_data = dec_data;
+        out_size = dec_size;
+        out_ver = ver;
+        TWL_R_SUCCEED();
+    }
+
+    Result RleValidateCompressed(const u32 rle_header) {
+        if((rle_header & 0xff) != RleCompressionType) {
+            TWL_R_FAIL(ResultCompressionInvalidRleFormat);
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    Result RleCompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size, CompressionCache *cache) {
+        if(data_size >= MaximumRleCompressSize) {
+            TWL_R_FAIL(ResultCompressionTooBigCompressSize);
+        }
+
+        CompressionCache::Key cache_key;
+        if(cache != nullptr) {
+            cache_key = CompressionCache::MakeKey(data, data_size, RleCompressionType);
+            if(cache->Find(cache_key, out_data, out_size)) {
+                TWL_R_SUCCEED();
+            }
+        }
+
+        std::vector<u8> enc;
+        enc.reserve(sizeof(u32) + data_size + data_size / RleMaximumLiteralSize + 1);
+        PushCompressionHeader(enc, RleCompressionType, data_size);
+
+        auto push_literals = [&](const size_t start, const size_t end) {
+            for(auto offset = start; offset < end; offset += RleMaximumLiteralSize) {
+                const auto len = std::min(end - offset, RleMaximumLiteralSize);
+                enc.push_back(static_cast<u8>(len - 1));
+                enc.insert(enc.end(), data + offset, data + offset + len);
+            }
+        };
+
+        size_t literal_start = 0;
+        size_t pos = 0;
+        while(pos < data_size) {
+            const auto max_run = std::min(RleMaximumRunSize, data_size - pos);
+            size_t run = 1;
+            while((run < max_run) && (data[pos + run] == data[pos])) {
+                run++;
+            }
+
+            if(run >= RleMinimumRunSize) {
+                push_literals(literal_start, pos);
+                enc.push_back(RleRunFlag | static_cast<u8>(run - RleMinimumRunSize));
+                enc.push_back(data[pos]);
+                pos += run;
+                literal_start = pos;
+            }
+            else {
+                pos++;
+            }
+        }
+        push_literals(literal_start, data_size);
+
+        FinishCompression(enc, out_data, out_size);
+        if(cache != nullptr) {
+            cache->Store(cache_key, out_data, out_size);
+        }
+        TWL_R_SUCCEED();
+    }
+
+    Result RleProbeCompressedHeader(const u8 *header, const size_t data_size, size_t &out_decomp_size) {
+        size_t dec_size;
+        TWL_R_TRY(ParseRleHeader(header, data_size, dec_size));
+        if(data_size > GetRleMaximumStreamSize(dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidRleData);
+        }
+
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result RleProbeCompressed(const u8 *data, const size_t data_size, size_t &out_decomp_size) {
+        size_t dec_size;
+        TWL_R_TRY(ParseRleHeader(data, data_size, dec_size));
+        if(data_size > GetRleMaximumStreamSize(dec_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidRleData);
+        }
+
+        size_t used_data_size;
+        TWL_R_TRY(RleDecodeStream<true>(data, data_size, nullptr, dec_size, used_data_size));
+        if(AlignUp(used_data_size, sizeof(u32)) < data_size) {
+            TWL_R_FAIL(ResultCompressionInvalidRleData);
+        }
+
+        out_decomp_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result RleDecompress(const u8 *data, const size_t data_size, const size_t max_out_size, u8 *&out_data, size_t &out_size) {
+        size_t dec_size;
+        TWL_R_TRY(ParseRleHeader(data, data_size, dec_size));
+        if(dec_size > max_out_size) {
+            TWL_R_FAIL(ResultCompressionOutputTooBig);
+        }
+
+        auto dec_data = new u8[dec_size];
+        ScopeGuard on_fail([&]() {
+            delete[] dec_data;
+        });
+
+        size_t used_data_size;
+        TWL_R_TRY(RleDecodeStream<false>(data, data_size, dec_data, dec_size, used_data_size));
+
+        on_fail.Cancel();
+        out_data = dec_data;
+        out_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result BlzDecompress(const u8 *data, const size_t data_size, u8 *&out_data, size_t &out_size) {
+        if(data_size < sizeof(u32)) {
+            TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+        }
+
+        u32 inc_size;
+        std::memcpy(&inc_size, data + data_size - sizeof(u32), sizeof(u32));
+        if(inc_size == 0) {
+            // Stored uncompressed, just followed by the empty size increase
+            out_size = data_size - sizeof(u32);
+            out_data = new u8[out_size]();
+            std::memcpy(out_data, data, out_size);
+            TWL_R_SUCCEED();
+        }
+
+        if(data_size < BlzFooterSize) {
+            TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+        }
+
+        u32 enc_size_and_hdr_size;
+        std::memcpy(&enc_size_and_hdr_size, data + data_size - BlzFooterSize, sizeof(u32));
+        const size_t hdr_size = enc_size_and_hdr_size >> 24;
+        const size_t enc_size = enc_size_and_hdr_size & 0xFFFFFF;
+        if((hdr_size < BlzMinimumHeaderSize) || (hdr_size > BlzMaximumHeaderSize) || (enc_size < hdr_size) || (enc_size > data_size)) {
+            TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+        }
+
+        const auto raw_size = data_size - enc_size;
+        const auto dec_size = data_size + inc_size;
+        auto dec_data = new u8[dec_size]();
+        ScopeGuard on_fail([&]() {
+            delete[] dec_data;
+        });
+        std::memcpy(dec_data, data, raw_size);
+
+        auto in_offset = data_size - hdr_size;
+        auto out_offset = dec_size;
+        while(out_offset > raw_size) {
+            if(in_offset <= raw_size) {
+                TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+            }
+            const auto flags = data[--in_offset];
+
+            for(u32 i = 0; (i < 8) && (out_offset > raw_size); i++) {
+                if(flags & (0x80 >> i)) {
+                    if((in_offset - raw_size) < 2) {
+                        TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
                     }
-                    else {
-                        length = (msb_len & 15) << 12;
-                        length += lsb << 4;
-                        const size_t byte_1 = data[offset];
-                        offset++;
-                        const size_t byte_2 = data[offset];
-                        offset++;
-                        length += byte_1 >> 4;
-                        length += 0x111;
-                        disp = ((byte_1 & 15) << 8) + byte_2;
+                    const size_t val = (data[in_offset - 1] << 8) | data[in_offset - 2];
+                    in_offset -= 2;
+
+                    const auto len = std::min((val >> 12) + BlzMinimumMatchSize, out_offset - raw_size);
+                    const auto dist = (val & 0xFFF) + BlzMinimumDistance;
+                    if((out_offset + dist) > dec_size) {
+                        TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
                     }
 
-                    const auto start_offset = out_offset - disp - 1;
-                    for(size_t j = 0; j < length; j++) {
-                        const auto val = out_data[start_offset + j];
-                        out_data[out_offset] = val;
-                        out_offset++;
+                    for(size_t j = 0; j < len; j++) {
+                        out_offset--;
+                        dec_data[out_offset] = dec_data[out_offset + dist];
                     }
                 }
                 else {
-                    out_data[out_offset] = data[offset];
-                    offset++;
-                    out_offset++;
+                    if(in_offset <= raw_size) {
+                        TWL_R_FAIL(ResultCompressionInvalidBlzFormat);
+                    }
+                    dec_data[--out_offset] = data[--in_offset];
                 }
             }
         }
 
-        out_used_data_size = offset;
+        on_fail.Cancel();
+        out_data = dec_data;
+        out_size = dec_size;
+        TWL_R_SUCCEED();
+    }
+
+    Result BlzCompress(const u8 *data, const size_t data_size, const size_t raw_head_size, u8 *&out_data, size_t &out_size) {
+        std::vector<u8> rev_data(data, data + data_size);
+        std::reverse(rev_data.begin(), rev_data.end());
+
+        const auto enc_size = data_size - std::min(raw_head_size, data_size);
+        std::vector<u8> enc;
+        size_t best_enc_size;
+        size_t best_raw_size;
+        BlzEncodeReversed(rev_data.data(), data_size, enc_size, enc, best_enc_size, best_raw_size);
+
+        const auto comp_data_size = AlignUp(best_raw_size + best_enc_size, sizeof(u32));
+        if((best_enc_size == 0) || ((comp_data_size + BlzFooterSize) >= data_size)) {
+            // Not worth compressing, store it as-is followed by an empty size increase (no padding, since decoding gives back everything before it)
+            out_size = data_size + sizeof(u32);
+            out_data = new u8[out_size]();
+            if(data_size > 0) {
+                std::memcpy(out_data, data, data_size);
+            }
+            TWL_R_SUCCEED();
+        }
+
+        const auto hdr_size = BlzFooterSize + (comp_data_size - (best_raw_size + best_enc_size));
+        if((best_enc_size + hdr_size) > 0xFFFFFF) {
+            TWL_R_FAIL(ResultCompressionTooBigCompressSize);
+        }
+
+        out_size = comp_data_size + BlzFooterSize;
+        out_data = new u8[out_size];
+        std::memcpy(out_data, data, best_raw_size);
+        std::reverse_copy(enc.begin(), enc.begin() + best_enc_size, out_data + best_raw_size);
+        std::memset(out_data + best_raw_size + best_enc_size, 0xFF, comp_data_size - (best_raw_size + best_enc_size));
+
+        const u32 enc_size_and_hdr_size = (best_enc_size + hdr_size) | (hdr_size << 24);
+        const u32 inc_size = data_size - out_size;
+        std::memcpy(out_data + comp_data_size, &enc_size_and_hdr_size, sizeof(u32));
+        std::memcpy(out_data + comp_data_size + sizeof(u32), &inc_size, sizeof(u32));
         TWL_R_SUCCEED();
     }
 
@@ -0,0 +1,183 @@
+#include <twl/util/util_CompressionCache.hpp>
+#include <twl/fs/fs_File.hpp>
+#include <filesystem>
+#include <cstring>
+#include <random>
+
+namespace twl::util {
+
+    namespace {
+
+        struct CacheEntryHeader {
+            u32 magic;
+            u32 version;
+            u64 comp_size;
+            u64 comp_hash;
+        };
+
+        inline void AppendHex(std::string &str, const u8 *data, const size_t data_size) {
+            constexpr char HexDigits[] = "0123456789abcdef";
+            for(size_t i = 0; i < data_size; i++) {
+                str.push_back(HexDigits[data[i] >> 4]);
+                str.push_back(HexDigits[data[i] & 0xF]);
+            }
+        }
+
+        template<typename T>
+        inline void AppendHex(std::string &str, const T val) {
+            u8 val_be[sizeof(T)];
+            for(size_t i = 0; i < sizeof(T); i++) {
+                val_be[i] = static_cast<u8>(val >> ((sizeof(T) - 1 - i) * CHAR_BIT));
+            }
+            AppendHex(str, val_be, sizeof(T));
+        }
+
+        Result ReadEntry(const std::string &entry_path, std::vector<u8> &out_comp_data) {
+            fs::StdioFile entry_file(entry_path);
+            TWL_R_TRY(entry_file.OpenRead(fs::FileCompression::None));
+            ScopeGuard close_file([&]() {
+                entry_file.Close();
+            });
+
+            CacheEntryHeader header;
+            TWL_R_TRY(entry_file.Read(header));
+            if((header.magic != CompressionCache::EntryMagic) || (header.version != CompressionCache::EntryVersion)) {
+                TWL_R_FAIL(ResultUnableToReadFile);
+            }
+
+            size_t entry_size;
+            TWL_R_TRY(entry_file.GetSize(entry_size));
+            if(header.comp_size != (entry_size - sizeof(header))) {
+                TWL_R_FAIL(ResultUnableToReadFile);
+            }
+
+            out_comp_data.resize(header.comp_size);
+            TWL_R_TRY(entry_file.ReadBuffer(out_comp_data.data(), out_comp_data.size()));
+            if(ComputeXxHash64(out_comp_data.data(), out_comp_data.size()) != header.comp_hash) {
+                TWL_R_FAIL(ResultUnableToReadFile);
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+        // Written to a temporary file first, so that concurrent builds sharing the directory never see a half-written entry
+        Result WriteEntry(const std::string &entry_path, const u8 *comp_data, const size_t comp_size) {
+            std::error_code ec;
+            std::filesystem::create_directories(std::filesystem::path(entry_path).parent_path(), ec);
+            if(ec) {
+                TWL_R_FAIL(ResultUnableToWriteFile);
+            }
+
+            const auto tmp_entry_path = entry_path + ".tmp" + std::to_string(std::random_device()());
+            fs::StdioFile entry_file(tmp_entry_path);
+            TWL_R_TRY(entry_file.OpenWrite(fs::FileCompression::None));
+            ScopeGuard on_failure([&]() {
+                entry_file.Close();
+                std::error_code ec;
+                std::filesystem::remove(tmp_entry_path, ec);
+            });
+
+            const CacheEntryHeader header = {
+                .magic = CompressionCache::EntryMagic,
+                .version = CompressionCache::EntryVersion,
+                .comp_size = comp_size,
+                .comp_hash = ComputeXxHash64(comp_data, comp_size)
+            };
+            TWL_R_TRY(entry_file.Write(header));
+            TWL_R_TRY(entry_file.WriteBuffer(comp_data, comp_size));
+            TWL_R_TRY(entry_file.Close());
+
+            std::filesystem::rename(tmp_entry_path, entry_path, ec);
+            if(ec) {
+                TWL_R_FAIL(ResultUnableToWriteFile);
+            }
+
+            on_failure.Cancel();
+            TWL_R_SUCCEED();
+        }
+
+    }
+
+    std::string CompressionCache::Key::ToString() const {
+        std::string str;
+        str.reserve(2 * (this->data_hash.size() + 2 * sizeof(u8) + 2 * sizeof(u32)));
+        AppendHex(str, this->data_hash.data(), this->data_hash.size());
+        AppendHex(str, this->comp_type);
+        AppendHex(str, this->level);
+        AppendHex(str, this->repeat_size);
+        AppendHex(str, this->max_chain_depth);
+        return str;
+    }
+
+    void CompressionCache::StoreInMemory(const std::string &key_str, std::vector<u8> &&comp_data) {
+        const auto comp_size = comp_data.size();
+        if(!this->mem_entries.emplace(key_str, std::move(comp_data)).second) {
+            return;
+        }
+        this->mem_entry_order.push_back(key_str);
+        this->mem_size += comp_size;
+
+        while((this->mem_size > this->max_mem_size) && !this->mem_entry_order.empty()) {
+            const auto it = this->mem_entries.find(this->mem_entry_order.front());
+            this->mem_size -= it->second.size();
+            this->mem_entries.erase(it);
+            this->mem_entry_order.pop_front();
+        }
+    }
+
+    bool CompressionCache::Find(const Key &key, u8 *&out_comp_data, size_t &out_comp_size) {
+        const auto key_str = key.ToString();
+        std::vector<u8> comp_data;
+        {
+            std::scoped_lock lk(this->lock);
+            const auto it = this->mem_entries.find(key_str);
+            if(it != this->mem_entries.end()) {
+                comp_data = it->second;
+            }
+        }
+
+        // Entries are sharded in subdirectories by their first key byte, which keeps directories small
+        if(comp_data.empty() && !this->dir_path.empty()) {
+            const auto entry_path = std::filesystem::path(this->dir_path) / key_str.substr(0, 2) / key_str.substr(2);
+            if(ReadEntry(entry_path.string(), comp_data).IsFailure() || comp_data.empty()) {
+                this->miss_count++;
+                return false;
+            }
+
+            std::scoped_lock lk(this->lock);
+            this->StoreInMemory(key_str, std::vector<u8>(comp_data));
+        }
+
+        if(comp_data.empty()) {
+            this->miss_count++;
+            return false;
+        }
+
+        out_comp_size = comp_data.size();
+        out_comp_data = new u8[out_comp_size];
+        std::memcpy(out_comp_data, comp_data.data(), out_comp_size);
+        this->hit_count++;
+        return true;
+    }
+
+    void CompressionCache::Store(const Key &key, const u8 *comp_data, const size_t comp_size) {
+        const auto key_str = key.ToString();
+        {
+            std::scoped_lock lk(this->lock);
+            this->StoreInMemory(key_str, std::vector<u8>(comp_data, comp_data + comp_size));
+        }
+
+        if(!this->dir_path.empty()) {
+            const auto entry_path = std::filesystem::path(this->dir_path) / key_str.substr(0, 2) / key_str.substr(2);
+            WriteEntry(entry_path.string(), comp_data, comp_size);
+        }
+    }
+
+    void CompressionCache::ClearMemory() {
+        std::scoped_lock lk(this->lock);
+        this->mem_entries.clear();
+        this->mem_entry_order.clear();
+        this->mem_size = 0;
+    }
+
+}
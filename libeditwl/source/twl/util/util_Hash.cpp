@@ -0,0 +1,610 @@
+#include <twl/util/util_Hash.hpp>
+#include <twl/util/util_Thread.hpp>
+#include <cstring>
+#include <array>
+#include <algorithm>
+
+namespace twl::util {
+
+    namespace {
+
+        constexpr u64 XxHash64Prime1 = 0x9E3779B185EBCA87ull;
+        constexpr u64 XxHash64Prime2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr u64 XxHash64Prime3 = 0x165667B19E3779F9ull;
+        constexpr u64 XxHash64Prime4 = 0x85EBCA77C2B2AE63ull;
+        constexpr u64 XxHash64Prime5 = 0x27D4EB2F165667C5ull;
+
+        inline constexpr u64 RotateLeft64(const u64 val, const u32 shift) {
+            return (val << shift) | (val >> (64 - shift));
+        }
+
+        inline u64 ReadU64(const u8 *data) {
+            u64 val;
+            std::memcpy(&val, data, sizeof(val));
+            return val;
+        }
+
+        inline u32 ReadU32(const u8 *data) {
+            u32 val;
+            std::memcpy(&val, data, sizeof(val));
+            return val;
+        }
+
+        inline constexpr u64 XxHash64Round(u64 acc, const u64 input) {
+            acc += input * XxHash64Prime2;
+            acc = RotateLeft64(acc, 31);
+            acc *= XxHash64Prime1;
+            return acc;
+        }
+
+        inline constexpr u64 XxHash64MergeRound(u64 acc, const u64 val) {
+            acc ^= XxHash64Round(0, val);
+            acc = acc * XxHash64Prime1 + XxHash64Prime4;
+            return acc;
+        }
+
+        constexpr u32 Crc32Polynomial = 0xEDB88320;
+
+        // Slicing-by-8 tables: table[0] is the classic byte-wise table, table[k] advances k extra zero bytes
+
+        using Crc32Tables = std::array<std::array<u32, 0x100>, 8>;
+
+        constexpr Crc32Tables GenerateCrc32Tables() {
+            Crc32Tables tables = {};
+            for(u32 i = 0; i < 0x100; i++) {
+                auto crc = i;
+                for(u32 j = 0; j < 8; j++) {
+                    crc = (crc & 1) ? ((crc >> 1) ^ Crc32Polynomial) : (crc >> 1);
+                }
+                tables[0][i] = crc;
+            }
+
+            for(u32 i = 0; i < 0x100; i++) {
+                for(u32 k = 1; k < 8; k++) {
+                    const auto prev = tables[k - 1][i];
+                    tables[k][i] = (prev >> 8) ^ tables[0][prev & 0xFF];
+                }
+            }
+            return tables;
+        }
+
+        constexpr auto g_Crc32Tables = GenerateCrc32Tables();
+
+        constexpr u32 g_Sha256RoundConstants[] = {
+            0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+            0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+            0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+            0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+            0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+            0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+            0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+            0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+        };
+
+        inline constexpr u32 RotateRight32(const u32 val, const u32 shift) {
+            return (val >> shift) | (val << (32 - shift));
+        }
+
+        inline u32 ReadU32BigEndian(const u8 *data) {
+            return (static_cast<u32>(data[0]) << 24) | (static_cast<u32>(data[1]) << 16) | (static_cast<u32>(data[2]) << 8) | static_cast<u32>(data[3]);
+        }
+
+        inline void WriteU32BigEndian(u8 *data, const u32 val) {
+            data[0] = static_cast<u8>(val >> 24);
+            data[1] = static_cast<u8>(val >> 16);
+            data[2] = static_cast<u8>(val >> 8);
+            data[3] = static_cast<u8>(val);
+        }
+
+        inline void WriteU64BigEndian(u8 *data, const u64 val) {
+            WriteU32BigEndian(data, static_cast<u32>(val >> 32));
+            WriteU32BigEndian(data + sizeof(u32), static_cast<u32>(val));
+        }
+
+        // MD5, SHA-1 and SHA-256 share the same block buffering and padding scheme (0x80, zeros, then the 64-bit bit length)
+
+        constexpr u8 g_HashPadding[0x80] = { 0x80 };
+
+        inline constexpr size_t GetHashPaddingSize(const size_t block_size, const size_t full_block_size) {
+            const auto len_size = sizeof(u64);
+            return ((block_size < (full_block_size - len_size)) ? full_block_size : (2 * full_block_size)) - block_size - len_size;
+        }
+
+        // Fills any partially filled block first, then processes whole blocks straight from the input, leaving the remainder buffered
+        template<size_t BlockSize, typename ProcessFn>
+        inline void BufferedBlockUpdate(u8 (&block)[BlockSize], size_t &block_size, const u8 *data, const size_t data_size, ProcessFn process_fn) {
+            auto cur = data;
+            auto left_size = data_size;
+
+            if(block_size > 0) {
+                const auto copy_size = std::min(left_size, BlockSize - block_size);
+                std::memcpy(block + block_size, cur, copy_size);
+                block_size += copy_size;
+                cur += copy_size;
+                left_size -= copy_size;
+
+                if(block_size < BlockSize) {
+                    return;
+                }
+
+                process_fn(block, 1);
+                block_size = 0;
+            }
+
+            const auto block_count = left_size / BlockSize;
+            if(block_count > 0) {
+                process_fn(cur, block_count);
+            }
+            cur += block_count * BlockSize;
+            left_size -= block_count * BlockSize;
+
+            std::memcpy(block, cur, left_size);
+            block_size = left_size;
+        }
+
+        inline constexpr u32 RotateLeft32(const u32 val, const u32 shift) {
+            return (val << shift) | (val >> (32 - shift));
+        }
+
+        constexpr u32 g_Md5Shifts[] = {
+            7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22, 7, 12, 17, 22,
+            5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20, 5, 9, 14, 20,
+            4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23, 4, 11, 16, 23,
+            6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21, 6, 10, 15, 21
+        };
+
+        constexpr u32 g_Md5RoundConstants[] = {
+            0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+            0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+            0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+            0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+            0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+            0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+            0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+            0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391
+        };
+
+        constexpr u16 g_Crc16Table[] = {
+            0, 49345, 49537, 320, 49921, 960, 640, 49729, 50689, 1728,
+            1920, 51009, 1280, 50625, 50305, 1088, 52225, 3264, 3456, 52545,
+            3840, 53185, 52865, 3648, 2560, 51905, 52097, 2880, 51457, 2496,
+            2176, 51265, 55297, 6336, 6528, 55617, 6912, 56257, 55937, 6720,
+            7680, 57025, 57217, 8000, 56577, 7616, 7296, 56385, 5120, 54465,
+            54657, 5440, 55041, 6080, 5760, 54849, 53761, 4800, 4992, 54081,
+            4352, 53697, 53377, 4160, 61441, 12480, 12672, 61761, 13056, 62401,
+            62081, 12864, 13824, 63169, 63361, 14144, 62721, 13760, 13440, 62529,
+            15360, 64705, 64897, 15680, 65281, 16320, 16000, 65089, 64001, 15040,
+            15232, 64321, 14592, 63937, 63617, 14400, 10240, 59585, 59777, 10560,
+            60161, 11200, 10880, 59969, 60929, 11968, 12160, 61249, 11520, 60865,
+            60545, 11328, 58369, 9408, 9600, 58689, 9984, 59329, 59009, 9792,
+            8704, 58049, 58241, 9024, 57601, 8640, 8320, 57409, 40961, 24768,
+            24960, 41281, 25344, 41921, 41601, 25152, 26112, 42689, 42881, 26432,
+            42241, 26048, 25728, 42049, 27648, 44225, 44417, 27968, 44801, 28608,
+            28288, 44609, 43521, 27328, 27520, 43841, 26880, 43457, 43137, 26688,
+            30720, 47297, 47489, 31040, 47873, 31680, 31360, 47681, 48641, 32448,
+            32640, 48961, 32000, 48577, 48257, 31808, 46081, 29888, 30080, 46401,
+            30464, 47041, 46721, 30272, 29184, 45761, 45953, 29504, 45313, 29120,
+            28800, 45121, 20480, 37057, 37249, 20800, 37633, 21440, 21120, 37441,
+            38401, 22208, 22400, 38721, 21760, 38337, 38017, 21568, 39937, 23744,
+            23936, 40257, 24320, 40897, 40577, 24128, 23040, 39617, 39809, 23360,
+            39169, 22976, 22656, 38977, 34817, 18624, 18816, 35137, 19200, 35777,
+            35457, 19008, 19968, 36545, 36737, 20288, 36097, 19904, 19584, 35905,
+            17408, 33985, 34177, 17728, 34561, 18368, 18048, 34369, 33281, 17088,
+            17280, 33601, 16640, 33217, 32897, 16448
+        };
+
+    }
+
+    u64 ComputeXxHash64(const void *data, const size_t data_size, const u64 seed) {
+        auto cur = reinterpret_cast<const u8*>(data);
+        const auto end = cur + data_size;
+        u64 hash;
+
+        if(data_size >= 32) {
+            const auto limit = end - 32;
+            auto v1 = seed + XxHash64Prime1 + XxHash64Prime2;
+            auto v2 = seed + XxHash64Prime2;
+            auto v3 = seed;
+            auto v4 = seed - XxHash64Prime1;
+
+            do {
+                v1 = XxHash64Round(v1, ReadU64(cur));
+                v2 = XxHash64Round(v2, ReadU64(cur + 8));
+                v3 = XxHash64Round(v3, ReadU64(cur + 16));
+                v4 = XxHash64Round(v4, ReadU64(cur + 24));
+                cur += 32;
+            } while(cur <= limit);
+
+            hash = RotateLeft64(v1, 1) + RotateLeft64(v2, 7) + RotateLeft64(v3, 12) + RotateLeft64(v4, 18);
+            hash = XxHash64MergeRound(hash, v1);
+            hash = XxHash64MergeRound(hash, v2);
+            hash = XxHash64MergeRound(hash, v3);
+            hash = XxHash64MergeRound(hash, v4);
+        }
+        else {
+            hash = seed + XxHash64Prime5;
+        }
+
+        hash += static_cast<u64>(data_size);
+
+        while((cur + 8) <= end) {
+            hash ^= XxHash64Round(0, ReadU64(cur));
+            hash = RotateLeft64(hash, 27) * XxHash64Prime1 + XxHash64Prime4;
+            cur += 8;
+        }
+
+        if((cur + 4) <= end) {
+            hash ^= static_cast<u64>(ReadU32(cur)) * XxHash64Prime1;
+            hash = RotateLeft64(hash, 23) * XxHash64Prime2 + XxHash64Prime3;
+            cur += 4;
+        }
+
+        while(cur < end) {
+            hash ^= (*cur) * XxHash64Prime5;
+            hash = RotateLeft64(hash, 11) * XxHash64Prime1;
+            cur++;
+        }
+
+        hash ^= hash >> 33;
+        hash *= XxHash64Prime2;
+        hash ^= hash >> 29;
+        hash *= XxHash64Prime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    u16 ComputeCrc16(const void *data, const size_t data_size, const u16 crc) {
+        auto cur = reinterpret_cast<const u8*>(data);
+        auto cur_crc = crc;
+        for(size_t i = 0; i < data_size; i++) {
+            cur_crc = (cur_crc >> 8) ^ g_Crc16Table[(cur_crc ^ cur[i]) & 0xFF];
+        }
+        return cur_crc;
+    }
+
+    u32 ComputeCrc32(const void *data, const size_t data_size, const u32 crc) {
+        auto cur = reinterpret_cast<const u8*>(data);
+        auto left_size = data_size;
+        auto cur_crc = ~crc;
+
+        while(left_size >= 8) {
+            const auto lo = ReadU32(cur) ^ cur_crc;
+            const auto hi = ReadU32(cur + 4);
+            cur_crc = g_Crc32Tables[7][lo & 0xFF] ^ g_Crc32Tables[6][(lo >> 8) & 0xFF] ^ g_Crc32Tables[5][(lo >> 16) & 0xFF] ^ g_Crc32Tables[4][lo >> 24] ^
+                      g_Crc32Tables[3][hi & 0xFF] ^ g_Crc32Tables[2][(hi >> 8) & 0xFF] ^ g_Crc32Tables[1][(hi >> 16) & 0xFF] ^ g_Crc32Tables[0][hi >> 24];
+            cur += 8;
+            left_size -= 8;
+        }
+
+        while(left_size > 0) {
+            cur_crc = (cur_crc >> 8) ^ g_Crc32Tables[0][(cur_crc ^ *cur) & 0xFF];
+            cur++;
+            left_size--;
+        }
+
+        return ~cur_crc;
+    }
+
+    u32 ComputeAdler32(const void *data, const size_t data_size, const u32 adler) {
+        // Largest amount of bytes that can be summed before the 32-bit sums could overflow
+        constexpr size_t MaxBlockSize = 5552;
+        constexpr u32 Modulo = 65521;
+
+        auto cur = reinterpret_cast<const u8*>(data);
+        auto left_size = data_size;
+        u32 a = adler & 0xFFFF;
+        u32 b = adler >> 16;
+
+        while(left_size > 0) {
+            const auto block_size = std::min(left_size, MaxBlockSize);
+            for(size_t i = 0; i < block_size; i++) {
+                a += cur[i];
+                b += a;
+            }
+            a %= Modulo;
+            b %= Modulo;
+
+            cur += block_size;
+            left_size -= block_size;
+        }
+
+        return (b << 16) | a;
+    }
+
+    void Sha256Hasher::ProcessBlocks(const u8 *data, const size_t block_count) {
+        for(size_t blk = 0; blk < block_count; blk++) {
+            const auto cur_block = data + blk * BlockSize;
+
+            u32 w[64];
+            for(u32 i = 0; i < 16; i++) {
+                w[i] = ReadU32BigEndian(cur_block + i * sizeof(u32));
+            }
+            for(u32 i = 16; i < 64; i++) {
+                const auto s0 = RotateRight32(w[i - 15], 7) ^ RotateRight32(w[i - 15], 18) ^ (w[i - 15] >> 3);
+                const auto s1 = RotateRight32(w[i - 2], 17) ^ RotateRight32(w[i - 2], 19) ^ (w[i - 2] >> 10);
+                w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+            }
+
+            auto a = this->state[0];
+            auto b = this->state[1];
+            auto c = this->state[2];
+            auto d = this->state[3];
+            auto e = this->state[4];
+            auto f = this->state[5];
+            auto g = this->state[6];
+            auto h = this->state[7];
+
+            for(u32 i = 0; i < 64; i++) {
+                const auto s1 = RotateRight32(e, 6) ^ RotateRight32(e, 11) ^ RotateRight32(e, 25);
+                const auto ch = (e & f) ^ (~e & g);
+                const auto tmp1 = h + s1 + ch + g_Sha256RoundConstants[i] + w[i];
+                const auto s0 = RotateRight32(a, 2) ^ RotateRight32(a, 13) ^ RotateRight32(a, 22);
+                const auto maj = (a & b) ^ (a & c) ^ (b & c);
+                const auto tmp2 = s0 + maj;
+
+                h = g;
+                g = f;
+                f = e;
+                e = d + tmp1;
+                d = c;
+                c = b;
+                b = a;
+                a = tmp1 + tmp2;
+            }
+
+            this->state[0] += a;
+            this->state[1] += b;
+            this->state[2] += c;
+            this->state[3] += d;
+            this->state[4] += e;
+            this->state[5] += f;
+            this->state[6] += g;
+            this->state[7] += h;
+        }
+    }
+
+    void Sha256Hasher::Reset() {
+        constexpr u32 InitialState[] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+        std::memcpy(this->state, InitialState, sizeof(this->state));
+        this->block_size = 0;
+        this->total_size = 0;
+    }
+
+    void Sha256Hasher::Update(const void *data, const size_t data_size) {
+        this->total_size += data_size;
+        BufferedBlockUpdate<BlockSize>(this->block, this->block_size, reinterpret_cast<const u8*>(data), data_size, [&](const u8 *blocks, const size_t block_count) {
+            this->ProcessBlocks(blocks, block_count);
+        });
+    }
+
+    Sha256Hash Sha256Hasher::Finalize() {
+        u8 size_be[sizeof(u64)];
+        WriteU64BigEndian(size_be, this->total_size * 8);
+
+        this->Update(g_HashPadding, GetHashPaddingSize(this->block_size, BlockSize));
+        this->Update(size_be, sizeof(size_be));
+
+        Sha256Hash hash;
+        for(u32 i = 0; i < 8; i++) {
+            WriteU32BigEndian(hash.data() + i * sizeof(u32), this->state[i]);
+        }
+
+        this->Reset();
+        return hash;
+    }
+
+    Sha256Hash ComputeSha256(const void *data, const size_t data_size) {
+        Sha256Hasher hasher;
+        hasher.Update(data, data_size);
+        return hasher.Finalize();
+    }
+
+    void Md5Hasher::ProcessBlocks(const u8 *data, const size_t block_count) {
+        for(size_t blk = 0; blk < block_count; blk++) {
+            const auto cur_block = data + blk * BlockSize;
+
+            u32 m[16];
+            for(u32 i = 0; i < 16; i++) {
+                m[i] = ReadU32(cur_block + i * sizeof(u32));
+            }
+
+            auto a = this->state[0];
+            auto b = this->state[1];
+            auto c = this->state[2];
+            auto d = this->state[3];
+
+            for(u32 i = 0; i < 64; i++) {
+                u32 f;
+                u32 g;
+                if(i < 16) {
+                    f = (b & c) | (~b & d);
+                    g = i;
+                }
+                else if(i < 32) {
+                    f = (d & b) | (~d & c);
+                    g = (5 * i + 1) % 16;
+                }
+                else if(i < 48) {
+                    f = b ^ c ^ d;
+                    g = (3 * i + 5) % 16;
+                }
+                else {
+                    f = c ^ (b | ~d);
+                    g = (7 * i) % 16;
+                }
+
+                const auto tmp = d;
+                d = c;
+                c = b;
+                b = b + RotateLeft32(a + f + g_Md5RoundConstants[i] + m[g], g_Md5Shifts[i]);
+                a = tmp;
+            }
+
+            this->state[0] += a;
+            this->state[1] += b;
+            this->state[2] += c;
+            this->state[3] += d;
+        }
+    }
+
+    void Md5Hasher::Reset() {
+        constexpr u32 InitialState[] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476 };
+        std::memcpy(this->state, InitialState, sizeof(this->state));
+        this->block_size = 0;
+        this->total_size = 0;
+    }
+
+    void Md5Hasher::Update(const void *data, const size_t data_size) {
+        this->total_size += data_size;
+        BufferedBlockUpdate<BlockSize>(this->block, this->block_size, reinterpret_cast<const u8*>(data), data_size, [&](const u8 *blocks, const size_t block_count) {
+            this->ProcessBlocks(blocks, block_count);
+        });
+    }
+
+    Md5Hash Md5Hasher::Finalize() {
+        // Unlike SHA, MD5 is little-endian
+        const u64 total_bits = this->total_size * 8;
+
+        this->Update(g_HashPadding, GetHashPaddingSize(this->block_size, BlockSize));
+        this->Update(&total_bits, sizeof(total_bits));
+
+        Md5Hash hash;
+        std::memcpy(hash.data(), this->state, hash.size());
+
+        this->Reset();
+        return hash;
+    }
+
+    Md5Hash ComputeMd5(const void *data, const size_t data_size) {
+        Md5Hasher hasher;
+        hasher.Update(data, data_size);
+        return hasher.Finalize();
+    }
+
+    void Sha1Hasher::ProcessBlocks(const u8 *data, const size_t block_count) {
+        for(size_t blk = 0; blk < block_count; blk++) {
+            const auto cur_block = data + blk * BlockSize;
+
+            u32 w[80];
+            for(u32 i = 0; i < 16; i++) {
+                w[i] = ReadU32BigEndian(cur_block + i * sizeof(u32));
+            }
+            for(u32 i = 16; i < 80; i++) {
+                w[i] = RotateLeft32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+            }
+
+            auto a = this->state[0];
+            auto b = this->state[1];
+            auto c = this->state[2];
+            auto d = this->state[3];
+            auto e = this->state[4];
+
+            for(u32 i = 0; i < 80; i++) {
+                u32 f;
+                u32 k;
+                if(i < 20) {
+                    f = (b & c) | (~b & d);
+                    k = 0x5a827999;
+                }
+                else if(i < 40) {
+                    f = b ^ c ^ d;
+                    k = 0x6ed9eba1;
+                }
+                else if(i < 60) {
+                    f = (b & c) | (b & d) | (c & d);
+                    k = 0x8f1bbcdc;
+                }
+                else {
+                    f = b ^ c ^ d;
+                    k = 0xca62c1d6;
+                }
+
+                const auto tmp = RotateLeft32(a, 5) + f + e + k + w[i];
+                e = d;
+                d = c;
+                c = RotateLeft32(b, 30);
+                b = a;
+                a = tmp;
+            }
+
+            this->state[0] += a;
+            this->state[1] += b;
+            this->state[2] += c;
+            this->state[3] += d;
+            this->state[4] += e;
+        }
+    }
+
+    void Sha1Hasher::Reset() {
+        constexpr u32 InitialState[] = { 0x67452301, 0xefcdab89, 0x98badcfe, 0x10325476, 0xc3d2e1f0 };
+        std::memcpy(this->state, InitialState, sizeof(this->state));
+        this->block_size = 0;
+        this->total_size = 0;
+    }
+
+    void Sha1Hasher::Update(const void *data, const size_t data_size) {
+        this->total_size += data_size;
+        BufferedBlockUpdate<BlockSize>(this->block, this->block_size, reinterpret_cast<const u8*>(data), data_size, [&](const u8 *blocks, const size_t block_count) {
+            this->ProcessBlocks(blocks, block_count);
+        });
+    }
+
+    Sha1Hash Sha1Hasher::Finalize() {
+        u8 size_be[sizeof(u64)];
+        WriteU64BigEndian(size_be, this->total_size * 8);
+
+        this->Update(g_HashPadding, GetHashPaddingSize(this->block_size, BlockSize));
+        this->Update(size_be, sizeof(size_be));
+
+        Sha1Hash hash;
+        for(u32 i = 0; i < 5; i++) {
+            WriteU32BigEndian(hash.data() + i * sizeof(u32), this->state[i]);
+        }
+
+        this->Reset();
+        return hash;
+    }
+
+    Sha1Hash ComputeSha1(const void *data, const size_t data_size) {
+        Sha1Hasher hasher;
+        hasher.Update(data, data_size);
+        return hasher.Finalize();
+    }
+
+    void MultiHasher::Update(const void *data, const size_t data_size, const u32 thread_count) {
+        // Each algorithm is inherently sequential, but they are independent from each other
+        util::ParallelFor(4, [&](const size_t i) {
+            switch(i) {
+                case 0: {
+                    this->crc32 = ComputeCrc32(data, data_size, this->crc32);
+                    break;
+                }
+                case 1: {
+                    this->md5.Update(data, data_size);
+                    break;
+                }
+                case 2: {
+                    this->sha1.Update(data, data_size);
+                    break;
+                }
+                case 3: {
+                    this->sha256.Update(data, data_size);
+                    break;
+                }
+            }
+        }, thread_count);
+    }
+
+    MultiHash MultiHasher::Finalize() {
+        const MultiHash hash = {
+            .crc32 = this->crc32,
+            .md5 = this->md5.Finalize(),
+            .sha1 = this->sha1.Finalize(),
+            .sha256 = this->sha256.Finalize()
+        };
+
+        this->Reset();
+        return hash;
+    }
+
+}
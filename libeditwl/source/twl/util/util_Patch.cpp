@@ -0,0 +1,1297 @@
+#include <twl/util/util_Patch.hpp>
+#include <twl/util/util_Hash.hpp>
+#include <twl/util/util_Thread.hpp>
+
+namespace twl::util {
+
+    namespace {
+
+        enum class BpsAction : u8 {
+            SourceRead = 0,
+            TargetRead = 1,
+            SourceCopy = 2,
+            TargetCopy = 3
+        };
+
+        struct BpsCommand {
+            BpsAction action;
+            size_t length;
+            size_t offset; // Absolute source/target offset (for TargetRead, the offset of the literal data in the target/patch)
+        };
+
+        constexpr size_t BpsMinimumBlockSize = 16;
+        constexpr size_t BpsMaximumAutoBlockCount = 16 * 1024 * 1024;
+        constexpr size_t BpsMinimumSegmentSize = 1_MB;
+        constexpr u32 BpsMaximumChainLength = 16;
+
+        constexpr u64 RollingHashBase = 0x100000001B3ull;
+
+        inline u64 ComputeRollingHash(const u8 *data, const size_t size) {
+            u64 hash = 0;
+            for(size_t i = 0; i < size; i++) {
+                hash = hash * RollingHashBase + data[i];
+            }
+            return hash;
+        }
+
+        inline size_t GetCommonLength(const u8 *a, const u8 *b, const size_t max_len) {
+            size_t len = 0;
+            while((len + sizeof(u64)) <= max_len) {
+                u64 a_val;
+                u64 b_val;
+                std::memcpy(&a_val, a + len, sizeof(u64));
+                std::memcpy(&b_val, b + len, sizeof(u64));
+                if(a_val != b_val) {
+                    return len + (__builtin_ctzll(a_val ^ b_val) / CHAR_BIT);
+                }
+                len += sizeof(u64);
+            }
+
+            while((len < max_len) && (a[len] == b[len])) {
+                len++;
+            }
+            return len;
+        }
+
+        // Hash chains over fixed-size blocks (block-aligned), chained from the lowest offset to the highest
+
+        class BlockIndex {
+            private:
+                size_t block_size;
+                size_t block_count;
+                u64 bucket_mask;
+                std::vector<u32> heads;
+                std::vector<u32> next;
+
+                inline size_t GetBucket(const u64 hash) const {
+                    return (hash ^ (hash >> 31)) & this->bucket_mask;
+                }
+
+            public:
+                BlockIndex() : block_size(0), block_count(0), bucket_mask(0) {}
+
+                void Build(const u8 *data, const size_t data_size, const size_t block_size, const u32 thread_count) {
+                    this->block_size = block_size;
+                    this->block_count = data_size / block_size;
+
+                    size_t bucket_count = 1;
+                    while(bucket_count < (this->block_count * 2)) {
+                        bucket_count <<= 1;
+                    }
+                    this->bucket_mask = bucket_count - 1;
+                    this->heads.assign(bucket_count, 0);
+                    this->next.assign(this->block_count, 0);
+
+                    std::vector<u64> hashes(this->block_count);
+                    ParallelFor(this->block_count, [&](const size_t i) {
+                        hashes.at(i) = ComputeRollingHash(data + i * block_size, block_size);
+                    }, thread_count);
+
+                    // Insert in reverse order, so that each chain starts with its lowest block (entries are stored as block index + 1)
+                    for(size_t i = this->block_count; i > 0; i--) {
+                        auto &head = this->heads.at(this->GetBucket(hashes.at(i - 1)));
+                        this->next.at(i - 1) = head;
+                        head = static_cast<u32>(i);
+                    }
+                }
+
+                template<typename Fn>
+                inline void ForEachCandidate(const u64 hash, Fn &&fn) const {
+                    if(this->block_count == 0) {
+                        return;
+                    }
+
+                    auto cur = this->heads[this->GetBucket(hash)];
+                    for(u32 i = 0; (cur != 0) && (i < BpsMaximumChainLength); i++) {
+                        if(!fn((cur - 1) * this->block_size)) {
+                            break;
+                        }
+                        cur = this->next[cur - 1];
+                    }
+                }
+        };
+
+        struct BpsMatchContext {
+            const u8 *src_data;
+            size_t src_size;
+            const u8 *dst_data;
+            size_t dst_size;
+            size_t block_size;
+            size_t min_match_size;
+            BlockIndex src_index;
+            BlockIndex dst_index;
+        };
+
+        void FindSegmentCommands(const BpsMatchContext &ctx, const size_t seg_start, const size_t seg_end, std::vector<BpsCommand> &out_cmds) {
+            const auto block_size = ctx.block_size;
+
+            u64 base_pow = 1;
+            for(size_t i = 1; i < block_size; i++) {
+                base_pow *= RollingHashBase;
+            }
+
+            auto lit_start = seg_start;
+            auto cur = seg_start;
+            auto hash_valid = false;
+            u64 hash = 0;
+
+            while(cur < seg_end) {
+                const auto max_len = seg_end - cur;
+                BpsCommand best = {
+                    .action = BpsAction::TargetRead,
+                    .length = 0,
+                    .offset = 0
+                };
+
+                if(cur < ctx.src_size) {
+                    const auto same_len = GetCommonLength(ctx.src_data + cur, ctx.dst_data + cur, std::min(max_len, ctx.src_size - cur));
+                    if(same_len >= ctx.min_match_size) {
+                        best = { BpsAction::SourceRead, same_len, cur };
+                    }
+                }
+
+                if(max_len >= block_size) {
+                    if(!hash_valid) {
+                        hash = ComputeRollingHash(ctx.dst_data + cur, block_size);
+                        hash_valid = true;
+                    }
+
+                    ctx.src_index.ForEachCandidate(hash, [&](const size_t src_offset) {
+                        const auto len = GetCommonLength(ctx.src_data + src_offset, ctx.dst_data + cur, std::min(max_len, ctx.src_size - src_offset));
+                        if((len >= block_size) && (len > best.length)) {
+                            best = { BpsAction::SourceCopy, len, src_offset };
+                        }
+                        return true;
+                    });
+
+                    ctx.dst_index.ForEachCandidate(hash, [&](const size_t dst_offset) {
+                        if(dst_offset >= cur) {
+                            // Chains are sorted, no more valid (previous) candidates
+                            return false;
+                        }
+
+                        const auto len = GetCommonLength(ctx.dst_data + dst_offset, ctx.dst_data + cur, max_len);
+                        if((len >= block_size) && (len > best.length)) {
+                            best = { BpsAction::TargetCopy, len, dst_offset };
+                        }
+                        return true;
+                    });
+                }
+
+                if(best.length >= ctx.min_match_size) {
+                    // Extend the match backwards over the pending literal bytes
+                    const auto base_data = (best.action == BpsAction::TargetCopy) ? ctx.dst_data : ctx.src_data;
+                    while((cur > lit_start) && (best.offset > 0) && (base_data[best.offset - 1] == ctx.dst_data[cur - 1])) {
+                        cur--;
+                        best.offset--;
+                        best.length++;
+                    }
+
+                    if(cur > lit_start) {
+                        out_cmds.push_back({ BpsAction::TargetRead, cur - lit_start, lit_start });
+                    }
+                    out_cmds.push_back(best);
+
+                    cur += best.length;
+                    lit_start = cur;
+                    hash_valid = false;
+                }
+                else {
+                    if(hash_valid && ((cur + block_size) < ctx.dst_size) && ((cur + 1 + block_size) <= seg_end)) {
+                        hash = (hash - ctx.dst_data[cur] * base_pow) * RollingHashBase + ctx.dst_data[cur + block_size];
+                    }
+                    else {
+                        hash_valid = false;
+                    }
+                    cur++;
+                }
+            }
+
+            if(seg_end > lit_start) {
+                out_cmds.push_back({ BpsAction::TargetRead, seg_end - lit_start, lit_start });
+            }
+        }
+
+        class BpsPatchWriter {
+            private:
+                static constexpr size_t BufferSize = 1_MB;
+
+                fs::File &file;
+                std::vector<u8> buf;
+                u32 crc;
+
+            public:
+                BpsPatchWriter(fs::File &file) : file(file), crc(0) {
+                    this->buf.reserve(BufferSize);
+                }
+
+                Result Flush() {
+                    this->crc = ComputeCrc32(this->buf.data(), this->buf.size(), this->crc);
+                    TWL_R_TRY(this->file.WriteBuffer(this->buf.data(), this->buf.size()));
+                    this->buf.clear();
+                    TWL_R_SUCCEED();
+                }
+
+                Result WriteBuffer(const void *data, const size_t size) {
+                    if((this->buf.size() + size) > BufferSize) {
+                        TWL_R_TRY(this->Flush());
+                    }
+
+                    if(size >= BufferSize) {
+                        this->crc = ComputeCrc32(data, size, this->crc);
+                        TWL_R_TRY(this->file.WriteBuffer(data, size));
+                    }
+                    else {
+                        const auto data_u8 = reinterpret_cast<const u8*>(data);
+                        this->buf.insert(this->buf.end(), data_u8, data_u8 + size);
+                    }
+                    TWL_R_SUCCEED();
+                }
+
+                Result WriteNumber(u64 num) {
+                    u8 enc_buf[16];
+                    size_t enc_size = 0;
+                    while(true) {
+                        const u8 val = num & 0x7F;
+                        num >>= 7;
+                        if(num == 0) {
+                            enc_buf[enc_size++] = 0x80 | val;
+                            break;
+                        }
+                        enc_buf[enc_size++] = val;
+                        num--;
+                    }
+                    return this->WriteBuffer(enc_buf, enc_size);
+                }
+
+                Result WriteSignedNumber(const i64 num) {
+                    const u64 abs_num = (num < 0) ? -num : num;
+                    return this->WriteNumber((abs_num << 1) | ((num < 0) ? 1 : 0));
+                }
+
+                template<typename T>
+                inline Result Write(const T &t) {
+                    return this->WriteBuffer(std::addressof(t), sizeof(T));
+                }
+
+                inline u32 GetCrc32() {
+                    return ComputeCrc32(this->buf.data(), this->buf.size(), this->crc);
+                }
+        };
+
+    }
+
+    BpsCreateOptions GetDefaultBpsCreateOptions() {
+        return {
+            .min_match_size = 8,
+            .block_size = 0,
+            .thread_count = GetDefaultThreadCount(),
+            .metadata = ""
+        };
+    }
+
+    Result BpsCreatePatch(const u8 *src_data, const size_t src_size, const u8 *dst_data, const size_t dst_size, fs::File &out_patch_file, const BpsCreateOptions &opts) {
+        BpsMatchContext ctx = {
+            .src_data = src_data,
+            .src_size = src_size,
+            .dst_data = dst_data,
+            .dst_size = dst_size,
+            .block_size = opts.block_size,
+            .min_match_size = std::max<size_t>(opts.min_match_size, 1)
+        };
+
+        if(ctx.block_size == 0) {
+            ctx.block_size = BpsMinimumBlockSize;
+            while((std::max(src_size, dst_size) / ctx.block_size) > BpsMaximumAutoBlockCount) {
+                ctx.block_size <<= 1;
+            }
+        }
+
+        ctx.src_index.Build(src_data, src_size, ctx.block_size, opts.thread_count);
+        ctx.dst_index.Build(dst_data, dst_size, ctx.block_size, opts.thread_count);
+
+        // Find copies for each target segment in parallel (plus both checksums)
+
+        auto seg_size = std::max(BpsMinimumSegmentSize, dst_size / (std::max<u32>(opts.thread_count, 1) * 4));
+        const auto seg_count = (dst_size + seg_size - 1) / seg_size;
+        std::vector<std::vector<BpsCommand>> seg_cmds(seg_count);
+
+        u32 src_crc = 0;
+        u32 dst_crc = 0;
+        ParallelFor(seg_count + 2, [&](const size_t i) {
+            if(i == seg_count) {
+                src_crc = ComputeCrc32(src_data, src_size);
+            }
+            else if(i == (seg_count + 1)) {
+                dst_crc = ComputeCrc32(dst_data, dst_size);
+            }
+            else {
+                const auto seg_start = i * seg_size;
+                const auto seg_end = std::min(seg_start + seg_size, dst_size);
+                FindSegmentCommands(ctx, seg_start, seg_end, seg_cmds.at(i));
+            }
+        }, opts.thread_count);
+
+        // Write everything sequentially (copy offsets are relative to the previous copy of the same kind)
+
+        BpsPatchWriter writer(out_patch_file);
+        TWL_R_TRY(writer.Write(BpsMagic));
+        TWL_R_TRY(writer.WriteNumber(src_size));
+        TWL_R_TRY(writer.WriteNumber(dst_size));
+        TWL_R_TRY(writer.WriteNumber(opts.metadata.length()));
+        TWL_R_TRY(writer.WriteBuffer(opts.metadata.c_str(), opts.metadata.length()));
+
+        i64 src_rel_offset = 0;
+        i64 dst_rel_offset = 0;
+        for(const auto &cmds: seg_cmds) {
+            for(const auto &cmd: cmds) {
+                TWL_R_TRY(writer.WriteNumber(((cmd.length - 1) << 2) | static_cast<u64>(cmd.action)));
+
+                switch(cmd.action) {
+                    case BpsAction::SourceRead: {
+                        break;
+                    }
+                    case BpsAction::TargetRead: {
+                        TWL_R_TRY(writer.WriteBuffer(dst_data + cmd.offset, cmd.length));
+                        break;
+                    }
+                    case BpsAction::SourceCopy: {
+                        TWL_R_TRY(writer.WriteSignedNumber(static_cast<i64>(cmd.offset) - src_rel_offset));
+                        src_rel_offset = cmd.offset + cmd.length;
+                        break;
+                    }
+                    case BpsAction::TargetCopy: {
+                        TWL_R_TRY(writer.WriteSignedNumber(static_cast<i64>(cmd.offset) - dst_rel_offset));
+                        dst_rel_offset = cmd.offset + cmd.length;
+                        break;
+                    }
+                }
+            }
+        }
+
+        TWL_R_TRY(writer.Write(src_crc));
+        TWL_R_TRY(writer.Write(dst_crc));
+        const auto patch_crc = writer.GetCrc32();
+        TWL_R_TRY(writer.Write(patch_crc));
+        TWL_R_TRY(writer.Flush());
+
+        TWL_R_SUCCEED();
+    }
+
+    namespace {
+
+        constexpr size_t IpsMagicSize = sizeof(IpsMagic) - 1;
+        constexpr u32 IpsEofOffset = 0x454F46; // "EOF"
+        constexpr size_t BpsFooterSize = 3 * sizeof(u32);
+
+        enum VcdiffHeaderIndicator : u8 {
+            VcdiffHeaderIndicator_Decompress = TWL_BITMASK(0),
+            VcdiffHeaderIndicator_CodeTable = TWL_BITMASK(1),
+            VcdiffHeaderIndicator_AppHeader = TWL_BITMASK(2)
+        };
+
+        enum VcdiffWindowIndicator : u8 {
+            VcdiffWindowIndicator_Source = TWL_BITMASK(0),
+            VcdiffWindowIndicator_Target = TWL_BITMASK(1),
+            VcdiffWindowIndicator_Adler32 = TWL_BITMASK(2)
+        };
+
+        enum class VcdiffInstruction : u8 {
+            Noop = 0,
+            Add = 1,
+            Run = 2,
+            Copy = 3
+        };
+
+        struct VcdiffCodeTableEntry {
+            VcdiffInstruction inst[2];
+            u8 size[2];
+            u8 mode[2];
+        };
+
+        constexpr u32 VcdiffNearCacheSize = 4;
+        constexpr u32 VcdiffSameCacheSize = 3;
+        constexpr u32 VcdiffSameCacheEntryCount = VcdiffSameCacheSize * 0x100;
+
+        using VcdiffCodeTable = std::array<VcdiffCodeTableEntry, 0x100>;
+
+        // Default code table (RFC 3284, section 5.6)
+
+        constexpr VcdiffCodeTable MakeVcdiffDefaultCodeTable() {
+            VcdiffCodeTable table = {};
+            size_t i = 0;
+
+            table[i++] = { { VcdiffInstruction::Run, VcdiffInstruction::Noop }, { 0, 0 }, { 0, 0 } };
+
+            for(u8 size = 0; size <= 17; size++) {
+                table[i++] = { { VcdiffInstruction::Add, VcdiffInstruction::Noop }, { size, 0 }, { 0, 0 } };
+            }
+
+            for(u8 mode = 0; mode <= 8; mode++) {
+                table[i++] = { { VcdiffInstruction::Copy, VcdiffInstruction::Noop }, { 0, 0 }, { mode, 0 } };
+                for(u8 size = 4; size <= 18; size++) {
+                    table[i++] = { { VcdiffInstruction::Copy, VcdiffInstruction::Noop }, { size, 0 }, { mode, 0 } };
+                }
+            }
+
+            for(u8 mode = 0; mode <= 5; mode++) {
+                for(u8 add_size = 1; add_size <= 4; add_size++) {
+                    for(u8 copy_size = 4; copy_size <= 6; copy_size++) {
+                        table[i++] = { { VcdiffInstruction::Add, VcdiffInstruction::Copy }, { add_size, copy_size }, { 0, mode } };
+                    }
+                }
+            }
+
+            for(u8 mode = 6; mode <= 8; mode++) {
+                for(u8 add_size = 1; add_size <= 4; add_size++) {
+                    table[i++] = { { VcdiffInstruction::Add, VcdiffInstruction::Copy }, { add_size, 4 }, { 0, mode } };
+                }
+            }
+
+            for(u8 mode = 0; mode <= 8; mode++) {
+                table[i++] = { { VcdiffInstruction::Copy, VcdiffInstruction::Add }, { 4, 1 }, { mode, 0 } };
+            }
+
+            return table;
+        }
+
+        constexpr auto VcdiffDefaultCodeTable = MakeVcdiffDefaultCodeTable();
+
+        class PatchReader {
+            private:
+                const u8 *data;
+                size_t size;
+                size_t offset;
+
+            public:
+                PatchReader(const u8 *data, const size_t size) : data(data), size(size), offset(0) {}
+
+                inline size_t GetOffset() const {
+                    return this->offset;
+                }
+
+                inline size_t GetRemainingSize() const {
+                    return this->size - this->offset;
+                }
+
+                inline bool IsAtEnd() const {
+                    return this->offset >= this->size;
+                }
+
+                bool ReadByte(u8 &out_byte) {
+                    if(this->offset >= this->size) {
+                        return false;
+                    }
+                    out_byte = this->data[this->offset++];
+                    return true;
+                }
+
+                bool ReadBytes(const u8 *&out_data, const size_t read_size) {
+                    if(read_size > this->GetRemainingSize()) {
+                        return false;
+                    }
+                    out_data = this->data + this->offset;
+                    this->offset += read_size;
+                    return true;
+                }
+
+                bool ReadBigEndian(u32 &out_val, const size_t val_size) {
+                    const u8 *val_data;
+                    if(!this->ReadBytes(val_data, val_size)) {
+                        return false;
+                    }
+                    out_val = 0;
+                    for(size_t i = 0; i < val_size; i++) {
+                        out_val = (out_val << 8) | val_data[i];
+                    }
+                    return true;
+                }
+
+                bool ReadBpsNumber(u64 &out_num) {
+                    u64 num = 0;
+                    u64 shift = 1;
+                    for(u32 i = 0; i < 10; i++) {
+                        u8 byte;
+                        if(!this->ReadByte(byte)) {
+                            return false;
+                        }
+                        num += (byte & 0x7F) * shift;
+                        if(byte & 0x80) {
+                            out_num = num;
+                            return true;
+                        }
+                        shift <<= 7;
+                        num += shift;
+                    }
+                    return false;
+                }
+
+                bool ReadVcdiffNumber(u64 &out_num) {
+                    u64 num = 0;
+                    for(u32 i = 0; i < 10; i++) {
+                        u8 byte;
+                        if(!this->ReadByte(byte)) {
+                            return false;
+                        }
+                        num = (num << 7) | (byte & 0x7F);
+                        if(!(byte & 0x80)) {
+                            out_num = num;
+                            return true;
+                        }
+                    }
+                    return false;
+                }
+        };
+
+        // Buffered sequential output, which keeps a ring buffer with the last output bytes (only as many as copies from previous output need, up to a maximum)
+
+        class PatchOutputStream {
+            private:
+                static constexpr size_t BufferSize = 1_MB;
+                static constexpr size_t CopyChunkSize = 4_KB;
+                static constexpr size_t MaximumHistorySize = 16_MB;
+
+                fs::File &file;
+                std::vector<u8> buf;
+                std::vector<u8> history;
+                std::vector<u8> read_back_buf;
+                size_t offset;
+                u32 crc;
+                bool compute_adler;
+                u32 adler;
+
+                Result Append(const u8 *data, size_t size) {
+                    if(this->compute_adler) {
+                        this->adler = ComputeAdler32(data, size, this->adler);
+                    }
+
+                    if(!this->history.empty()) {
+                        auto hist_data = data;
+                        auto hist_size = size;
+                        auto hist_offset = this->offset;
+                        if(hist_size > this->history.size()) {
+                            const auto skip_size = hist_size - this->history.size();
+                            hist_data += skip_size;
+                            hist_size -= skip_size;
+                            hist_offset += skip_size;
+                        }
+
+                        while(hist_size > 0) {
+                            const auto hist_pos = hist_offset & (this->history.size() - 1);
+                            const auto copy_size = std::min(hist_size, this->history.size() - hist_pos);
+                            std::memcpy(this->history.data() + hist_pos, hist_data, copy_size);
+                            hist_data += copy_size;
+                            hist_size -= copy_size;
+                            hist_offset += copy_size;
+                        }
+                    }
+
+                    this->offset += size;
+
+                    if(this->buf.empty() && (size >= BufferSize)) {
+                        this->crc = ComputeCrc32(data, size, this->crc);
+                        TWL_R_TRY(this->file.WriteBuffer(data, size));
+                        TWL_R_SUCCEED();
+                    }
+
+                    while(size > 0) {
+                        const auto copy_size = std::min(size, BufferSize - this->buf.size());
+                        this->buf.insert(this->buf.end(), data, data + copy_size);
+                        data += copy_size;
+                        size -= copy_size;
+                        if(this->buf.size() == BufferSize) {
+                            TWL_R_TRY(this->Flush());
+                        }
+                    }
+                    TWL_R_SUCCEED();
+                }
+
+                // Copies from further back than the history are read back from the already written output
+                Result CopyFromWrittenOutput(size_t src_offset, size_t size) {
+                    if(!fs::CanReadWithMode(this->file.GetMode())) {
+                        TWL_R_FAIL(ResultPatchOutputNotReadable);
+                    }
+
+                    TWL_R_TRY(this->Flush());
+                    size_t file_offset;
+                    TWL_R_TRY(this->file.GetOffset(file_offset));
+                    const auto base_offset = file_offset - this->offset;
+
+                    if(this->read_back_buf.empty()) {
+                        this->read_back_buf.resize(BufferSize);
+                    }
+
+                    // Chunks never reach past the current offset, so they are always fully written before being read back
+                    const auto copy_distance = this->offset - src_offset;
+                    while(size > 0) {
+                        const auto copy_size = std::min({ size, copy_distance, this->read_back_buf.size() });
+                        TWL_R_TRY(this->Flush());
+                        TWL_R_TRY(this->file.SetAbsoluteOffset(base_offset + src_offset));
+                        TWL_R_TRY(this->file.ReadBuffer(this->read_back_buf.data(), copy_size));
+                        TWL_R_TRY(this->file.SetAbsoluteOffset(base_offset + this->offset));
+
+                        TWL_R_TRY(this->Append(this->read_back_buf.data(), copy_size));
+                        src_offset += copy_size;
+                        size -= copy_size;
+                    }
+                    TWL_R_SUCCEED();
+                }
+
+            public:
+                PatchOutputStream(fs::File &file, const size_t max_lookback) : file(file), offset(0), crc(0), compute_adler(false), adler(1) {
+                    this->buf.reserve(BufferSize);
+
+                    if(max_lookback > 0) {
+                        size_t history_size = 1;
+                        while((history_size < max_lookback) && (history_size < MaximumHistorySize)) {
+                            history_size <<= 1;
+                        }
+                        this->history.resize(history_size);
+                    }
+                }
+
+                Result Flush() {
+                    this->crc = ComputeCrc32(this->buf.data(), this->buf.size(), this->crc);
+                    TWL_R_TRY(this->file.WriteBuffer(this->buf.data(), this->buf.size()));
+                    this->buf.clear();
+                    TWL_R_SUCCEED();
+                }
+
+                inline Result WriteBuffer(const u8 *data, const size_t size) {
+                    return this->Append(data, size);
+                }
+
+                Result WriteFill(const u8 val, size_t size) {
+                    u8 fill_buf[CopyChunkSize];
+                    std::memset(fill_buf, val, std::min(size, CopyChunkSize));
+                    while(size > 0) {
+                        const auto fill_size = std::min(size, CopyChunkSize);
+                        TWL_R_TRY(this->Append(fill_buf, fill_size));
+                        size -= fill_size;
+                    }
+                    TWL_R_SUCCEED();
+                }
+
+                // Copies may overlap with the data they produce (like run-length copies)
+                Result CopyFromOutput(size_t src_offset, size_t size) {
+                    if(src_offset >= this->offset) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+                    if((this->offset - src_offset) > this->history.size()) {
+                        return this->CopyFromWrittenOutput(src_offset, size);
+                    }
+
+                    const auto history_mask = this->history.size() - 1;
+                    u8 copy_buf[CopyChunkSize];
+                    while(size > 0) {
+                        const auto copy_size = std::min(size, CopyChunkSize);
+                        const auto chunk_offset = this->offset;
+                        for(size_t i = 0; i < copy_size; i++) {
+                            const auto cur_offset = src_offset + i;
+                            copy_buf[i] = (cur_offset < chunk_offset) ? this->history[cur_offset & history_mask] : copy_buf[cur_offset - chunk_offset];
+                        }
+
+                        TWL_R_TRY(this->Append(copy_buf, copy_size));
+                        src_offset += copy_size;
+                        size -= copy_size;
+                    }
+                    TWL_R_SUCCEED();
+                }
+
+                inline void BeginAdler32() {
+                    this->compute_adler = true;
+                    this->adler = 1;
+                }
+
+                inline u32 EndAdler32() {
+                    this->compute_adler = false;
+                    return this->adler;
+                }
+
+                inline size_t GetOffset() const {
+                    return this->offset;
+                }
+
+                inline u32 GetCrc32() const {
+                    return ComputeCrc32(this->buf.data(), this->buf.size(), this->crc);
+                }
+        };
+
+        struct IpsRecord {
+            size_t offset;
+            size_t size;
+            const u8 *data; // nullptr for RLE records
+            u8 rle_value;
+        };
+
+        struct VcdiffWindow {
+            u8 win_indicator;
+            size_t seg_size;
+            size_t seg_offset;
+            size_t target_size;
+            size_t target_offset;
+            u32 adler;
+            const u8 *data_section;
+            size_t data_section_size;
+            const u8 *inst_section;
+            size_t inst_section_size;
+            const u8 *addr_section;
+            size_t addr_section_size;
+        };
+
+        class VcdiffAddressCache {
+            private:
+                size_t near[VcdiffNearCacheSize];
+                u32 next_near_slot;
+                size_t same[VcdiffSameCacheEntryCount];
+
+                inline void Update(const size_t addr) {
+                    this->near[this->next_near_slot] = addr;
+                    this->next_near_slot = (this->next_near_slot + 1) % VcdiffNearCacheSize;
+                    this->same[addr % VcdiffSameCacheEntryCount] = addr;
+                }
+
+            public:
+                VcdiffAddressCache() : near(), next_near_slot(0), same() {}
+
+                bool DecodeAddress(PatchReader &addr_reader, const size_t here, const u8 mode, size_t &out_addr) {
+                    u64 addr;
+                    if(mode == 0) {
+                        if(!addr_reader.ReadVcdiffNumber(addr)) {
+                            return false;
+                        }
+                    }
+                    else if(mode == 1) {
+                        u64 rel_addr;
+                        if(!addr_reader.ReadVcdiffNumber(rel_addr) || (rel_addr > here)) {
+                            return false;
+                        }
+                        addr = here - rel_addr;
+                    }
+                    else if(mode < (2 + VcdiffNearCacheSize)) {
+                        u64 rel_addr;
+                        if(!addr_reader.ReadVcdiffNumber(rel_addr)) {
+                            return false;
+                        }
+                        addr = this->near[mode - 2] + rel_addr;
+                    }
+                    else if(mode < (2 + VcdiffNearCacheSize + VcdiffSameCacheSize)) {
+                        u8 same_idx;
+                        if(!addr_reader.ReadByte(same_idx)) {
+                            return false;
+                        }
+                        addr = this->same[(mode - (2 + VcdiffNearCacheSize)) * 0x100 + same_idx];
+                    }
+                    else {
+                        return false;
+                    }
+
+                    if(addr >= here) {
+                        return false;
+                    }
+
+                    this->Update(addr);
+                    out_addr = addr;
+                    return true;
+                }
+        };
+
+        Result ApplyVcdiffWindow(const u8 *src_data, const VcdiffWindow &window, PatchOutputStream &out_stream) {
+            PatchReader data_reader(window.data_section, window.data_section_size);
+            PatchReader inst_reader(window.inst_section, window.inst_section_size);
+            PatchReader addr_reader(window.addr_section, window.addr_section_size);
+            VcdiffAddressCache addr_cache;
+
+            const auto from_source = (window.win_indicator & VcdiffWindowIndicator_Source) != 0;
+            const auto from_target = (window.win_indicator & VcdiffWindowIndicator_Target) != 0;
+
+            if(window.win_indicator & VcdiffWindowIndicator_Adler32) {
+                out_stream.BeginAdler32();
+            }
+
+            size_t written_size = 0;
+            while(!inst_reader.IsAtEnd()) {
+                u8 code;
+                inst_reader.ReadByte(code);
+                const auto &entry = VcdiffDefaultCodeTable[code];
+
+                for(u32 i = 0; i < 2; i++) {
+                    const auto inst = entry.inst[i];
+                    if(inst == VcdiffInstruction::Noop) {
+                        continue;
+                    }
+
+                    u64 size = entry.size[i];
+                    if(size == 0) {
+                        if(!inst_reader.ReadVcdiffNumber(size)) {
+                            TWL_R_FAIL(ResultPatchInvalidData);
+                        }
+                    }
+                    if(size > (window.target_size - written_size)) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+
+                    switch(inst) {
+                        case VcdiffInstruction::Add: {
+                            const u8 *add_data;
+                            if(!data_reader.ReadBytes(add_data, size)) {
+                                TWL_R_FAIL(ResultPatchInvalidData);
+                            }
+                            TWL_R_TRY(out_stream.WriteBuffer(add_data, size));
+                            break;
+                        }
+                        case VcdiffInstruction::Run: {
+                            u8 run_val;
+                            if(!data_reader.ReadByte(run_val)) {
+                                TWL_R_FAIL(ResultPatchInvalidData);
+                            }
+                            TWL_R_TRY(out_stream.WriteFill(run_val, size));
+                            break;
+                        }
+                        case VcdiffInstruction::Copy: {
+                            // Addresses cover the source segment followed by the target window data decoded so far
+                            size_t addr;
+                            if(!addr_cache.DecodeAddress(addr_reader, window.seg_size + written_size, entry.mode[i], addr)) {
+                                TWL_R_FAIL(ResultPatchInvalidData);
+                            }
+
+                            size_t copy_size = size;
+                            if(addr < window.seg_size) {
+                                const auto seg_copy_size = std::min(copy_size, window.seg_size - addr);
+                                if(from_source) {
+                                    TWL_R_TRY(out_stream.WriteBuffer(src_data + window.seg_offset + addr, seg_copy_size));
+                                }
+                                else if(from_target) {
+                                    TWL_R_TRY(out_stream.CopyFromOutput(window.seg_offset + addr, seg_copy_size));
+                                }
+                                else {
+                                    TWL_R_FAIL(ResultPatchInvalidData);
+                                }
+                                addr += seg_copy_size;
+                                copy_size -= seg_copy_size;
+                            }
+
+                            if(copy_size > 0) {
+                                TWL_R_TRY(out_stream.CopyFromOutput(window.target_offset + (addr - window.seg_size), copy_size));
+                            }
+                            break;
+                        }
+                        default:
+                            break;
+                    }
+
+                    written_size += size;
+                }
+            }
+
+            if(written_size != window.target_size) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+
+            if(window.win_indicator & VcdiffWindowIndicator_Adler32) {
+                if(out_stream.EndAdler32() != window.adler) {
+                    TWL_R_FAIL(ResultPatchTargetChecksumMismatch);
+                }
+            }
+
+            TWL_R_SUCCEED();
+        }
+
+    }
+
+    PatchFormat DetectPatchFormat(const u8 *patch_data, const size_t patch_size) {
+        if((patch_size >= IpsMagicSize) && (std::memcmp(patch_data, IpsMagic, IpsMagicSize) == 0)) {
+            return PatchFormat::IPS;
+        }
+
+        if(patch_size >= sizeof(u32)) {
+            u32 magic;
+            std::memcpy(&magic, patch_data, sizeof(magic));
+            if(magic == BpsMagic) {
+                return PatchFormat::BPS;
+            }
+            if(magic == VcdiffMagic) {
+                return PatchFormat::VCDIFF;
+            }
+        }
+
+        return PatchFormat::Invalid;
+    }
+
+    Result IpsApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file) {
+        if(DetectPatchFormat(patch_data, patch_size) != PatchFormat::IPS) {
+            TWL_R_FAIL(ResultPatchInvalidFormat);
+        }
+
+        PatchReader reader(patch_data, patch_size);
+        const u8 *magic;
+        reader.ReadBytes(magic, IpsMagicSize);
+
+        std::vector<IpsRecord> records;
+        auto dst_size = src_size;
+        auto has_truncate_size = false;
+        u32 truncate_size = 0;
+        auto is_sorted = true;
+        size_t prev_end_offset = 0;
+        while(true) {
+            u32 rec_offset;
+            if(!reader.ReadBigEndian(rec_offset, 3)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            if(rec_offset == IpsEofOffset) {
+                // Extension: the target size may follow the end marker
+                if(reader.ReadBigEndian(truncate_size, 3)) {
+                    has_truncate_size = true;
+                }
+                break;
+            }
+
+            IpsRecord rec = {
+                .offset = rec_offset
+            };
+
+            u32 rec_size;
+            if(!reader.ReadBigEndian(rec_size, 2)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            if(rec_size == 0) {
+                if(!reader.ReadBigEndian(rec_size, 2) || !reader.ReadByte(rec.rle_value)) {
+                    TWL_R_FAIL(ResultPatchInvalidData);
+                }
+                rec.data = nullptr;
+            }
+            else if(!reader.ReadBytes(rec.data, rec_size)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            rec.size = rec_size;
+
+            if(rec.offset < prev_end_offset) {
+                is_sorted = false;
+            }
+            prev_end_offset = rec.offset + rec.size;
+            dst_size = std::max(dst_size, prev_end_offset);
+            records.push_back(rec);
+        }
+
+        const auto full_dst_size = dst_size;
+        if(has_truncate_size) {
+            dst_size = truncate_size;
+        }
+
+        if(!is_sorted) {
+            // Overlapping/unordered records: the target needs to be built in memory
+            std::vector<u8> dst_data(std::max(dst_size, full_dst_size));
+            std::memcpy(dst_data.data(), src_data, std::min(src_size, dst_data.size()));
+            for(const auto &rec: records) {
+                if(rec.data != nullptr) {
+                    std::memcpy(dst_data.data() + rec.offset, rec.data, rec.size);
+                }
+                else {
+                    std::memset(dst_data.data() + rec.offset, rec.rle_value, rec.size);
+                }
+            }
+
+            TWL_R_TRY(out_file.WriteBuffer(dst_data.data(), dst_size));
+            TWL_R_SUCCEED();
+        }
+
+        PatchOutputStream out_stream(out_file, 0);
+        const auto write_source_until = [&](const size_t end_offset) -> Result {
+            const auto cur_offset = out_stream.GetOffset();
+            if(cur_offset < end_offset) {
+                const auto src_copy_size = (cur_offset < src_size) ? std::min(end_offset, src_size) - cur_offset : 0;
+                TWL_R_TRY(out_stream.WriteBuffer(src_data + cur_offset, src_copy_size));
+                TWL_R_TRY(out_stream.WriteFill(0, end_offset - cur_offset - src_copy_size));
+            }
+            TWL_R_SUCCEED();
+        };
+
+        for(const auto &rec: records) {
+            if(rec.offset >= dst_size) {
+                break;
+            }
+
+            TWL_R_TRY(write_source_until(rec.offset));
+            const auto rec_size = std::min(rec.size, dst_size - rec.offset);
+            if(rec.data != nullptr) {
+                TWL_R_TRY(out_stream.WriteBuffer(rec.data, rec_size));
+            }
+            else {
+                TWL_R_TRY(out_stream.WriteFill(rec.rle_value, rec_size));
+            }
+        }
+        TWL_R_TRY(write_source_until(dst_size));
+
+        TWL_R_TRY(out_stream.Flush());
+        TWL_R_SUCCEED();
+    }
+
+    Result BpsApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file) {
+        if(DetectPatchFormat(patch_data, patch_size) != PatchFormat::BPS) {
+            TWL_R_FAIL(ResultPatchInvalidFormat);
+        }
+        if(patch_size < (sizeof(BpsMagic) + BpsFooterSize)) {
+            TWL_R_FAIL(ResultPatchInvalidData);
+        }
+
+        const auto cmds_end_offset = patch_size - BpsFooterSize;
+        PatchReader reader(patch_data, cmds_end_offset);
+        const u8 *magic;
+        reader.ReadBytes(magic, sizeof(BpsMagic));
+
+        u64 patch_src_size;
+        u64 patch_dst_size;
+        u64 metadata_size;
+        const u8 *metadata;
+        if(!reader.ReadBpsNumber(patch_src_size) || !reader.ReadBpsNumber(patch_dst_size) || !reader.ReadBpsNumber(metadata_size) || !reader.ReadBytes(metadata, metadata_size)) {
+            TWL_R_FAIL(ResultPatchInvalidData);
+        }
+        if(patch_src_size != src_size) {
+            TWL_R_FAIL(ResultPatchSourceSizeMismatch);
+        }
+
+        // Decode and validate all commands first, which also tells how far back target copies may look
+
+        std::vector<BpsCommand> cmds;
+        size_t dst_offset = 0;
+        i64 src_rel_offset = 0;
+        i64 dst_rel_offset = 0;
+        size_t max_lookback = 0;
+        while(!reader.IsAtEnd()) {
+            u64 cmd_val;
+            if(!reader.ReadBpsNumber(cmd_val)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+
+            BpsCommand cmd = {
+                .action = static_cast<BpsAction>(cmd_val & 0x3),
+                .length = (cmd_val >> 2) + 1
+            };
+            if(cmd.length > (patch_dst_size - dst_offset)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+
+            switch(cmd.action) {
+                case BpsAction::SourceRead: {
+                    if((dst_offset + cmd.length) > src_size) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+                    cmd.offset = dst_offset;
+                    break;
+                }
+                case BpsAction::TargetRead: {
+                    cmd.offset = reader.GetOffset();
+                    const u8 *lit_data;
+                    if(!reader.ReadBytes(lit_data, cmd.length)) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+                    break;
+                }
+                case BpsAction::SourceCopy:
+                case BpsAction::TargetCopy: {
+                    u64 rel_val;
+                    if(!reader.ReadBpsNumber(rel_val)) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+                    const auto rel_offset = static_cast<i64>(rel_val >> 1) * ((rel_val & 1) ? -1 : 1);
+
+                    auto &base_offset = (cmd.action == BpsAction::SourceCopy) ? src_rel_offset : dst_rel_offset;
+                    base_offset += rel_offset;
+                    if(base_offset < 0) {
+                        TWL_R_FAIL(ResultPatchInvalidData);
+                    }
+                    cmd.offset = base_offset;
+                    base_offset += cmd.length;
+
+                    if(cmd.action == BpsAction::SourceCopy) {
+                        if((cmd.offset > src_size) || (cmd.length > (src_size - cmd.offset))) {
+                            TWL_R_FAIL(ResultPatchInvalidData);
+                        }
+                    }
+                    else {
+                        if(cmd.offset >= dst_offset) {
+                            TWL_R_FAIL(ResultPatchInvalidData);
+                        }
+                        max_lookback = std::max(max_lookback, dst_offset - cmd.offset);
+                    }
+                    break;
+                }
+            }
+
+            dst_offset += cmd.length;
+            cmds.push_back(cmd);
+        }
+
+        if(dst_offset != patch_dst_size) {
+            TWL_R_FAIL(ResultPatchInvalidData);
+        }
+
+        u32 patch_src_crc;
+        u32 patch_dst_crc;
+        u32 patch_crc;
+        std::memcpy(&patch_src_crc, patch_data + cmds_end_offset, sizeof(u32));
+        std::memcpy(&patch_dst_crc, patch_data + cmds_end_offset + sizeof(u32), sizeof(u32));
+        std::memcpy(&patch_crc, patch_data + cmds_end_offset + 2 * sizeof(u32), sizeof(u32));
+
+        // Check the patch and the source before writing anything, so that a wrong source/corrupted patch doesn't produce any output
+
+        u32 src_crc = 0;
+        u32 calc_patch_crc = 0;
+        ParallelFor(2, [&](const size_t i) {
+            if(i == 0) {
+                src_crc = ComputeCrc32(src_data, src_size);
+            }
+            else {
+                calc_patch_crc = ComputeCrc32(patch_data, patch_size - sizeof(u32));
+            }
+        }, GetDefaultThreadCount());
+
+        if(calc_patch_crc != patch_crc) {
+            TWL_R_FAIL(ResultPatchChecksumMismatch);
+        }
+        if(src_crc != patch_src_crc) {
+            TWL_R_FAIL(ResultPatchSourceChecksumMismatch);
+        }
+
+        PatchOutputStream out_stream(out_file, max_lookback);
+        for(const auto &cmd: cmds) {
+            switch(cmd.action) {
+                case BpsAction::SourceRead:
+                case BpsAction::SourceCopy: {
+                    TWL_R_TRY(out_stream.WriteBuffer(src_data + cmd.offset, cmd.length));
+                    break;
+                }
+                case BpsAction::TargetRead: {
+                    TWL_R_TRY(out_stream.WriteBuffer(patch_data + cmd.offset, cmd.length));
+                    break;
+                }
+                case BpsAction::TargetCopy: {
+                    TWL_R_TRY(out_stream.CopyFromOutput(cmd.offset, cmd.length));
+                    break;
+                }
+            }
+        }
+
+        TWL_R_TRY(out_stream.Flush());
+        if(out_stream.GetCrc32() != patch_dst_crc) {
+            TWL_R_FAIL(ResultPatchTargetChecksumMismatch);
+        }
+
+        TWL_R_SUCCEED();
+    }
+
+    Result VcdiffApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file) {
+        if(DetectPatchFormat(patch_data, patch_size) != PatchFormat::VCDIFF) {
+            TWL_R_FAIL(ResultPatchInvalidFormat);
+        }
+
+        PatchReader reader(patch_data, patch_size);
+        const u8 *magic;
+        reader.ReadBytes(magic, sizeof(VcdiffMagic));
+
+        u8 hdr_indicator;
+        if(!reader.ReadByte(hdr_indicator)) {
+            TWL_R_FAIL(ResultPatchInvalidData);
+        }
+        if(hdr_indicator & (VcdiffHeaderIndicator_Decompress | VcdiffHeaderIndicator_CodeTable)) {
+            TWL_R_FAIL(ResultPatchUnsupportedFeature);
+        }
+        if(hdr_indicator & VcdiffHeaderIndicator_AppHeader) {
+            u64 app_header_size;
+            const u8 *app_header;
+            if(!reader.ReadVcdiffNumber(app_header_size) || !reader.ReadBytes(app_header, app_header_size)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+        }
+
+        // Parse all windows first, which also tells how far back target copies may look
+
+        std::vector<VcdiffWindow> windows;
+        size_t dst_size = 0;
+        size_t max_lookback = 0;
+        while(!reader.IsAtEnd()) {
+            VcdiffWindow window = {};
+            reader.ReadByte(window.win_indicator);
+
+            const auto from_source = (window.win_indicator & VcdiffWindowIndicator_Source) != 0;
+            const auto from_target = (window.win_indicator & VcdiffWindowIndicator_Target) != 0;
+            if(from_source && from_target) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+
+            if(from_source || from_target) {
+                u64 seg_size;
+                u64 seg_offset;
+                if(!reader.ReadVcdiffNumber(seg_size) || !reader.ReadVcdiffNumber(seg_offset)) {
+                    TWL_R_FAIL(ResultPatchInvalidData);
+                }
+
+                const auto seg_base_size = from_source ? src_size : dst_size;
+                if((seg_offset > seg_base_size) || (seg_size > (seg_base_size - seg_offset))) {
+                    TWL_R_FAIL(ResultPatchInvalidData);
+                }
+                window.seg_size = seg_size;
+                window.seg_offset = seg_offset;
+            }
+
+            u64 delta_size;
+            u64 target_size;
+            u8 delta_indicator;
+            u64 data_section_size;
+            u64 inst_section_size;
+            u64 addr_section_size;
+            if(!reader.ReadVcdiffNumber(delta_size) || !reader.ReadVcdiffNumber(target_size) || !reader.ReadByte(delta_indicator) || !reader.ReadVcdiffNumber(data_section_size) || !reader.ReadVcdiffNumber(inst_section_size) || !reader.ReadVcdiffNumber(addr_section_size)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            if(delta_indicator != 0) {
+                TWL_R_FAIL(ResultPatchUnsupportedFeature);
+            }
+            if((window.win_indicator & VcdiffWindowIndicator_Adler32) && !reader.ReadBigEndian(window.adler, sizeof(u32))) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            if(!reader.ReadBytes(window.data_section, data_section_size) || !reader.ReadBytes(window.inst_section, inst_section_size) || !reader.ReadBytes(window.addr_section, addr_section_size)) {
+                TWL_R_FAIL(ResultPatchInvalidData);
+            }
+            window.data_section_size = data_section_size;
+            window.inst_section_size = inst_section_size;
+            window.addr_section_size = addr_section_size;
+            window.target_size = target_size;
+            window.target_offset = dst_size;
+
+            auto window_lookback = window.target_size;
+            if(from_target) {
+                window_lookback += dst_size - window.seg_offset;
+            }
+            max_lookback = std::max(max_lookback, window_lookback);
+
+            dst_size += target_size;
+            windows.push_back(window);
+        }
+
+        PatchOutputStream out_stream(out_file, max_lookback);
+        for(const auto &window: windows) {
+            TWL_R_TRY(ApplyVcdiffWindow(src_data, window, out_stream));
+        }
+
+        TWL_R_TRY(out_stream.Flush());
+        TWL_R_SUCCEED();
+    }
+
+    Result ApplyPatch(const u8 *src_data, const size_t src_size, const u8 *patch_data, const size_t patch_size, fs::File &out_file) {
+        switch(DetectPatchFormat(patch_data, patch_size)) {
+            case PatchFormat::IPS: {
+                return IpsApplyPatch(src_data, src_size, patch_data, patch_size, out_file);
+            }
+            case PatchFormat::BPS: {
+                return BpsApplyPatch(src_data, src_size, patch_data, patch_size, out_file);
+            }
+            case PatchFormat::VCDIFF: {
+                return VcdiffApplyPatch(src_data, src_size, patch_data, patch_size, out_file);
+            }
+            default: {
+                TWL_R_FAIL(ResultPatchInvalidFormat);
+            }
+        }
+    }
+
+}